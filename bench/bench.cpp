@@ -0,0 +1,466 @@
+// Benchmarks of the index construction, compression and search paths on synthetic corpora.
+//
+// Usage: ipmt-bench [-f json|csv] [-r runs] [-s sizes] [-q queries] [-o output]
+//
+// Each corpus (random bytes, DNA, natural language and a highly repetitive text) is generated with
+// a fixed seed at each size, so results of different builds are comparable. Every operation runs
+// several times; its latency percentiles, throughput (over the text size) and peak resident memory
+// are printed as one JSON object or CSV row.
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <random>
+#include <sstream>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <getopt.h>
+#include <unistd.h>
+
+#include "compression_type.h"
+#include "dynamic_bitset.h"
+#include "huffman.h"
+#include "index_file.h"
+#include "line_samples.h"
+#include "lz78.h"
+#include "packed_array.h"
+#include "parallel.h"
+#include "stats.h"
+#include "suffix_array_algorithm.h"
+#include "sufarray.h"
+#include "utils.h"
+
+namespace {
+
+const uint64_t kSeed = 0x1BADB002;
+
+struct Corpus {
+  std::string name;
+  std::string text;
+};
+
+struct Result {
+  std::string corpus;
+  size_t text_size;
+  std::string operation;
+  std::string parameter;
+  std::vector<double> seconds;  // Latency of each run (or query).
+  double bytes;  // Bytes processed per run, for throughput.
+  long peak_rss_kb;
+};
+
+// ## Corpus generators.
+
+std::string GenerateRandom(size_t size, std::mt19937_64 *rng) {
+  std::string text(size, '\0');
+  for (size_t i = 0; i < size; ++i) {
+    text[i] = static_cast<char>((*rng)() & 0xFF);
+  }
+
+  return text;
+}
+
+// Lines of 60 bases, as on FASTA files.
+std::string GenerateDNA(size_t size, std::mt19937_64 *rng) {
+  const char kBases[] = "ACGT";
+  std::string text(size, '\0');
+
+  for (size_t i = 0; i < size; ++i) {
+    text[i] = i % 61 == 60 ? '\n' : kBases[(*rng)() & 3];
+  }
+
+  return text;
+}
+
+// Words drawn from a Zipf distribution over a vocabulary of random lowercase words, on lines of
+// up to 16 words.
+std::string GenerateNaturalLanguage(size_t size, std::mt19937_64 *rng) {
+  const size_t kVocabularySize = 5000;
+  std::vector<std::string> vocabulary(kVocabularySize);
+  std::vector<double> weights(kVocabularySize);
+
+  for (size_t w = 0; w < kVocabularySize; ++w) {
+    size_t length = 2 + (*rng)() % 9;
+    for (size_t i = 0; i < length; ++i) {
+      vocabulary[w].push_back(static_cast<char>('a' + (*rng)() % 26));
+    }
+
+    weights[w] = 1.0 / (w + 1);
+  }
+
+  std::discrete_distribution<size_t> zipf(weights.begin(), weights.end());
+  std::string text;
+  text.reserve(size + 16);
+  size_t words_in_line = 0;
+
+  while (text.size() < size) {
+    text += vocabulary[zipf(*rng)];
+
+    if (++words_in_line == 1 + (*rng)() % 16) {
+      text.push_back('\n');
+      words_in_line = 0;
+    } else {
+      text.push_back(' ');
+    }
+  }
+
+  text.resize(size);
+  return text;
+}
+
+// Copies of a 4 KB natural language chunk, each with a few mutations, like versioned documents or
+// logs.
+std::string GenerateRepetitive(size_t size, std::mt19937_64 *rng) {
+  std::string chunk = GenerateNaturalLanguage(1 << 12, rng);
+  std::string text;
+  text.reserve(size + chunk.size());
+
+  while (text.size() < size) {
+    std::string copy = chunk;
+    for (int m = 0; m < 4; ++m) {
+      copy[(*rng)() % copy.size()] = static_cast<char>('a' + (*rng)() % 26);
+    }
+
+    text += copy;
+  }
+
+  text.resize(size);
+  return text;
+}
+
+std::vector<Corpus> GenerateCorpora(size_t size) {
+  std::mt19937_64 rng(kSeed);
+  std::vector<Corpus> corpora;
+
+  corpora.push_back({"random", GenerateRandom(size, &rng)});
+  corpora.push_back({"dna", GenerateDNA(size, &rng)});
+  corpora.push_back({"natural", GenerateNaturalLanguage(size, &rng)});
+  corpora.push_back({"repetitive", GenerateRepetitive(size, &rng)});
+
+  return corpora;
+}
+
+// ## Measurements.
+
+double Seconds(std::chrono::steady_clock::time_point start) {
+  return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+double Percentile(std::vector<double> values, double p) {
+  if (values.empty()) return 0;
+
+  std::sort(values.begin(), values.end());
+  size_t rank = static_cast<size_t>(std::ceil(p * values.size()));
+
+  return values[std::max<size_t>(rank, 1) - 1];
+}
+
+// Runs the operation the given number of times, after an untimed setup before each run.
+Result Measure(const Corpus &corpus, const std::string &operation, const std::string &parameter,
+               int runs, double bytes, const std::function<void()> &setup,
+               const std::function<void()> &run) {
+  Result result = {corpus.name, corpus.text.size(), operation, parameter, {}, bytes, 0};
+  ipmt::ResetPeakRss();
+
+  for (int r = 0; r < runs; ++r) {
+    if (setup) setup();
+
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    run();
+    result.seconds.push_back(Seconds(start));
+  }
+
+  result.peak_rss_kb = ipmt::PeakRssKb();
+
+  return result;
+}
+
+// Patterns of the given length sampled from the text, so all of them occur.
+std::vector<std::string> SamplePatterns(const std::string &text, size_t length, size_t count) {
+  std::mt19937_64 rng(kSeed + length);
+  std::vector<std::string> patterns;
+
+  if (text.size() < length) return patterns;
+
+  for (size_t i = 0; i < count; ++i) {
+    patterns.push_back(text.substr(rng() % (text.size() - length + 1), length));
+  }
+
+  return patterns;
+}
+
+// ## Benchmarks.
+
+void BenchmarkCorpus(const Corpus &corpus, int runs, size_t num_queries, const std::string &dir,
+                     std::vector<Result> *results) {
+  const std::string &text = corpus.text;
+  double size = static_cast<double>(text.size());
+
+  // Suffix array construction.
+  ipmt::PackedArray suffix_array;
+  const std::pair<const char*, ipmt::SuffixArrayAlgorithm> kAlgorithms[] = {
+    {"sais", ipmt::SuffixArrayAlgorithm::kSAIS},
+    {"pd", ipmt::SuffixArrayAlgorithm::kParallelDoubling}
+  };
+
+  for (const auto &algorithm : kAlgorithms) {
+    results->push_back(Measure(corpus, "BuildSuffixArray", algorithm.first, runs, size, nullptr,
+                               [&]() {
+      suffix_array = ipmt::BuildSuffixArray(text, algorithm.second, ipmt::HardwareThreads());
+    }));
+  }
+
+  ipmt::SearchLcp search_lcp = ipmt::BuildSearchLcp(ipmt::BuildLcpArray(text, suffix_array));
+
+  // Codecs.
+  ipmt::DynamicBitset huffman_code;
+  ipmt::CodeLengths code_lengths;
+  std::string decoded;
+
+  results->push_back(Measure(corpus, "HuffmanEncode", "", runs, size,
+                             [&]() { huffman_code = ipmt::DynamicBitset(); }, [&]() {
+    ipmt::HuffmanEncode(text, &huffman_code, &code_lengths);
+  }));
+  results->push_back(Measure(corpus, "HuffmanDecode", "", runs, size, nullptr, [&]() {
+    decoded = ipmt::HuffmanDecode(huffman_code, code_lengths, text.size());
+  }));
+
+  std::vector<std::pair<int, char>> lz78_code;
+
+  results->push_back(Measure(corpus, "LZ78Encode", "", runs, size,
+                             [&]() { lz78_code.clear(); }, [&]() {
+    ipmt::LZ78Encode(text, &lz78_code);
+  }));
+  results->push_back(Measure(corpus, "LZ78Decode", "", runs, size, nullptr, [&]() {
+    decoded = ipmt::LZ78Decode(lz78_code, ipmt::LZ78Options(), text.size());
+  }));
+
+  // Index files.
+  std::string text_path = dir + "/" + corpus.name + ".txt";
+  std::string index_path = dir + "/" + corpus.name + ".idx";
+  ipmt::PackedArray line_samples = ipmt::SampleLineStarts(text);
+  const std::pair<const char*, ipmt::CompressionType> kCompressionTypes[] = {
+    {"huffman", ipmt::CompressionType::kHuffman},
+    {"lz78", ipmt::CompressionType::kLZ78}
+  };
+
+  for (const auto &type : kCompressionTypes) {
+    results->push_back(Measure(corpus, "WriteIndexFile", type.first, runs, size, nullptr, [&]() {
+      ipmt::WriteIndexFile(index_path, suffix_array, search_lcp, line_samples, text, type.second);
+    }));
+    results->push_back(Measure(corpus, "ReadIndexFile", type.first, runs, size, nullptr, [&]() {
+      ipmt::Index index;
+      ipmt::ReadIndexFile(index_path, &index);
+    }));
+  }
+
+  std::remove(index_path.c_str());
+
+  // Search: the latency of each query is measured.
+  const size_t kPatternLengths[] = {4, 16, 64};
+
+  for (size_t length : kPatternLengths) {
+    std::vector<std::string> patterns = SamplePatterns(text, length, num_queries);
+    size_t k = 0;
+    size_t occurrences = 0;
+
+    Result result = Measure(corpus, "GetOccurrences", "m=" + std::to_string(length),
+                            static_cast<int>(patterns.size()), 0, nullptr, [&]() {
+      occurrences += ipmt::GetOccurrences(patterns[k++], text, suffix_array, search_lcp).size();
+    });
+
+    result.bytes = length;  // Throughput of queries is reported over the pattern length.
+    results->push_back(result);
+  }
+}
+
+// ## Output.
+
+std::string FormatDouble(double value) {
+  std::ostringstream oss;
+  oss.precision(6);
+  oss << value;
+
+  return oss.str();
+}
+
+void PrintResults(const std::vector<Result> &results, bool csv, std::ostream &out) {
+  if (csv) {
+    out << "corpus,size,operation,parameter,runs,mean_ms,p50_ms,p90_ms,p99_ms,"
+        << "throughput_mb_s,peak_rss_kb\n";
+  } else {
+    out << "[\n";
+  }
+
+  for (size_t i = 0; i < results.size(); ++i) {
+    const Result &r = results[i];
+    double total = 0;
+    for (size_t j = 0; j < r.seconds.size(); ++j) total += r.seconds[j];
+
+    double mean = r.seconds.empty() ? 0 : total / r.seconds.size();
+    double p50 = Percentile(r.seconds, 0.5);
+    double throughput = p50 > 0 ? r.bytes / p50 / (1 << 20) : 0;
+
+    if (csv) {
+      out << r.corpus << "," << r.text_size << "," << r.operation << "," << r.parameter << ","
+          << r.seconds.size() << "," << FormatDouble(1e3 * mean) << "," << FormatDouble(1e3 * p50)
+          << "," << FormatDouble(1e3 * Percentile(r.seconds, 0.9)) << ","
+          << FormatDouble(1e3 * Percentile(r.seconds, 0.99)) << "," << FormatDouble(throughput)
+          << "," << r.peak_rss_kb << "\n";
+    } else {
+      out << "  {\"corpus\": \"" << r.corpus << "\", \"size\": " << r.text_size
+          << ", \"operation\": \"" << r.operation << "\", \"parameter\": \"" << r.parameter
+          << "\", \"runs\": " << r.seconds.size() << ", \"mean_ms\": " << FormatDouble(1e3 * mean)
+          << ", \"p50_ms\": " << FormatDouble(1e3 * p50)
+          << ", \"p90_ms\": " << FormatDouble(1e3 * Percentile(r.seconds, 0.9))
+          << ", \"p99_ms\": " << FormatDouble(1e3 * Percentile(r.seconds, 0.99))
+          << ", \"throughput_mb_s\": " << FormatDouble(throughput)
+          << ", \"peak_rss_kb\": " << r.peak_rss_kb << "}"
+          << (i + 1 < results.size() ? "," : "") << "\n";
+    }
+  }
+
+  if (!csv) {
+    out << "]\n";
+  }
+}
+
+void PrintUsage() {
+  std::cout << "Usage: ipmt-bench [options]\n\n    -f --format\tOutput format: \"json\" (default)"
+            << " or \"csv\".\n    -o --output\tWrites the results to the given file instead of"
+            << " the\n\t\tstandard output.\n    -q --queries\tQueries per pattern length (default"
+            << " 1000).\n    -r --runs\tRuns of each operation (default 3).\n    -s --sizes\t"
+            << "Comma-separated corpus sizes, in kilobytes\n\t\t(default 1024,8192)." << std::endl;
+}
+
+}  // namespace
+
+int main(int argc, char *argv[]) {
+  option long_options[] = {
+    {"format", required_argument, nullptr, 'f'},
+    {"help", no_argument, nullptr, 'h'},
+    {"output", required_argument, nullptr, 'o'},
+    {"queries", required_argument, nullptr, 'q'},
+    {"runs", required_argument, nullptr, 'r'},
+    {"sizes", required_argument, nullptr, 's'},
+    {nullptr, 0, nullptr, 0}
+  };
+
+  bool csv = false;
+  int runs = 3;
+  size_t num_queries = 1000;
+  std::string output_path;
+  std::vector<size_t> sizes = {1 << 20, 8 << 20};
+  std::string option_arg;
+  char *end;
+  int c;
+
+  while ((c = getopt_long(argc, argv, "f:ho:q:r:s:", long_options, nullptr)) != -1) {
+    switch (c) {
+      case 'f':
+        option_arg = optarg;
+
+        if (option_arg != "json" && option_arg != "csv") {
+          std::cout << "Invalid output format." << std::endl;
+          return EXIT_FAILURE;
+        }
+
+        csv = option_arg == "csv";
+        break;
+
+      case 'h':
+        PrintUsage();
+        return 0;
+
+      case 'o':
+        output_path = optarg;
+        break;
+
+      case 'q':
+        num_queries = std::strtoull(optarg, &end, 10);
+
+        if (*end != '\0' || num_queries == 0) {
+          std::cout << "Invalid number of queries." << std::endl;
+          return EXIT_FAILURE;
+        }
+
+        break;
+
+      case 'r':
+        runs = std::strtol(optarg, &end, 10);
+
+        if (*end != '\0' || runs < 1) {
+          std::cout << "Invalid number of runs." << std::endl;
+          return EXIT_FAILURE;
+        }
+
+        break;
+
+      case 's': {
+        sizes.clear();
+        std::istringstream list(optarg);
+        std::string size;
+
+        while (std::getline(list, size, ',')) {
+          unsigned long long kilobytes = std::strtoull(size.c_str(), &end, 10);
+
+          if (size.empty() || *end != '\0' || kilobytes == 0) {
+            std::cout << "Invalid corpus size " << size << "." << std::endl;
+            return EXIT_FAILURE;
+          }
+
+          sizes.push_back(static_cast<size_t>(kilobytes) << 10);
+        }
+
+        break;
+      }
+
+      default:
+        std::cout << "Invalid option argument." << std::endl;
+        return EXIT_FAILURE;
+    }
+  }
+
+  // Index files are written to a scratch directory, removed at the end.
+  char dir_template[] = "/tmp/ipmt-bench-XXXXXX";
+  if (!mkdtemp(dir_template)) {
+    std::cout << "Cannot create a scratch directory." << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  std::vector<Result> results;
+
+  for (size_t i = 0; i < sizes.size(); ++i) {
+    std::vector<Corpus> corpora = GenerateCorpora(sizes[i]);
+
+    for (size_t j = 0; j < corpora.size(); ++j) {
+      std::cerr << "Benchmarking " << corpora[j].name << " corpus of " << sizes[i]
+                << " bytes..." << std::endl;
+      BenchmarkCorpus(corpora[j], runs, num_queries, dir_template, &results);
+    }
+  }
+
+  rmdir(dir_template);
+
+  if (output_path.empty()) {
+    PrintResults(results, csv, std::cout);
+  } else {
+    std::ofstream out(output_path);
+    PrintResults(results, csv, out);
+
+    if (!out) {
+      std::cout << "Cannot write file " << output_path << "." << std::endl;
+      return EXIT_FAILURE;
+    }
+  }
+
+  return 0;
+}
@@ -0,0 +1,34 @@
+#ifndef IPMT_APPROXIMATE_SEARCH_H_
+#define IPMT_APPROXIMATE_SEARCH_H_
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+#include "index_file.h"
+#include "match_distance.h"
+#include "segmented_index.h"
+
+namespace ipmt {
+
+// Returns the sorted positions where occurrences of the pattern with at most max_errors errors
+// start. With the Hamming distance, these are the positions pos where text[pos, pos + m) differs
+// from the pattern in at most max_errors characters; with the edit distance, those where some
+// text[pos, end) is within max_errors insertions, deletions and substitutions of the pattern (so a
+// single approximate occurrence may start at a few neighbouring positions).
+//
+// Occurrences are found by pigeonhole seeding (Baeza-Yates and Navarro, 1999): the pattern is split
+// into max_errors + 1 pieces, one of which occurs exactly in any approximate occurrence. The exact
+// occurrences of each piece are located on the index, and only the text around them is decoded and
+// verified (by dynamic programming, for the edit distance), on num_threads threads. The pattern
+// must be longer than max_errors.
+std::vector<size_t> LocateApproximate(const std::string &pattern, size_t max_errors,
+                                      MatchDistance distance, const Index &index,
+                                      int num_threads = 1);
+std::vector<size_t> LocateApproximate(const std::string &pattern, size_t max_errors,
+                                      MatchDistance distance, const SegmentedIndex &index,
+                                      int num_threads = 1);
+
+}  // namespace ipmt
+
+#endif  // IPMT_APPROXIMATE_SEARCH_H_
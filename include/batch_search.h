@@ -0,0 +1,29 @@
+#ifndef IPMT_BATCH_SEARCH_H_
+#define IPMT_BATCH_SEARCH_H_
+
+#include <string>
+#include <vector>
+
+#include "block_text.h"
+#include "packed_array.h"
+#include "sufarray.h"
+#include "utils.h"
+
+namespace ipmt {
+
+// Returns the suffix array interval of each pattern, in the order given. The patterns are searched
+// in lexicographic order, split across num_threads threads: each one is searched within the
+// interval of the prefix it shares with the pattern before it, without comparing that prefix
+// again, and only patterns sharing no prefix start from the whole suffix array.
+std::vector<SuffixArrayInterval> SearchPatterns(const std::vector<std::string> &patterns,
+                                                const std::string &text,
+                                                const PackedArray &suffix_array,
+                                                const SearchLcp &search_lcp, int num_threads);
+std::vector<SuffixArrayInterval> SearchPatterns(const std::vector<std::string> &patterns,
+                                                const BlockText &text,
+                                                const PackedArray &suffix_array,
+                                                const SearchLcp &search_lcp, int num_threads);
+
+}  // namespace ipmt
+
+#endif  // IPMT_BATCH_SEARCH_H_
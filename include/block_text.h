@@ -0,0 +1,91 @@
+#ifndef IPMT_BLOCK_TEXT_H_
+#define IPMT_BLOCK_TEXT_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "compression_type.h"
+#include "huffman.h"
+#include "lz78.h"
+
+namespace ipmt {
+
+// Compressed text split into fixed-size blocks, each one decodable on its own, so reading a few
+// characters decodes only the blocks holding them instead of the whole text. Huffman blocks share
+// the code lengths of the whole text; LZ78 blocks each start with an empty dictionary. Decoded
+// blocks are kept in a least recently used cache, shared by all threads using the text, and each
+// thread reads the block it used last without going through the cache.
+//
+// As with FMIndex, the whole text is stored on a single array of words, which is either owned by
+// the text (when it is built) or a memory mapped index file. It can be moved, but not copied.
+class BlockText {
+ public:
+  BlockText();
+  BlockText(BlockText &&text);
+  ~BlockText();
+
+  BlockText& operator=(BlockText &&text);
+
+  static const size_t kDefaultBlockSize;
+  // Number of decoded blocks kept in the cache.
+  static const size_t kCacheBlocks;
+
+  static BlockText Build(const std::string &text, CompressionType type,
+                         const LZ78Options &lz78_options, size_t block_size = kDefaultBlockSize);
+  // The characters of a Huffman coded text are counted on up to num_threads threads.
+  static BlockText Build(const char *text, size_t text_size, CompressionType type,
+                         const LZ78Options &lz78_options, size_t block_size = kDefaultBlockSize,
+                         int num_threads = 1);
+
+  // Makes this text a view of the words of a text built by Build. Returns false if they do not
+  // represent a valid text.
+  bool View(const uint64_t *data, size_t num_words);
+
+  char operator[](size_t pos) const;
+
+  // Returns text[pos, pos + length), clipped at the end of the text.
+  std::string Extract(size_t pos, size_t length) const;
+  // Returns the line of the text containing pos, without its line feed, and its first position.
+  std::string ExtractLine(size_t pos, size_t *line_start) const;
+
+  // Accessors.
+  CompressionType compression_type() const { return type_; }
+  const uint64_t* data() const { return data_; }
+  size_t num_words() const { return num_words_; }
+  size_t size() const { return size_; }  // Returns the length of the text.
+  bool empty() const { return data_ == nullptr; }
+
+ private:
+  class Cache;
+
+  BlockText(const BlockText&) = delete;
+  BlockText& operator=(const BlockText&) = delete;
+
+  // Returns the decoded block, from the cache if possible. It stays valid until the calling thread
+  // gets another block.
+  const std::string& GetBlock(size_t block) const;
+  std::string DecodeBlock(size_t block) const;
+
+  std::vector<uint64_t> storage_;
+  const uint64_t *data_;
+  size_t num_words_;
+
+  size_t size_;
+  size_t block_size_;
+  size_t num_blocks_;
+  CompressionType type_;
+  HuffmanDecoder decoder_;
+  LZ78Options lz78_options_;
+  const uint64_t *offsets_;  // Word offset of each block (and of the end of the last one).
+  const uint64_t *blocks_;
+  uint64_t id_;  // Unique to each view.
+
+  std::unique_ptr<Cache> cache_;
+};
+
+}  // namespace ipmt
+
+#endif  // IPMT_BLOCK_TEXT_H_
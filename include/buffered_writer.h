@@ -0,0 +1,62 @@
+#ifndef IPMT_BUFFERED_WRITER_H_
+#define IPMT_BUFFERED_WRITER_H_
+
+#include <algorithm>
+#include <cstddef>
+#include <ostream>
+#include <string>
+#include <vector>
+
+namespace ipmt {
+
+// Collects small writes on a large buffer, which is written to the output stream only when full,
+// when flushed or when the writer is destroyed. Anything else written to the same stream must be
+// written after a flush, so it is not interleaved with the buffered data.
+class BufferedWriter {
+ public:
+  explicit BufferedWriter(std::ostream &out, size_t capacity = kDefaultCapacity);
+  ~BufferedWriter() { Flush(); }
+
+  static const size_t kDefaultCapacity;
+
+  void Write(const char *data, size_t size) {
+    if (size > buffer_.size() - size_) {
+      WriteLarge(data, size);
+      return;
+    }
+
+    std::copy(data, data + size, buffer_.begin() + size_);
+    size_ += size;
+  }
+
+  void Write(const std::string &data) { Write(data.data(), data.size()); }
+
+  void Put(char c) {
+    if (size_ == buffer_.size()) Flush();
+    buffer_[size_++] = c;
+  }
+
+  // Writes an unsigned integer in decimal.
+  void WriteNumber(size_t value);
+
+  void Flush();
+
+  // Returns the number of bytes written so far, including those still on the buffer.
+  size_t bytes_written() const { return bytes_flushed_ + size_; }
+
+ private:
+  BufferedWriter(const BufferedWriter&) = delete;
+  BufferedWriter& operator=(const BufferedWriter&) = delete;
+
+  // Data larger than the buffer is written straight to the stream.
+  void WriteLarge(const char *data, size_t size);
+
+  std::ostream &out_;
+  std::vector<char> buffer_;
+  size_t size_;
+  size_t bytes_flushed_;
+};
+
+}  // namespace ipmt
+
+#endif  // IPMT_BUFFERED_WRITER_H_
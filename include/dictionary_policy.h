@@ -0,0 +1,14 @@
+#ifndef IPMT_DICTIONARY_POLICY_H_
+#define IPMT_DICTIONARY_POLICY_H_
+
+namespace ipmt {
+
+// What LZ78 does once its dictionary is full: empty it and start over, or keep it as it is.
+enum class DictionaryPolicy {
+  kReset,
+  kFreeze
+};
+
+}  // namespace ipmt
+
+#endif  // IPMT_DICTIONARY_POLICY_H_
@@ -1,52 +1,82 @@
 #ifndef IPMT_DYNAMIC_BITSET_H_
 #define IPMT_DYNAMIC_BITSET_H_
 
+#include <cstdint>
+#include <istream>
+#include <ostream>
 #include <string>
+#include <vector>
 
 namespace ipmt {
 
 typedef unsigned char byte_t;
 
-const int kDefaultBitsetCapacity = 1 << 3;
-
 // This class contains only the needed operations of a bitset for this project, it does not
-// implements all features of a real bitset.
+// implements all features of a real bitset. Bits are stored in 64-bit words, from the most
+// significant bit of each word to the least significant one; bits past the end are always zeros.
 class DynamicBitset {
  public:
-  DynamicBitset()
-      : data_(new byte_t[kDefaultBitsetCapacity]),
-        capacity_(kDefaultBitsetCapacity),
-        size_(0) { Flush(); }
-  DynamicBitset(const DynamicBitset &bitset);
-  ~DynamicBitset() { delete[] data_; }
-    
+  DynamicBitset() : size_(0) {}
+
   static const int kWordSize;
 
-  bool operator[](int index) const;
-  DynamicBitset& operator=(const DynamicBitset &bitset);
+  // Number of words needed to store size bits.
+  static size_t NumWords(size_t size) { return (size + kWordSize - 1) / kWordSize; }
+
+  bool operator[](size_t index) const {
+    return (words_[index / kWordSize] >> (kWordSize - 1 - index % kWordSize)) & 1;
+  }
+
+  // Appends the num_bits (at most 64) least significant bits of value, most significant first.
+  void AppendBits(uint64_t value, int num_bits) {
+    if (num_bits == 0) return;
+    if (num_bits < kWordSize) value &= (1ULL << num_bits) - 1;
+
+    int offset = size_ % kWordSize;
+    int free_bits = kWordSize - offset;
+
+    if (offset == 0) {
+      words_.push_back(value << (kWordSize - num_bits));
+    } else if (num_bits <= free_bits) {
+      words_.back() |= value << (free_bits - num_bits);
+    } else {
+      words_.back() |= value >> (num_bits - free_bits);
+      words_.push_back(value << (kWordSize - (num_bits - free_bits)));
+    }
 
-  void Append(byte_t word);
+    size_ += num_bits;
+  }
+
+  void Append(byte_t word) { AppendBits(word, 8); }
   void Append(const DynamicBitset &bitset);
-  DynamicBitset GetSubsetFromInterval(int start, int end) const;
-  void PushBack(bool value);
-  byte_t ReadWord(int index) const;
+  DynamicBitset GetSubsetFromInterval(size_t start, size_t end) const;
+  void PushBack(bool value) { AppendBits(value, 1); }
+  byte_t ReadWord(size_t index) const;
+  void Reserve(size_t size) { words_.reserve(NumWords(size)); }
+  // Resizes the bitset to size bits; new bits are zeros.
+  void Resize(size_t size) {
+    words_.resize(NumWords(size), 0);
+    size_ = size;
+    if (size % kWordSize != 0) words_.back() &= ~0ULL << (kWordSize - size % kWordSize);
+  }
   std::string ToString() const;
-  
+
+  // Reads size bits stored as bytes, most significant bit first, replacing the bitset contents.
+  void ReadBytes(std::istream &reader, size_t size);
+  // Writes the bits as bytes, most significant bit first; the last byte is padded with zeros.
+  void WriteBytes(std::ostream &writer) const;
+
   // Accessors.
-  const byte_t* data() const { return data_; }  // Returns the inner container.
-  int capacity() const { return capacity_; }  // Returns the inner container capacity.
-  int size() const { return size_; }  // Returns the number of elements of the bitset.
-    
- private:  
-  void Flush();
-  void Resize();
-
-  byte_t *data_;
-  int capacity_;
-  int size_;
+  const uint64_t* data() const { return words_.data(); }  // Returns the inner container.
+  uint64_t* mutable_data() { return words_.data(); }
+  size_t capacity() const { return kWordSize * words_.capacity(); }  // Capacity in bits.
+  size_t size() const { return size_; }  // Returns the number of elements of the bitset.
+
+ private:
+  std::vector<uint64_t> words_;
+  size_t size_;
 };
 
 }  // namespace ipmt
 
 #endif  //IPMT_DYNAMIC_BITSET_H_
-
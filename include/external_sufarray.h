@@ -0,0 +1,66 @@
+#ifndef IPMT_EXTERNAL_SUFARRAY_H_
+#define IPMT_EXTERNAL_SUFARRAY_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+#include "mapped_file.h"
+#include "packed_array.h"
+
+namespace ipmt {
+
+// Packed array stored on a temporary file of a scratch directory instead of memory. The file is
+// removed as soon as it is created, so it disappears along with the array, even if the process is
+// killed. It can be moved, but not copied.
+class ScratchArray {
+ public:
+  ScratchArray() = default;
+  ScratchArray(ScratchArray &&array) = default;
+  ScratchArray& operator=(ScratchArray &&array) = default;
+
+  // Creates an array of size zeros of the given width. Returns false if the file cannot be created.
+  bool Create(const std::string &dir, size_t size, int width);
+
+  // Adds the file of the array to releaser, whose pages it then drops from memory.
+  void AddTo(PageReleaser *releaser) const { releaser->Add(file_.data(), file_.size()); }
+
+  // Accessors.
+  const PackedArray& array() const { return array_; }
+  PackedArray* mutable_array() { return &array_; }
+
+ private:
+  ScratchArray(const ScratchArray&) = delete;
+  ScratchArray& operator=(const ScratchArray&) = delete;
+
+  MappedFile file_;
+  PackedArray array_;  // Mutable view of the file.
+};
+
+// Builds the suffix array and the LCP array of text[0, n) on scratch arrays of scratch_dir, using
+// about a third of memory_limit bytes for its buffers. The text must be a memory mapped file, as
+// must be the scratch arrays: their pages are dropped from memory each
+// ReleaseInterval(memory_limit) bytes gone through, so they do not add up either.
+//
+// Suffixes are sorted by prefix doubling (Manber and Myers, 1990, as adapted to external memory by
+// Dementiev et al., 2008): each round sorts the suffixes by the names of their first h characters
+// and of the h following ones, with an external merge sort which spills sorted runs of
+// memory_limit / 16 bytes to the scratch directory and merges them. The names are kept on a scratch
+// file, read and written at increasing positions through buffers. Suffixes are dropped from the
+// rounds as soon as their names are unique, but texts with long repeats still take O(log max_lcp)
+// rounds. Runs are sorted on num_threads threads. The LCP array is then computed from the values
+// which cannot be told from the previous suffix of the text, comparing pieces of the text sorted by
+// position, so the text is read in order, once more with external sorts.
+//
+// Returns false if the scratch files cannot be written (e.g. the disk is full).
+bool BuildSuffixArrayExternal(const char *text, size_t n, const std::string &scratch_dir,
+                              uint64_t memory_limit, int num_threads, ScratchArray *suffix_array,
+                              ScratchArray *lcp);
+
+// Returns how many bytes of memory mapped files are gone through between dropping their pages from
+// memory (see PageReleaser), for the given memory limit: a sixteenth of it, or 256 kB at least.
+uint64_t ReleaseInterval(uint64_t memory_limit);
+
+}  // namespace ipmt
+
+#endif  // IPMT_EXTERNAL_SUFARRAY_H_
@@ -0,0 +1,90 @@
+#ifndef IPMT_FM_INDEX_H_
+#define IPMT_FM_INDEX_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "occurrence_range.h"
+#include "packed_array.h"
+#include "rank_bitvector.h"
+#include "wavelet_tree.h"
+
+namespace ipmt {
+
+// FM-index (Ferragina and Manzini, 2000) of a text: its Burrows-Wheeler transform stored on a
+// wavelet tree, plus samples of the suffix array, for locating occurrences, and of its inverse,
+// for extracting text. It replaces both the suffix array and the text, so counting never decodes
+// any text and locating or printing decodes only the needed characters.
+//
+// The whole index is stored on a single array of words, which is either owned by the index (when
+// it is built) or a memory mapped index file. It can be moved, but not copied.
+class FMIndex {
+ public:
+  FMIndex() : data_(nullptr), num_words_(0), size_(0), primary_(0), sample_rate_(1) {}
+  FMIndex(FMIndex &&fm_index) = default;
+
+  FMIndex& operator=(FMIndex &&fm_index) = default;
+
+  static const size_t kDefaultSampleRate;
+
+  // Builds the FM-index of the text from its suffix array. One out of sample_rate suffix array
+  // entries (and inverse suffix array entries) is kept.
+  static FMIndex Build(const std::string &text, const PackedArray &suffix_array,
+                       size_t sample_rate = kDefaultSampleRate);
+  static FMIndex Build(const char *text, size_t n, const PackedArray &suffix_array,
+                       size_t sample_rate = kDefaultSampleRate);
+
+  // Makes this index a view of the words of an index built by Build. Returns false if they do not
+  // represent a valid index.
+  bool View(const uint64_t *data, size_t num_words);
+
+  // Returns the interval [begin, end) of rows of the BWT matrix prefixed by the pattern.
+  void BackwardSearch(const std::string &pattern, size_t *begin, size_t *end) const;
+  size_t Count(const std::string &pattern) const;
+  // Returns the sorted positions of the first min(limit, count) occurrences of the pattern in the
+  // text. Every row is still located, since rows are not in text order, but only limit are kept.
+  std::vector<size_t> Locate(const std::string &pattern, size_t limit = kNoLimit) const;
+  // Returns the text position of the suffix at the given row of the BWT matrix.
+  size_t LocateRow(size_t row) const;
+  // Returns text[pos, pos + length), clipped at the end of the text.
+  std::string Extract(size_t pos, size_t length) const;
+  // Returns the line of the text containing pos, without its line feed, and its first position.
+  std::string ExtractLine(size_t pos, size_t *line_start) const;
+
+  // Accessors.
+  const uint64_t* data() const { return data_; }
+  size_t num_words() const { return num_words_; }
+  size_t size() const { return size_; }  // Returns the length of the text.
+
+ private:
+  FMIndex(const FMIndex&) = delete;
+  FMIndex& operator=(const FMIndex&) = delete;
+
+  // Returns the number of occurrences of code in the first index rows of the BWT.
+  size_t Occ(uint8_t code, size_t index) const;
+  // LF mapping: returns the row of the suffix starting one position before the suffix at row, and
+  // stores the character preceding it on c.
+  size_t LF(size_t row, char *c) const;
+
+  std::vector<uint64_t> storage_;
+  const uint64_t *data_;
+  size_t num_words_;
+
+  size_t size_;
+  size_t primary_;  // Row of the whole text, whose BWT character is the sentinel.
+  size_t sample_rate_;
+  int code_[256];  // Code of each byte on the wavelet tree, or -1 if it does not occur.
+  char symbol_[256];  // Byte of each code.
+  size_t c_[257];  // Number of characters (sentinel included) smaller than each code.
+
+  WaveletTree bwt_;
+  RankBitvector sampled_;  // Rows whose suffix array entry is sampled.
+  PackedArray sa_samples_;
+  PackedArray isa_samples_;  // Rows of the suffixes at positions 0, s, 2s...
+};
+
+}  // namespace ipmt
+
+#endif  // IPMT_FM_INDEX_H_
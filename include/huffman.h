@@ -1,21 +1,83 @@
 #ifndef IPMT_HUFFMAN_H_
 #define IPMT_HUFFMAN_H_
 
+#include <array>
+#include <cstdint>
+#include <memory>
 #include <string>
 #include <unordered_map>
+#include <vector>
 
 #include "dynamic_bitset.h"
 #include "huffman_heap_node.h"
 
 namespace ipmt {
 
+// Codewords are never longer than this, so decoding takes at most two table lookups.
+const int kMaxCodeLength = 16;
+
+// Length of the canonical Huffman codeword of each byte, or 0 if the byte does not occur. Codewords
+// of the same length are consecutive integers, assigned in byte order, and shorter codewords come
+// first, so the lengths alone define the code.
+typedef std::array<uint8_t, 256> CodeLengths;
+
+// Number of occurrences of each byte of a text.
+typedef std::array<uint64_t, 256> FrequencyTable;
+
+// Codeword of each character, as stored by older versions of this tool.
 typedef std::unordered_map<char, DynamicBitset> CodeTable;
 
-HuffmanHeapNode* BuildTreeFromTable(const CodeTable &code_table);
-std::string HuffmanDecode(const DynamicBitset &code, HuffmanHeapNode *root);
-void HuffmanEncode(const std::string &text, DynamicBitset *code, CodeTable *code_table);
+class HuffmanDecodingTable;
+
+// Decoder of a canonical Huffman code whose lookup table is built once, for decoding many codes
+// with the same code lengths (e.g. the blocks of a text). Any number of threads may use it at once.
+class HuffmanDecoder {
+ public:
+  HuffmanDecoder();
+  explicit HuffmanDecoder(const CodeLengths &code_lengths);
+  HuffmanDecoder(HuffmanDecoder &&decoder);
+  ~HuffmanDecoder();
+
+  HuffmanDecoder& operator=(HuffmanDecoder &&decoder);
+
+  // Decodes length characters into text from the code on the given bitset words, starting at bit
+  // position. Bits past the last word are read as zeros.
+  void Decode(const uint64_t *words, size_t num_words, size_t position, size_t length,
+              char *text) const;
+
+ private:
+  std::unique_ptr<HuffmanDecodingTable> table_;  // Null if no byte has a codeword.
+};
+
+std::string HuffmanDecode(const DynamicBitset &code, const CodeLengths &code_lengths,
+                          size_t text_length);
+// As above, on up to num_threads threads. The code of text[(k + 1) * sync_interval, ...) starts at
+// bit sync_points[k], so the text is split at those characters and its parts decoded at once.
+std::string HuffmanDecode(const DynamicBitset &code, const CodeLengths &code_lengths,
+                          size_t text_length, const std::vector<uint64_t> &sync_points,
+                          size_t sync_interval, int num_threads);
+std::string HuffmanDecode(const DynamicBitset &code, const CodeTable &code_table,
+                          size_t text_length = std::string::npos);
+void HuffmanEncode(const std::string &text, DynamicBitset *code, CodeLengths *code_lengths);
+// Appends the code of text[0, length) to code, given code lengths covering all of its characters,
+// encoding chunks of the text on up to num_threads threads.
+void HuffmanEncode(const char *text, size_t length, const CodeLengths &code_lengths,
+                   DynamicBitset *code, int num_threads = 1);
+CodeLengths HuffmanCodeLengths(const std::string &text);
+// As above, counting the characters on up to num_threads threads.
+CodeLengths HuffmanCodeLengths(const char *text, size_t length, int num_threads = 1);
+// As above, from the number of occurrences of each byte, e.g. counted a part of the text at a time.
+CodeLengths HuffmanCodeLengths(const FrequencyTable &freq_table);
+// Adds the number of occurrences of each byte of text[0, length) to freq_table, counting on up to
+// num_threads threads.
+void CountCharacters(const char *text, size_t length, FrequencyTable *freq_table,
+                     int num_threads = 1);
+// Returns the number of bits of the code of each interval characters of text[0, length), the last
+// part being shorter if length is not a multiple of interval.
+std::vector<uint64_t> HuffmanCodeSizes(const char *text, size_t length,
+                                       const CodeLengths &code_lengths, size_t interval,
+                                       int num_threads = 1);
 
 }  // namespace ipmt
 
 #endif  // IPMT_HUFFMAN_H_
-
@@ -1,6 +1,7 @@
 #ifndef IPMT_HUFFMAN_HEAP_NODE_H_
 #define IPMT_HUFFMAN_HEAP_NODE_H_
 
+#include <cstdint>
 #include <iostream>
 
 namespace ipmt {
@@ -8,7 +9,7 @@ namespace ipmt {
 struct HuffmanHeapNode {
  public:
   HuffmanHeapNode() : left(nullptr), right(nullptr), c(0), freq(0) {}
-  HuffmanHeapNode(char c, int freq) : left(nullptr), right(nullptr), c(c), freq(freq) {}
+  HuffmanHeapNode(char c, uint64_t freq) : left(nullptr), right(nullptr), c(c), freq(freq) {}
 
   void PrintTree() const { PrintNode(this, 0); }
   int Height() const { return NodeHeight(this); }
@@ -17,7 +18,7 @@ struct HuffmanHeapNode {
   HuffmanHeapNode *left;
   HuffmanHeapNode *right;
   char c;
-  int freq;
+  uint64_t freq;
 
  private:
   void PrintNode(const HuffmanHeapNode *root, int tabs) const {
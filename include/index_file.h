@@ -0,0 +1,80 @@
+#ifndef IPMT_INDEX_FILE_H_
+#define IPMT_INDEX_FILE_H_
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+#include "block_text.h"
+#include "compression_type.h"
+#include "fm_index.h"
+#include "index_type.h"
+#include "lz78.h"
+#include "mapped_file.h"
+#include "occurrence_range.h"
+#include "packed_array.h"
+#include "stats.h"
+#include "sufarray.h"
+
+namespace ipmt {
+
+// Index loaded from an index file. Its arrays may be views of the memory mapped index file, which
+// is kept mapped for as long as the index is alive. Suffix array indexes fill the text (or
+// block_text, if it was stored in blocks), the suffix array and its LCP arrays; FM-indexes fill
+// only fm_index. Both fill the line samples. Index files written before the versioned format have
+// only the text and the suffix array.
+struct Index {
+  IndexType index_type;
+  std::string text;
+  BlockText block_text;
+  PackedArray suffix_array;
+  SearchLcp search_lcp;
+  CompressionType compression_type;
+  FMIndex fm_index;
+  PackedArray line_samples;  // See SampleLineStarts.
+  MappedFile file;
+};
+
+// Returns the length of the text of the index.
+size_t GetTextSize(const Index &index);
+// Returns text[pos, pos + length), clipped at the end of the text, decoding only what is needed.
+std::string ExtractText(const Index &index, size_t pos, size_t length);
+// Returns the line of the text containing pos, without its line feed, and its first position.
+std::string ExtractTextLine(const Index &index, size_t pos, size_t *line_start);
+size_t CountOccurrences(const Index &index, const std::string &pattern);
+// Returns the sorted positions of the first min(limit, count) occurrences of the pattern.
+std::vector<size_t> LocateOccurrences(const Index &index, const std::string &pattern,
+                                      size_t limit = kNoLimit);
+
+// Returns the index file name for the input text file name (its extension replaced by ".idx").
+std::string GetIndexPath(const std::string &pathname);
+
+// Returns 0 on success, -1 if the file cannot be opened, -2 if its compression type is invalid and
+// -3 if it is corrupted or has an unsupported version. If stats is given, the time spent decoding
+// the text goes to its "decode" phase and the rest to its "load" phase. A Huffman coded text is
+// decoded on up to num_threads threads if the index file has its sync points, serially otherwise.
+int ReadIndexFile(const std::string &index_path, Index *index, Stats *stats = nullptr,
+                  int num_threads = 1);
+// Both return 0 on success and -1 if the index file cannot be written. If block_size is not 0, the
+// text is compressed in blocks of block_size characters, which search mode decodes on demand. If
+// stats is given, the time spent compressing the text goes to its "encode" phase and the rest to
+// its "write" phase. Huffman coding runs on up to num_threads threads, with the same result.
+int WriteIndexFile(const std::string &index_path, const PackedArray &suffix_array,
+                   const SearchLcp &search_lcp, const PackedArray &line_samples,
+                   const std::string &text, const CompressionType &type,
+                   const LZ78Options &lz78_options = LZ78Options(), size_t block_size = 0,
+                   Stats *stats = nullptr, int num_threads = 1);
+// As above, for a text which may be memory mapped instead of loaded. If releaser is given, it is
+// advanced as the text and the arrays are gone through, so the pages of those mapped files added to
+// it are dropped from memory as they are written.
+int WriteIndexFile(const std::string &index_path, const PackedArray &suffix_array,
+                   const SearchLcp &search_lcp, const PackedArray &line_samples,
+                   const char *text, size_t text_size, const CompressionType &type,
+                   const LZ78Options &lz78_options = LZ78Options(), size_t block_size = 0,
+                   Stats *stats = nullptr, int num_threads = 1, PageReleaser *releaser = nullptr);
+int WriteFMIndexFile(const std::string &index_path, const FMIndex &fm_index,
+                     const PackedArray &line_samples, Stats *stats = nullptr);
+
+}  // namespace ipmt
+
+#endif  // IPMT_INDEX_FILE_H_
@@ -0,0 +1,39 @@
+#ifndef IPMT_INDEX_SEARCH_TEXT_H_
+#define IPMT_INDEX_SEARCH_TEXT_H_
+
+#include <string>
+#include <vector>
+
+#include "index_file.h"
+
+namespace ipmt {
+
+// Single index file, with the part of the interface of SegmentedIndex used by the regular
+// expression and approximate searches, so they are written once for both.
+class IndexSearchText {
+ public:
+  explicit IndexSearchText(const Index &index) : index_(index) {}
+
+  size_t Count(const std::string &pattern) const { return CountOccurrences(index_, pattern); }
+
+  std::vector<size_t> Locate(const std::string &pattern) const {
+    return LocateOccurrences(index_, pattern);
+  }
+
+  std::string Extract(size_t pos, size_t length) const {
+    return ExtractText(index_, pos, length);
+  }
+
+  std::string ExtractLine(size_t pos, size_t *line_start) const {
+    return ExtractTextLine(index_, pos, line_start);
+  }
+
+  size_t size() const { return GetTextSize(index_); }
+
+ private:
+  const Index &index_;
+};
+
+}  // namespace ipmt
+
+#endif  // IPMT_INDEX_SEARCH_TEXT_H_
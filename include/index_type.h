@@ -4,7 +4,8 @@
 namespace ipmt {
 
 enum class IndexType {
-  kSuffixArray
+  kSuffixArray,
+  kFMIndex
 };
 
 }  // namespace ipmt
@@ -0,0 +1,83 @@
+#ifndef IPMT_INDEXER_H_
+#define IPMT_INDEXER_H_
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "compression_type.h"
+#include "index_type.h"
+#include "lz78.h"
+#include "stats.h"
+#include "stats_format.h"
+#include "suffix_array_algorithm.h"
+
+namespace ipmt {
+
+// How index files are built, as given by the index mode options.
+struct IndexOptions {
+  IndexOptions()
+      : algorithm(SuffixArrayAlgorithm::kSAIS),
+        compression_type(CompressionType::kHuffman),
+        index_type(IndexType::kSuffixArray),
+        num_threads(1),
+        block_size(0),
+        memory_limit(0),
+        stats_format(StatsFormat::kNone) {}
+
+  SuffixArrayAlgorithm algorithm;
+  CompressionType compression_type;
+  IndexType index_type;
+  LZ78Options lz78_options;
+  int num_threads;  // Threads of the parallel suffix array construction and Huffman coding.
+  size_t block_size;  // Characters per compressed text block, or 0 to compress the text whole.
+  // Memory of each file built by the external algorithm, in bytes, and the directory of its
+  // temporary files (by default, the directory of the text file).
+  uint64_t memory_limit;
+  std::string scratch_dir;
+  StatsFormat stats_format;  // Statistics reported by IndexFiles for each file.
+};
+
+// Estimated peak memory, in bytes, to index a text of the given size with an in-memory algorithm.
+uint64_t EstimateIndexMemory(uint64_t text_size, SuffixArrayAlgorithm algorithm);
+
+// Builds the index file of a text file. Returns 0 on success, -1 if the text file cannot be read,
+// -2 if the index file cannot be written, -3 if there is not enough memory and -4 if the temporary
+// files of the external algorithm cannot be written. If stats is given, the time spent on each
+// phase ("read", "build", "encode" and "write") is added to it.
+//
+// The external algorithm maps the text file (or copies a text in memory to a temporary file)
+// instead of reading it, keeps the suffix array and the LCP arrays on temporary files and drops the
+// pages of those mappings from memory as it goes through them, so it stays within memory_limit,
+// except for the FM-index, the text blocks and the LZ78 code, which are built in memory.
+int IndexFile(const std::string &filename, const IndexOptions &options, Stats *stats = nullptr);
+// As above, writing the index to index_path instead of next to the text file.
+int IndexFile(const std::string &filename, const std::string &index_path,
+              const IndexOptions &options, Stats *stats = nullptr);
+// As above, for a text already in memory (phases other than "read").
+int IndexText(const std::string &text, const std::string &index_path, const IndexOptions &options,
+              Stats *stats = nullptr);
+
+// Builds the index files of all text files on up to num_jobs threads. Files run concurrently only
+// while their estimated memory (the memory limit, for the external algorithm) fits in memory_budget
+// bytes, although a file larger than the budget still runs alone. Failures are reported per file,
+// as are statistics (on the standard error) if requested; returns the number of files which failed.
+size_t IndexFiles(const std::vector<std::string> &filenames, const IndexOptions &options,
+                  int num_jobs, uint64_t memory_budget);
+
+// Indexes each text file, in the order given, as a new segment at the end of the segmented index
+// of the manifest, which is created if it does not exist. Either all files are appended or, if any
+// fails, none is. Failures and statistics are reported as by IndexFiles; returns false on failure.
+bool AppendSegments(const std::string &manifest_path, const std::vector<std::string> &filenames,
+                    const IndexOptions &options);
+
+// Merges runs of consecutive segments of the manifest into single segments, so searches fan out
+// over fewer of them: each segment is merged with the ones after it while they add up to at least
+// half of its size (all of them, if full is set), and empty segments are dropped. Matches spanning
+// the old boundaries are then found within the merged segments. Returns false on failure, leaving
+// the index as it was.
+bool CompactSegments(const std::string &manifest_path, const IndexOptions &options, bool full);
+
+}  // namespace ipmt
+
+#endif  // IPMT_INDEXER_H_
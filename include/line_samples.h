@@ -0,0 +1,27 @@
+#ifndef IPMT_LINE_SAMPLES_H_
+#define IPMT_LINE_SAMPLES_H_
+
+#include <cstddef>
+#include <string>
+
+#include "mapped_file.h"
+#include "packed_array.h"
+
+namespace ipmt {
+
+// Index files store the first position of every kLineSampleRate-th line of the text (lines 0, k,
+// 2k...), so the number of a line is found by counting the line feeds of at most k lines.
+const size_t kLineSampleRate = 16;
+
+PackedArray SampleLineStarts(const std::string &text);
+// As above, for a text which may be memory mapped, whose pages releaser (if given) drops from
+// memory as the text is scanned.
+PackedArray SampleLineStarts(const char *text, size_t length, PageReleaser *releaser = nullptr);
+
+// Returns the number of samples not greater than pos, i.e. the index of the last sampled line
+// starting at or before pos, plus one (0 if there are no samples).
+size_t CountLineSamples(const PackedArray &line_samples, size_t pos);
+
+}  // namespace ipmt
+
+#endif  // IPMT_LINE_SAMPLES_H_
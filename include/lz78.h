@@ -5,12 +5,27 @@
 #include <vector>
 #include <utility>
 
+#include "dictionary_policy.h"
+
 namespace ipmt {
 
-std::string LZ78Decode(const std::vector<std::pair<int, char>> &code);
-void LZ78Encode(const std::string &text, std::vector<std::pair<int, char>> *code);
+// Bounds the LZ78 dictionary to max_phrases phrases (0 means unbounded), handling a full dictionary
+// as set by the policy. The decoder must use the same options as the encoder.
+struct LZ78Options {
+  LZ78Options() : max_phrases(0), policy(DictionaryPolicy::kReset) {}
+
+  size_t max_phrases;
+  DictionaryPolicy policy;
+};
+
+std::string LZ78Decode(const std::vector<std::pair<int, char>> &code,
+                       const LZ78Options &options = LZ78Options(),
+                       size_t text_length = std::string::npos);
+void LZ78Encode(const std::string &text, std::vector<std::pair<int, char>> *code,
+                const LZ78Options &options = LZ78Options());
+void LZ78Encode(const char *text, size_t length, std::vector<std::pair<int, char>> *code,
+                const LZ78Options &options = LZ78Options());
 
 }  // namespace ipmt
 
 #endif  // IPMT_LZ78_H_
-
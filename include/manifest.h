@@ -0,0 +1,50 @@
+#ifndef IPMT_MANIFEST_H_
+#define IPMT_MANIFEST_H_
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace ipmt {
+
+// Segmented indexes split a text into consecutive parts (segments), each one indexed on its own
+// index file, which are listed in text order by a manifest file:
+//
+//   IPMT-MANIFEST 1 <next segment id>
+//   <segment index file> <text length> <number of line feeds>
+//   ...
+//
+// Segment index files are named relative to the directory of the manifest, and are never changed
+// once listed: appending text adds new segments, and compaction replaces runs of segments by a
+// single new one. The manifest itself is replaced as a whole, so readers see either the old or the
+// new list of segments.
+struct Segment {
+  std::string filename;
+  uint64_t size;
+  uint64_t line_feeds;
+};
+
+struct Manifest {
+  Manifest() : next_id(0) {}
+
+  uint64_t next_id;  // Segment files are numbered, so new ones never replace old ones.
+  std::vector<Segment> segments;
+};
+
+// Returns whether the file starts with the magic word of manifest files.
+bool IsManifestFile(const std::string &pathname);
+
+// Returns 0 on success, -1 if the file cannot be opened and -3 if it is not a valid manifest.
+int ReadManifest(const std::string &manifest_path, Manifest *manifest);
+// Returns false if the manifest cannot be written.
+bool WriteManifest(const std::string &manifest_path, const Manifest &manifest);
+
+// Returns the path of a segment index file listed by the manifest.
+std::string GetSegmentPath(const std::string &manifest_path, const std::string &filename);
+// Returns the file name of the segment with the given id: the manifest name without extension,
+// then the id, e.g. "corpus.3.idx" for "corpus.idm".
+std::string GetSegmentFilename(const std::string &manifest_path, uint64_t id);
+
+}  // namespace ipmt
+
+#endif  // IPMT_MANIFEST_H_
@@ -0,0 +1,78 @@
+#ifndef IPMT_MAPPED_FILE_H_
+#define IPMT_MAPPED_FILE_H_
+
+#include <cstddef>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace ipmt {
+
+// Memory mapping of a whole file, either read-only or, for temporary files, writable. The mapping
+// is released when the object is destroyed, so any pointer into it must not outlive the object. It
+// can be moved, but not copied.
+class MappedFile {
+ public:
+  MappedFile() : data_(nullptr), size_(0) {}
+  MappedFile(MappedFile &&file);
+  ~MappedFile() { Close(); }
+
+  MappedFile& operator=(MappedFile &&file);
+
+  // Returns false if the file cannot be opened or mapped.
+  bool Open(const std::string &pathname);
+  // Maps a new writable file of size bytes (all zeros) in dir, which is removed as soon as it is
+  // mapped, so it only takes disk space (and page cache) until it is closed. Returns false if the
+  // file cannot be created or mapped.
+  bool CreateTemporary(const std::string &dir, size_t size);
+  void Close();
+
+  // Accessors.
+  const char* data() const { return data_; }
+  char* mutable_data() { return const_cast<char*>(data_); }  // Only for temporary files.
+  size_t size() const { return size_; }
+  bool is_open() const { return data_ != nullptr; }
+
+ private:
+  MappedFile(const MappedFile&) = delete;
+  MappedFile& operator=(const MappedFile&) = delete;
+
+  const char *data_;
+  size_t size_;
+};
+
+// Drops the pages of memory mapped files from the memory of the process each time about interval
+// bytes of them were gone through, so scanning them takes no more than that much resident memory.
+// Dropped pages are read again from the page cache (or the file) when next accessed. The releaser
+// must not be used once the files of its ranges are unmapped.
+class PageReleaser {
+ public:
+  explicit PageReleaser(size_t interval) : interval_(interval), advanced_(0) {}
+
+  // Adds [data, data + size), which must be part of a file mapping: pages of anonymous memory (e.g.
+  // of the heap) would be zeroed.
+  void Add(const void *data, size_t size);
+  // Counts bytes more gone through (e.g. how far a scan moved), releasing the pages of all ranges
+  // once interval bytes were.
+  void Advance(size_t bytes) {
+    advanced_ += bytes;
+    if (advanced_ >= interval_) Release();
+  }
+  void Release();
+
+ private:
+  PageReleaser(const PageReleaser&) = delete;
+  PageReleaser& operator=(const PageReleaser&) = delete;
+
+  std::vector<std::pair<const char*, size_t>> ranges_;
+  size_t interval_;
+  size_t advanced_;
+};
+
+// Returns the descriptor of a new file in dir, open for reading and writing and already removed, or
+// -1 if it cannot be created.
+int OpenTemporaryFile(const std::string &dir);
+
+}  // namespace ipmt
+
+#endif  // IPMT_MAPPED_FILE_H_
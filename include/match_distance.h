@@ -0,0 +1,15 @@
+#ifndef IPMT_MATCH_DISTANCE_H_
+#define IPMT_MATCH_DISTANCE_H_
+
+namespace ipmt {
+
+// How approximate occurrences may differ from the pattern: by substituted characters only
+// (Hamming distance) or also by inserted and deleted ones (edit distance).
+enum class MatchDistance {
+  kHamming,
+  kEdit
+};
+
+}  // namespace ipmt
+
+#endif  // IPMT_MATCH_DISTANCE_H_
@@ -0,0 +1,74 @@
+#ifndef IPMT_OCCURRENCE_PRINTER_H_
+#define IPMT_OCCURRENCE_PRINTER_H_
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+#include "block_text.h"
+#include "buffered_writer.h"
+#include "fm_index.h"
+#include "packed_array.h"
+#include "segmented_index.h"
+
+namespace ipmt {
+
+// Prints each line of a text with occurrences of a pattern once, with the occurrences highlighted,
+// straight to a buffered writer. Only the lines printed are looked at: their bounds are found from
+// the occurrences themselves, and their numbers (if printed) by counting line feeds from the
+// closest sampled line start before them or from the last line printed, whichever is closer.
+class OccurrencePrinter {
+ public:
+  // Lines are numbered (from 1) if number_lines is set. Line samples may be empty (index files
+  // written before they were stored), in which case line feeds are counted from the last line
+  // printed.
+  OccurrencePrinter(BufferedWriter *writer, const PackedArray &line_samples, bool number_lines)
+      : writer_(writer), line_samples_(line_samples), number_lines_(number_lines) {}
+
+  // Printed before each line (and its number), e.g. the name of the index file.
+  void set_line_prefix(const std::string &line_prefix) { line_prefix_ = line_prefix; }
+
+  // Occurrences must be sorted by position.
+  void Print(const std::vector<size_t> &occurrences, const std::string &text,
+             size_t pattern_length);
+  // Only the lines with occurrences are decoded from the block text (or the FM-index).
+  void Print(const std::vector<size_t> &occurrences, const BlockText &text, size_t pattern_length);
+  void Print(const std::vector<size_t> &occurrences, const FMIndex &fm_index,
+             size_t pattern_length);
+  // Line numbers are counted from the samples of each segment instead of line_samples.
+  void Print(const std::vector<size_t> &occurrences, const SegmentedIndex &index,
+             size_t pattern_length);
+
+  // As above, for occurrences of different lengths (e.g. regular expression matches).
+  void Print(const std::vector<size_t> &occurrences, const std::vector<size_t> &lengths,
+             const std::string &text);
+  void Print(const std::vector<size_t> &occurrences, const std::vector<size_t> &lengths,
+             const BlockText &text);
+  void Print(const std::vector<size_t> &occurrences, const std::vector<size_t> &lengths,
+             const FMIndex &fm_index);
+  void Print(const std::vector<size_t> &occurrences, const std::vector<size_t> &lengths,
+             const SegmentedIndex &index);
+
+ private:
+  // Finds the closest position not after pos whose number of preceding line feeds is known.
+  // Returns false if there is none.
+  template <typename Text>
+  bool FindLineSample(const Text &text, size_t pos, size_t *sample_pos,
+                      size_t *sample_lines) const;
+  bool FindLineSample(const SegmentedIndex &index, size_t pos, size_t *sample_pos,
+                      size_t *sample_lines) const;
+
+  // Occurrence j is lengths[j] characters long, or pattern_length if lengths is null.
+  template <typename Text>
+  void PrintLines(const std::vector<size_t> &occurrences, const std::vector<size_t> *lengths,
+                  const Text &text, size_t pattern_length);
+
+  BufferedWriter *writer_;
+  const PackedArray &line_samples_;
+  bool number_lines_;
+  std::string line_prefix_;
+};
+
+}  // namespace ipmt
+
+#endif  // IPMT_OCCURRENCE_PRINTER_H_
@@ -0,0 +1,81 @@
+#ifndef IPMT_OCCURRENCE_RANGE_H_
+#define IPMT_OCCURRENCE_RANGE_H_
+
+#include <algorithm>
+#include <cstddef>
+#include <limits>
+#include <vector>
+
+#include "packed_array.h"
+
+namespace ipmt {
+
+// Limit on the number of occurrences located which keeps all of them.
+const size_t kNoLimit = std::numeric_limits<size_t>::max();
+
+// Sorts positions by least significant digit radix sort, a byte at a time, skipping the bytes above
+// the largest position. Few positions are sorted by std::sort.
+void RadixSort(std::vector<size_t> *positions);
+
+// Returns the min(limit, size) smallest of get(0), ..., get(size - 1), sorted. Below size, only the
+// limit smallest values seen so far are kept (on a max-heap), so nothing is allocated for the rest.
+template <typename Function>
+std::vector<size_t> SortSmallest(size_t size, size_t limit, Function get) {
+  std::vector<size_t> positions;
+
+  if (limit >= size) {
+    positions.reserve(size);
+    for (size_t i = 0; i < size; ++i) {
+      positions.push_back(get(i));
+    }
+
+    RadixSort(&positions);
+  } else if (limit > 0) {
+    positions.reserve(limit);
+
+    for (size_t i = 0; i < size; ++i) {
+      size_t pos = get(i);
+
+      if (positions.size() < limit) {
+        positions.push_back(pos);
+        std::push_heap(positions.begin(), positions.end());
+      } else if (pos < positions.front()) {
+        std::pop_heap(positions.begin(), positions.end());
+        positions.back() = pos;
+        std::push_heap(positions.begin(), positions.end());
+      }
+    }
+
+    std::sort_heap(positions.begin(), positions.end());
+  }
+
+  return positions;
+}
+
+// Occurrences of a pattern on a suffix array: the entries of its interval [left, right), in suffix
+// order. Nothing is read or copied until asked for, so counting the occurrences costs only the
+// search, and a few of them are read without listing the rest.
+class OccurrenceRange {
+ public:
+  OccurrenceRange(const PackedArray &suffix_array, size_t left, size_t right)
+      : suffix_array_(&suffix_array), left_(left), right_(right) {}
+
+  // Returns the position of the i-th occurrence, in suffix order.
+  size_t operator[](size_t i) const { return (*suffix_array_)[left_ + i]; }
+
+  // Returns the positions of the first min(limit, size()) occurrences in the text, sorted.
+  std::vector<size_t> Sorted(size_t limit = kNoLimit) const;
+
+  // Accessors.
+  bool empty() const { return left_ == right_; }
+  size_t size() const { return right_ - left_; }
+
+ private:
+  const PackedArray *suffix_array_;
+  size_t left_;
+  size_t right_;
+};
+
+}  // namespace ipmt
+
+#endif  // IPMT_OCCURRENCE_RANGE_H_
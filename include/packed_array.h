@@ -0,0 +1,107 @@
+#ifndef IPMT_PACKED_ARRAY_H_
+#define IPMT_PACKED_ARRAY_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace ipmt {
+
+// Fixed-width array of unsigned integers, where each entry takes exactly width() bits. It is used
+// to store suffix arrays (and LCP arrays) in ceil(log2 n) bits per entry, so small texts take less
+// space and texts larger than 2 GiB still fit in the same structure.
+//
+// An array either owns its words or is a view of words owned by someone else (e.g. a memory mapped
+// index file), in which case it must not outlive them. Views are read-only, unless made by
+// MutableView.
+class PackedArray {
+ public:
+  PackedArray() : data_(nullptr), mutable_data_(nullptr), mask_(1), size_(0), width_(1) {}
+  PackedArray(size_t size, int width) { Resize(size, width); }
+  // Takes over words, whose first size entries of the given width are kept and the rest dropped.
+  // Words must have at least NumWords(size, width) words.
+  PackedArray(std::vector<uint64_t> &&words, size_t size, int width);
+  PackedArray(const PackedArray &array);
+  PackedArray(PackedArray &&array);
+
+  static const int kWordSize;
+
+  // Returns the number of words needed to store size entries of the given width, including one
+  // padding word, so the last entry may always be read with two words.
+  static size_t NumWords(size_t size, int width);
+  // Returns the number of bits needed to represent value (at least 1).
+  static int RequiredWidth(uint64_t value);
+  // Returns a view of size entries of the given width stored on words.
+  static PackedArray View(const uint64_t *words, size_t size, int width);
+  // As View, but the entries may be set. Words must have NumWords(size, width) words.
+  static PackedArray MutableView(uint64_t *words, size_t size, int width);
+
+  PackedArray& operator=(const PackedArray &array);
+  PackedArray& operator=(PackedArray &&array);
+
+  uint64_t operator[](size_t index) const {
+    size_t bit = index * width_;
+    size_t word = bit >> 6;
+    int offset = bit & 63;
+
+    // The double shift handles offset == 0 without shifting by 64.
+    uint64_t value = (data_[word] >> offset) | ((data_[word + 1] << 1) << (63 - offset));
+    return value & mask_;
+  }
+
+  // Only available for arrays which own their words and mutable views.
+  void Set(size_t index, uint64_t value) {
+    size_t bit = index * width_;
+    size_t word = bit >> 6;
+    int offset = bit & 63;
+    uint64_t *words = mutable_data_;
+
+    value &= mask_;
+    words[word] = (words[word] & ~(mask_ << offset)) | (value << offset);
+    if (offset + width_ > 64) {
+      int written = 64 - offset;
+      words[word + 1] = (words[word + 1] & ~(mask_ >> written)) | (value >> written);
+    }
+  }
+
+  void Resize(size_t size, int width);
+
+  // Accessors.
+  const uint64_t* data() const { return data_; }  // Returns the inner container.
+  uint64_t* mutable_data() { return mutable_data_; }
+  size_t num_words() const { return NumWords(size_, width_); }  // Padding included.
+  size_t size() const { return size_; }  // Returns the number of entries of the array.
+  int width() const { return width_; }  // Returns the number of bits per entry.
+  bool empty() const { return size_ == 0; }
+  bool is_view() const { return data_ != words_.data(); }
+
+ private:
+  void SetWidth(int width);
+
+  std::vector<uint64_t> words_;
+  const uint64_t *data_;
+  uint64_t *mutable_data_;  // Null for read-only views.
+  uint64_t mask_;
+  size_t size_;
+  int width_;
+};
+
+// Packs the input values into an array with the smallest width able to store all of them.
+template <typename T>
+PackedArray PackArray(const std::vector<T> &values) {
+  uint64_t max_value = 0;
+  for (size_t i = 0; i < values.size(); ++i) {
+    if (static_cast<uint64_t>(values[i]) > max_value) max_value = values[i];
+  }
+
+  PackedArray packed(values.size(), PackedArray::RequiredWidth(max_value));
+  for (size_t i = 0; i < values.size(); ++i) {
+    packed.Set(i, values[i]);
+  }
+
+  return packed;
+}
+
+}  // namespace ipmt
+
+#endif  // IPMT_PACKED_ARRAY_H_
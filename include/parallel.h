@@ -0,0 +1,113 @@
+#ifndef IPMT_PARALLEL_H_
+#define IPMT_PARALLEL_H_
+
+#include <algorithm>
+#include <thread>
+#include <vector>
+
+namespace ipmt {
+
+// Returns the number of threads the hardware runs concurrently (at least 1).
+inline int HardwareThreads() {
+  return std::max(1, static_cast<int>(std::thread::hardware_concurrency()));
+}
+
+// Splits [0, size) into num_threads contiguous chunks and calls function(thread, begin, end) for
+// each one on its own thread. The calling thread runs the first chunk.
+template <typename Function>
+void ParallelFor(int num_threads, size_t size, Function function) {
+  num_threads = static_cast<int>(std::max<size_t>(1, std::min<size_t>(num_threads, size)));
+  std::vector<std::thread> threads;
+
+  for (int t = 1; t < num_threads; ++t) {
+    threads.emplace_back(function, t, size * t / num_threads, size * (t + 1) / num_threads);
+  }
+
+  function(0, 0, size / num_threads);
+
+  for (size_t t = 0; t < threads.size(); ++t) {
+    threads[t].join();
+  }
+}
+
+// Merges the sorted ranges [first1, last1) and [first2, last2) into out on num_threads threads.
+// The first range is split evenly, and the second one where the split elements would be inserted.
+template <typename Iterator, typename OutputIterator, typename Compare>
+void ParallelMerge(Iterator first1, Iterator last1, Iterator first2, Iterator last2,
+                   OutputIterator out, Compare comp, int num_threads) {
+  size_t size1 = last1 - first1;
+  num_threads = static_cast<int>(std::min<size_t>(num_threads, size1));
+
+  if (num_threads <= 1) {
+    std::merge(first1, last1, first2, last2, out, comp);
+    return;
+  }
+
+  std::vector<Iterator> splits(num_threads + 1, last2);
+  splits[0] = first2;
+  for (int t = 1; t < num_threads; ++t) {
+    Iterator split1 = first1 + size1 * t / num_threads;
+    splits[t] = split1 == last1 ? last2 : std::lower_bound(first2, last2, *split1, comp);
+  }
+
+  ParallelFor(num_threads, size1, [&](int t, size_t begin, size_t end) {
+    std::merge(first1 + begin, first1 + end, splits[t], splits[t + 1],
+               out + begin + (splits[t] - first2), comp);
+  });
+}
+
+// Sorts values on num_threads threads: each thread sorts a chunk, then chunks are merged in pairs,
+// all pairs at once, halving their number (and doubling the threads per merge) on each round.
+template <typename T, typename Compare>
+void ParallelSort(std::vector<T> *values, Compare comp, int num_threads) {
+  size_t size = values->size();
+  num_threads = static_cast<int>(std::max<size_t>(1, std::min<size_t>(num_threads, size / 1024)));
+
+  if (num_threads == 1) {
+    std::sort(values->begin(), values->end(), comp);
+    return;
+  }
+
+  std::vector<size_t> bounds(num_threads + 1);
+  for (int t = 0; t <= num_threads; ++t) {
+    bounds[t] = size * t / num_threads;
+  }
+
+  ParallelFor(num_threads, num_threads, [&](int, size_t begin, size_t end) {
+    for (size_t c = begin; c < end; ++c) {
+      std::sort(values->begin() + bounds[c], values->begin() + bounds[c + 1], comp);
+    }
+  });
+
+  std::vector<T> buffer(size);
+  std::vector<T> *from = values;
+  std::vector<T> *to = &buffer;
+
+  for (size_t width = 1; width < bounds.size() - 1; width *= 2) {
+    size_t num_chunks = bounds.size() - 1;
+    size_t num_merges = (num_chunks + 2 * width - 1) / (2 * width);
+    int threads_per_merge = std::max(1, num_threads / static_cast<int>(num_merges));
+
+    ParallelFor(static_cast<int>(num_merges), num_merges, [&](int, size_t begin, size_t end) {
+      for (size_t m = begin; m < end; ++m) {
+        size_t first = 2 * width * m;
+        size_t mid = std::min(first + width, num_chunks);
+        size_t last = std::min(first + 2 * width, num_chunks);
+
+        ParallelMerge(from->begin() + bounds[first], from->begin() + bounds[mid],
+                      from->begin() + bounds[mid], from->begin() + bounds[last],
+                      to->begin() + bounds[first], comp, threads_per_merge);
+      }
+    });
+
+    std::swap(from, to);
+  }
+
+  if (from != values) {
+    values->swap(buffer);
+  }
+}
+
+}  // namespace ipmt
+
+#endif  // IPMT_PARALLEL_H_
@@ -0,0 +1,59 @@
+#ifndef IPMT_RANK_BITVECTOR_H_
+#define IPMT_RANK_BITVECTOR_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace ipmt {
+
+// Read-only bitvector with constant time rank, stored as its bits followed by the cumulative number
+// of ones before each block of 512 bits (12.5% of overhead). It is a view of words owned by someone
+// else, which are written by Append.
+class RankBitvector {
+ public:
+  RankBitvector() : bits_(nullptr), ranks_(nullptr), size_(0) {}
+
+  // Appends the words representing the first size bits of bits (64 bits per word, the least
+  // significant bit first) to out.
+  static void Append(const std::vector<uint64_t> &bits, size_t size, std::vector<uint64_t> *out);
+  // Returns the number of words used by a bitvector of size bits.
+  static size_t NumWords(size_t size);
+
+  // Makes this bitvector a view of the words written by Append.
+  void View(const uint64_t *data, size_t size);
+
+  bool operator[](size_t index) const { return (bits_[index >> 6] >> (index & 63)) & 1; }
+
+  // Returns the number of ones in [0, index).
+  size_t Rank1(size_t index) const {
+    size_t word = index >> 6;
+    size_t rank = ranks_[index >> 9];
+
+    for (size_t i = (index >> 9) << 3; i < word; ++i) {
+      rank += __builtin_popcountll(bits_[i]);
+    }
+
+    if (index & 63) rank += __builtin_popcountll(bits_[word] << (64 - (index & 63)));
+
+    return rank;
+  }
+
+  // Returns the number of zeros in [0, index).
+  size_t Rank0(size_t index) const { return index - Rank1(index); }
+
+  // Returns the position of the (k + 1)-th one.
+  size_t Select1(size_t k) const;
+
+  // Accessors.
+  size_t size() const { return size_; }
+
+ private:
+  const uint64_t *bits_;
+  const uint64_t *ranks_;
+  size_t size_;
+};
+
+}  // namespace ipmt
+
+#endif  // IPMT_RANK_BITVECTOR_H_
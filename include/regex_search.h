@@ -0,0 +1,38 @@
+#ifndef IPMT_REGEX_SEARCH_H_
+#define IPMT_REGEX_SEARCH_H_
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+#include "index_file.h"
+#include "segmented_index.h"
+
+namespace ipmt {
+
+// Matches of a regular expression, sorted by position: where each one starts and its length.
+struct RegexMatches {
+  std::vector<size_t> positions;
+  std::vector<size_t> lengths;
+};
+
+// Returns literals such that every match of the POSIX extended regular expression contains at
+// least one of them, as short a list of as long literals as found, or an empty list if there are
+// none (e.g. "a.*b", "[0-9]+" or "x|.*"). Within alternations and repetitions, only literals
+// common to all branches and at least one repetition are kept; anything not understood is taken
+// as able to match any string, so the literals are always required.
+std::vector<std::string> ExtractRequiredLiterals(const std::string &regex);
+
+// Finds the matches of the POSIX extended regular expression within each line of the text, as
+// grep -E does, all non-overlapping matches of a line being reported. Only the lines holding
+// occurrences of the required literals of the expression, located on the index, are decoded and
+// matched, on num_threads threads; the whole text is scanned only if there are no literals or they
+// occur so often that looking them up would cost more. Returns false if the expression is invalid.
+bool FindRegexMatches(const std::string &regex, const Index &index, RegexMatches *matches,
+                      int num_threads = 1);
+bool FindRegexMatches(const std::string &regex, const SegmentedIndex &index,
+                      RegexMatches *matches, int num_threads = 1);
+
+}  // namespace ipmt
+
+#endif  // IPMT_REGEX_SEARCH_H_
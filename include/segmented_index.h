@@ -0,0 +1,67 @@
+#ifndef IPMT_SEGMENTED_INDEX_H_
+#define IPMT_SEGMENTED_INDEX_H_
+
+#include <cstddef>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "index_file.h"
+#include "manifest.h"
+#include "stats.h"
+
+namespace ipmt {
+
+// Index of a text split into segments (see Manifest), each one on its own index file of either
+// type. Searches run on every segment, on up to num_threads threads, and their positions are
+// shifted to positions of the whole text. Occurrences spanning the boundary between two segments
+// (or more, for short segments) are found on the text around each boundary, which is decoded for
+// that, so they are reported as if the text were indexed whole.
+class SegmentedIndex {
+ public:
+  SegmentedIndex() : num_threads_(1) {}
+
+  // Loads the segments listed by the manifest. Returns 0 on success, -1 if the manifest or a
+  // segment file cannot be opened, -2 if the compression type of a segment is invalid and -3 if
+  // the manifest or a segment is corrupted (e.g. its size does not match the manifest). Segment
+  // texts are decoded on num_threads threads.
+  int Open(const std::string &manifest_path, Stats *stats = nullptr);
+
+  size_t Count(const std::string &pattern) const;
+  // Returns the sorted positions of the first min(limit, count) occurrences of the pattern in the
+  // text. With a limit, segments are searched num_threads at a time, in text order, until enough
+  // occurrences are found.
+  std::vector<size_t> Locate(const std::string &pattern, size_t limit = kNoLimit) const;
+  // Returns text[pos, pos + length), clipped at the end of the text.
+  std::string Extract(size_t pos, size_t length) const;
+  // Returns the line of the text containing pos, without its line feed, and its first position.
+  std::string ExtractLine(size_t pos, size_t *line_start) const;
+  // Finds the closest position not after pos whose number of preceding line feeds is known (the
+  // start of its segment or a sampled line start of it), for numbering the line of pos.
+  void FindLineSample(size_t pos, size_t *sample_pos, size_t *sample_lines) const;
+
+  void set_num_threads(int num_threads) { num_threads_ = num_threads; }
+
+  // Accessors.
+  const Manifest& manifest() const { return manifest_; }
+  size_t num_segments() const { return segments_.size(); }
+  size_t segment_start(size_t i) const { return starts_[i]; }  // i may be num_segments().
+  size_t size() const { return starts_.empty() ? 0 : starts_.back(); }
+
+ private:
+  // Returns the segment holding pos (the last one, if pos is past the end of the text).
+  size_t FindSegment(size_t pos) const;
+  // Appends the positions of the occurrences starting in segment i which end past its end.
+  void LocateAcrossBoundary(const std::string &pattern, size_t i,
+                            std::vector<size_t> *occurrences) const;
+
+  Manifest manifest_;
+  std::vector<std::unique_ptr<Index>> segments_;
+  std::vector<size_t> starts_;  // Position of each segment on the text, plus the text length.
+  std::vector<size_t> line_feeds_;  // Line feeds before each segment.
+  int num_threads_;
+};
+
+}  // namespace ipmt
+
+#endif  // IPMT_SEGMENTED_INDEX_H_
@@ -0,0 +1,85 @@
+#ifndef IPMT_SERVER_H_
+#define IPMT_SERVER_H_
+
+#include <ctime>
+#include <istream>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include <sys/stat.h>
+
+#include "index_file.h"
+#include "segmented_index.h"
+
+namespace ipmt {
+
+// Keeps index files (or segmented indexes, given by their manifests) loaded and answers search
+// requests on them, one request per line:
+//
+//   count <pattern>   number of occurrences of the pattern.
+//   search <pattern>  lines of the text with occurrences of the pattern, printed as by search
+//                     mode: occurrences highlighted and, if set, line numbers.
+//   quit              closes the connection.
+//
+// The pattern is the rest of the line after the single space following the command. Each response
+// is made of data lines followed by a status line, either "OK <occurrences> <microseconds>" or
+// "ERR <message>". With more than one index file, data lines start with the index file name and a
+// colon, and count responses have one data line per index file.
+//
+// Requests run concurrently. Before each request, index files which changed on disk are loaded
+// again; requests running meanwhile keep using the old index until they finish. A file may change
+// from an index file to a manifest or the other way around.
+class SearchServer {
+ public:
+  SearchServer() : number_lines_(false) {}
+
+  // Loads the index files and manifests. Returns 0 on success or the status of ReadIndexFile (or
+  // SegmentedIndex::Open) for the first one which fails to load.
+  int Load(const std::vector<std::string> &index_paths);
+
+  // Answers requests read from in until it ends or a quit request.
+  void Serve(std::istream &in, std::ostream &out);
+
+  // Answers requests on connections to a Unix domain socket, each connection on its own thread,
+  // until the process is killed. Returns false if the socket cannot be created.
+  bool ServeSocket(const std::string &socket_path);
+
+  // Search responses number their lines (from 1) if set, as search mode's -n.
+  void set_number_lines(bool number_lines) { number_lines_ = number_lines; }
+
+ private:
+  // Index file or manifest kept loaded, along with what identifies the version loaded.
+  struct ResidentIndex {
+    std::string path;
+    std::shared_ptr<const Index> index;  // Empty for a manifest.
+    std::shared_ptr<const SegmentedIndex> segmented_index;  // Null unless for a manifest.
+    ino_t inode;
+    off_t size;
+    timespec modified;
+  };
+
+  // Returns the status line, appending the data lines to response.
+  std::string HandleRequest(const std::string &request, std::string *response);
+
+  // Loads the index file or manifest at path into resident, returning the status of
+  // ReadIndexFile or SegmentedIndex::Open (-3 if the file is too corrupted to be read at all).
+  static int LoadIndex(const std::string &path, ResidentIndex *resident);
+
+  // Returns the current version of each index file, loading those which changed on disk.
+  std::vector<ResidentIndex> AcquireIndexes();
+  void Reload(size_t i);
+
+  void ServeConnection(int fd);
+
+  std::vector<ResidentIndex> indexes_;
+  bool number_lines_;
+  std::mutex mutex_;  // Guards indexes_.
+  std::mutex reload_mutex_;  // Held while an index file is loaded again.
+};
+
+}  // namespace ipmt
+
+#endif  // IPMT_SERVER_H_
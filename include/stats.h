@@ -0,0 +1,60 @@
+#ifndef IPMT_STATS_H_
+#define IPMT_STATS_H_
+
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "stats_format.h"
+
+namespace ipmt {
+
+// Statistics of indexing or searching a file: wall-clock and CPU time of each phase, bytes read and
+// written, the size of the text and of its compressed form and the peak resident memory. CPU time
+// is the time of the whole process, so it includes the other files indexed meanwhile with -j.
+class Stats {
+ public:
+  Stats(const std::string &mode, const std::string &filename);
+
+  // Ends the current phase, if any, and starts the given one. Phases started more than once add
+  // up their time, and are reported in the order they first started.
+  void BeginPhase(const std::string &phase);
+  void EndPhase();
+
+  void AddBytesRead(uint64_t bytes) { bytes_read_ += bytes; }
+  void AddBytesWritten(uint64_t bytes) { bytes_written_ += bytes; }
+  void set_text_size(uint64_t size) { text_size_ = size; }
+  void set_compressed_size(uint64_t size) { compressed_size_ = size; }
+
+  // Ends the current phase and returns the statistics, without a final line feed.
+  std::string Format(StatsFormat format);
+
+ private:
+  struct Phase {
+    std::string name;
+    double wall_seconds;
+    double cpu_seconds;
+  };
+
+  std::string mode_;
+  std::string filename_;
+  std::vector<Phase> phases_;
+  size_t current_;  // Index of the current phase, or phases_.size() if none.
+  std::chrono::steady_clock::time_point wall_start_;
+  double cpu_start_;
+
+  uint64_t bytes_read_;
+  uint64_t bytes_written_;
+  uint64_t text_size_;
+  uint64_t compressed_size_;
+};
+
+// Resets the peak resident memory of the process, so the next call to PeakRssKb reports the peak
+// since then. Kernels without support for it keep the peak since the process started.
+void ResetPeakRss();
+long PeakRssKb();
+
+}  // namespace ipmt
+
+#endif  // IPMT_STATS_H_
@@ -0,0 +1,15 @@
+#ifndef IPMT_STATS_FORMAT_H_
+#define IPMT_STATS_FORMAT_H_
+
+namespace ipmt {
+
+// How statistics are reported: not at all, as human-readable text or as one JSON object per file.
+enum class StatsFormat {
+  kNone,
+  kText,
+  kJson
+};
+
+}  // namespace ipmt
+
+#endif  // IPMT_STATS_FORMAT_H_
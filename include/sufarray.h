@@ -2,13 +2,38 @@
 #define IPMT_INCLUDE_SUFARRAY_H_
 
 #include <string>
-#include <vector>
+
+#include "mapped_file.h"
+#include "packed_array.h"
+#include "suffix_array_algorithm.h"
 
 namespace ipmt{
 
-std::vector<int> BuildSuffixArray(const std::string &text);
+// Auxiliary arrays of Manber and Myers' search algorithm. For each midpoint m of the binary search
+// over the suffix array, llcp[m] (rlcp[m]) is the length of the longest common prefix between the
+// suffix at m and the suffix at the left (right) boundary of the interval which m splits.
+struct SearchLcp {
+  PackedArray llcp;
+  PackedArray rlcp;
+};
+
+PackedArray BuildLcpArray(const std::string &text, const PackedArray &suffix_array);
+SearchLcp BuildSearchLcp(const PackedArray &lcp);
+// Fills search arrays which already have the size and width of the LCP array, e.g. mutable views of
+// temporary files, whose pages releaser (if given) drops from memory as they are filled.
+void BuildSearchLcp(const PackedArray &lcp, SearchLcp *search_lcp,
+                    PageReleaser *releaser = nullptr);
+// Only the parallel prefix doubling algorithm uses more than one thread. The external algorithm
+// needs a scratch directory, so it is built by BuildSuffixArrayExternal instead; here it falls back
+// to SA-IS.
+PackedArray BuildSuffixArray(const std::string &text,
+                             SuffixArrayAlgorithm algorithm = SuffixArrayAlgorithm::kSAIS,
+                             int num_threads = 1);
+PackedArray BuildSuffixArrayManberMyers(const std::string &text);
+PackedArray BuildSuffixArrayParallel(const std::string &text, int num_threads);
+PackedArray BuildSuffixArraySAIS(const std::string &text);
 
-}  // namespace pmt
+}  // namespace ipmt
 
 #endif  // IPMT_INCLUDE_SUFARRAY_H_
 
@@ -0,0 +1,15 @@
+#ifndef IPMT_SUFFIX_ARRAY_ALGORITHM_H_
+#define IPMT_SUFFIX_ARRAY_ALGORITHM_H_
+
+namespace ipmt {
+
+enum class SuffixArrayAlgorithm {
+  kExternal,  // Prefix doubling on disk, for texts larger than the memory.
+  kManberMyers,
+  kParallelDoubling,
+  kSAIS
+};
+
+}  // namespace ipmt
+
+#endif  // IPMT_SUFFIX_ARRAY_ALGORITHM_H_
@@ -6,25 +6,65 @@
 
 #include <getopt.h>
 
-#include "compression_type.h"
+#include "block_text.h"
+#include "fm_index.h"
+#include "occurrence_range.h"
+#include "packed_array.h"
+#include "sufarray.h"
 
 namespace ipmt {
 
 typedef option Option;
 
+// Interval [left, right) of the suffix array whose suffixes start with a pattern.
+struct SuffixArrayInterval {
+  size_t left;
+  size_t right;
+
+  size_t size() const { return right - left; }
+};
+
 void PrintHelp();
 void PrintIndexModeHelp();
 void PrintSearchModeHelp();
+void PrintServeModeHelp();
+
+// Returns the length of the longest common prefix between pattern[0, length) and the suffix of the
+// text at pos, whose first from characters are known to match. If it is shorter than length, sets
+// is_smaller to whether the suffix is smaller than the pattern. The text is a std::string or a
+// BlockText, read character by character, as the block a comparison reads is kept by the thread.
+template <typename Text>
+size_t MatchPrefix(const std::string &pattern, size_t length, const Text &text, size_t pos,
+                   size_t from, bool *is_smaller) {
+  size_t j = from;
+  while (j < length && pos + j < text.size() && pattern[j] == text[pos + j]) ++j;
+
+  if (j < length) {
+    *is_smaller = pos + j >= text.size() ||
+                  static_cast<unsigned char>(text[pos + j]) <
+                  static_cast<unsigned char>(pattern[j]);
+  }
+
+  return j;
+}
 
-std::vector<int> GetOccurrences(const std::string &pattern, const std::string &text,
-                                const std::vector<int> &suffix_array);
-std::string PrintOccurrences(const std::vector<int> &occurrences, const std::string &text,
-                             size_t pattern_length);
+SuffixArrayInterval FindInterval(const std::string &pattern, const std::string &text,
+                                 const PackedArray &suffix_array, const SearchLcp &search_lcp);
+SuffixArrayInterval FindInterval(const std::string &pattern, const BlockText &text,
+                                 const PackedArray &suffix_array, const SearchLcp &search_lcp);
+// Returns the occurrences of the pattern, read from the suffix array only when asked for.
+OccurrenceRange FindOccurrences(const std::string &pattern, const std::string &text,
+                                const PackedArray &suffix_array, const SearchLcp &search_lcp);
+OccurrenceRange FindOccurrences(const std::string &pattern, const BlockText &text,
+                                const PackedArray &suffix_array, const SearchLcp &search_lcp);
+// Returns the sorted positions of the first min(limit, count) occurrences of the pattern.
+std::vector<size_t> GetOccurrences(const std::string &pattern, const std::string &text,
+                                   const PackedArray &suffix_array,
+                                   const SearchLcp &search_lcp, size_t limit = kNoLimit);
+std::vector<size_t> GetOccurrences(const std::string &pattern, const BlockText &text,
+                                   const PackedArray &suffix_array,
+                                   const SearchLcp &search_lcp, size_t limit = kNoLimit);
 std::vector<std::string> GetFilenames(const std::string &regex);
-int ReadIndexFile(const std::string &index_path, std::string *text,
-                  std::vector<int> *suffix_array);
-void WriteIndexFile(const std::string &pathname, const std::vector<int> &suffix_array,
-                    const std::string &text, const CompressionType &type);
 
 }  // namespace ipmt
 
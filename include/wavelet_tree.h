@@ -0,0 +1,54 @@
+#ifndef IPMT_WAVELET_TREE_H_
+#define IPMT_WAVELET_TREE_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "rank_bitvector.h"
+
+namespace ipmt {
+
+// Wavelet tree over a sequence of codes of up to 8 bits, with the levelwise layout of Claude and
+// Navarro's wavelet matrix (2012): level l stores the l-th most significant bit of every code, with
+// the codes stably sorted by their bits on the previous levels. Access and rank take O(levels)
+// time. Like RankBitvector, it is a view of words written by Append.
+class WaveletTree {
+ public:
+  WaveletTree() : levels_(0), size_(0) {}
+
+  static const int kMaxLevels = 8;
+
+  // Appends the words representing the input codes, each one with the given number of bits, to
+  // out.
+  static void Append(const std::vector<uint8_t> &codes, int levels, std::vector<uint64_t> *out);
+  // Returns the number of words used by a wavelet tree of size codes of the given number of bits.
+  static size_t NumWords(size_t size, int levels);
+
+  // Makes this wavelet tree a view of the words written by Append.
+  void View(const uint64_t *data, size_t size, int levels);
+
+  // Returns the code at index.
+  uint8_t operator[](size_t index) const;
+  // Returns the number of occurrences of code in [0, index).
+  size_t Rank(uint8_t code, size_t index) const;
+  // Returns the code at index and the number of its occurrences in [0, index), i.e. access and
+  // rank of the accessed code on a single pass.
+  size_t InverseSelect(size_t index, uint8_t *code) const;
+
+  // Accessors.
+  int levels() const { return levels_; }
+  size_t size() const { return size_; }
+
+ private:
+  RankBitvector bits_[kMaxLevels];
+  size_t zeros_[kMaxLevels];  // Number of zeros on each level.
+  // Position of the first occurrence of each code on the last level.
+  size_t begin_[1 << kMaxLevels];
+  int levels_;
+  size_t size_;
+};
+
+}  // namespace ipmt
+
+#endif  // IPMT_WAVELET_TREE_H_
@@ -0,0 +1,160 @@
+#include "approximate_search.h"
+
+#include <algorithm>
+#include <cstdint>
+
+#include "index_search_text.h"
+#include "parallel.h"
+
+namespace ipmt {
+namespace {
+
+// Interval [begin, end) of positions where approximate occurrences may start.
+struct Region {
+  size_t begin;
+  size_t end;
+};
+
+bool IsHammingMatch(const char *text, const std::string &pattern, size_t max_errors) {
+  size_t errors = 0;
+
+  for (size_t i = 0; i < pattern.size(); ++i) {
+    if (text[i] != pattern[i] && ++errors > max_errors) return false;
+  }
+
+  return true;
+}
+
+// Appends offset + j for each j < num_starts such that some window[j, end) is within max_errors
+// edits of the pattern. Sellers' algorithm (1980), which finds the smallest edit distance between
+// the pattern and the substrings of a text ending at each position, runs on the reversed pattern
+// and window, so it finds that distance for substrings starting at each position instead.
+void VerifyEdits(const std::string &window, size_t num_starts, size_t offset,
+                 const std::string &pattern, size_t max_errors, std::vector<size_t> *occurrences) {
+  size_t m = pattern.size();
+  std::vector<size_t> column(m + 1);  // column[i]: distance of the last i pattern characters.
+  std::vector<size_t> starts;  // In decreasing order.
+
+  for (size_t i = 0; i <= m; ++i) {
+    column[i] = i;
+  }
+
+  for (size_t j = window.size(); j-- > 0; ) {
+    size_t diagonal = column[0];
+
+    for (size_t i = 1; i <= m; ++i) {
+      size_t substitution = diagonal + (pattern[m - i] != window[j]);
+      diagonal = column[i];
+      column[i] = std::min(substitution, std::min(column[i], column[i - 1]) + 1);
+    }
+
+    if (j < num_starts && column[m] <= max_errors) {
+      starts.push_back(offset + j);
+    }
+  }
+
+  occurrences->insert(occurrences->end(), starts.rbegin(), starts.rend());
+}
+
+template <typename Text>
+std::vector<size_t> LocateApproximateIn(const std::string &pattern, size_t max_errors,
+                                        MatchDistance distance, const Text &text,
+                                        int num_threads) {
+  size_t m = pattern.size();
+  // How far from the position given by an exact piece an occurrence may start, and how much longer
+  // than the pattern it may be.
+  size_t slack = distance == MatchDistance::kEdit ? max_errors : 0;
+  size_t n = text.size();
+
+  if (m <= max_errors || m > n + slack) {
+    return std::vector<size_t>();
+  }
+
+  std::vector<Region> regions;
+  size_t num_pieces = max_errors + 1;
+
+  for (size_t p = 0; p < num_pieces; ++p) {
+    size_t piece_begin = m * p / num_pieces;
+    size_t piece_end = m * (p + 1) / num_pieces;
+    std::vector<size_t> seeds = text.Locate(pattern.substr(piece_begin, piece_end - piece_begin));
+
+    for (size_t i = 0; i < seeds.size(); ++i) {
+      int64_t start = static_cast<int64_t>(seeds[i]) - static_cast<int64_t>(piece_begin);
+      int64_t begin = std::max<int64_t>(0, start - static_cast<int64_t>(slack));
+      int64_t end = std::min<int64_t>(n, start + static_cast<int64_t>(slack) + 1);
+
+      if (begin < end) {
+        Region region = {static_cast<size_t>(begin), static_cast<size_t>(end)};
+        regions.push_back(region);
+      }
+    }
+  }
+
+  // Regions closer than the pattern length are merged, so text shared by their occurrences is
+  // decoded and verified once; every start of a merged region is verified.
+  std::sort(regions.begin(), regions.end(), [](const Region &lhs, const Region &rhs) {
+    return lhs.begin < rhs.begin;
+  });
+
+  size_t num_merged = 0;
+  for (size_t i = 0; i < regions.size(); ++i) {
+    if (num_merged > 0 && regions[i].begin <= regions[num_merged - 1].end + m) {
+      regions[num_merged - 1].end = std::max(regions[num_merged - 1].end, regions[i].end);
+    } else {
+      regions[num_merged++] = regions[i];
+    }
+  }
+
+  regions.resize(num_merged);
+
+  // Regions are verified on contiguous ranges per thread, so concatenating the occurrences of each
+  // thread keeps them sorted.
+  num_threads = static_cast<int>(std::max<size_t>(1, std::min<size_t>(num_threads,
+                                                                      regions.size())));
+  std::vector<std::vector<size_t>> thread_occurrences(num_threads);
+
+  ParallelFor(num_threads, regions.size(), [&](int t, size_t begin, size_t end) {
+    std::vector<size_t> &occurrences = thread_occurrences[t];
+
+    for (size_t r = begin; r < end; ++r) {
+      const Region &region = regions[r];
+      size_t num_starts = region.end - region.begin;
+      std::string window = text.Extract(region.begin, num_starts + m + slack - 1);
+
+      if (distance == MatchDistance::kEdit) {
+        VerifyEdits(window, num_starts, region.begin, pattern, max_errors, &occurrences);
+        continue;
+      }
+
+      for (size_t j = 0; j < num_starts && j + m <= window.size(); ++j) {
+        if (IsHammingMatch(window.data() + j, pattern, max_errors)) {
+          occurrences.push_back(region.begin + j);
+        }
+      }
+    }
+  });
+
+  std::vector<size_t> occurrences;
+  for (size_t t = 0; t < thread_occurrences.size(); ++t) {
+    occurrences.insert(occurrences.end(), thread_occurrences[t].begin(),
+                       thread_occurrences[t].end());
+  }
+
+  return occurrences;
+}
+
+}  // namespace
+
+std::vector<size_t> LocateApproximate(const std::string &pattern, size_t max_errors,
+                                      MatchDistance distance, const Index &index,
+                                      int num_threads) {
+  return LocateApproximateIn(pattern, max_errors, distance, IndexSearchText(index), num_threads);
+}
+
+std::vector<size_t> LocateApproximate(const std::string &pattern, size_t max_errors,
+                                      MatchDistance distance, const SegmentedIndex &index,
+                                      int num_threads) {
+  return LocateApproximateIn(pattern, max_errors, distance, index, num_threads);
+}
+
+}  // namespace ipmt
@@ -0,0 +1,138 @@
+#include "batch_search.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <numeric>
+
+#include "parallel.h"
+
+namespace ipmt {
+namespace {
+
+// Prefix of the pattern being searched (its first length characters) and its suffix array
+// interval.
+struct PrefixInterval {
+  size_t length;
+  SuffixArrayInterval interval;
+};
+
+size_t CommonPrefixLength(const std::string &lhs, const std::string &rhs) {
+  size_t length = std::min(lhs.size(), rhs.size());
+  return std::mismatch(lhs.begin(), lhs.begin() + length, rhs.begin()).first - lhs.begin();
+}
+
+// Binary search for a boundary of the first length characters of the pattern (as SearchBoundary
+// does for the whole pattern) within [left, right), whose suffixes all start with the first depth
+// characters of the pattern. Characters shared by the pattern and both ends of the current range
+// are not compared again.
+template <typename Text>
+size_t SearchBoundaryInRange(const std::string &pattern, size_t length, const Text &text,
+                             const PackedArray &suffix_array, size_t left, size_t right,
+                             size_t depth, bool upper) {
+  int64_t lo = static_cast<int64_t>(left) - 1;
+  int64_t hi = static_cast<int64_t>(right);
+  size_t l = depth;  // LCP between the pattern and the suffix at lo.
+  size_t r = depth;  // LCP between the pattern and the suffix at hi.
+
+  while (hi - lo > 1) {
+    int64_t mid = lo + (hi - lo) / 2;
+    bool is_smaller;
+    size_t j = MatchPrefix(pattern, length, text, suffix_array[mid], std::min(l, r), &is_smaller);
+
+    // Whether the suffix at mid belongs to the left side of the boundary.
+    bool is_left = j == length ? upper : is_smaller;
+
+    if (is_left) {
+      lo = mid;
+      l = j;
+    } else {
+      hi = mid;
+      r = j;
+    }
+  }
+
+  return hi;
+}
+
+// Narrows the interval of a prefix of the pattern down to the interval of its first length
+// characters.
+template <typename Text>
+PrefixInterval Narrow(const PrefixInterval &prefix, const std::string &pattern, size_t length,
+                      const Text &text, const PackedArray &suffix_array) {
+  PrefixInterval narrowed = {length, prefix.interval};
+  if (prefix.interval.size() == 0) return narrowed;
+
+  narrowed.interval.left = SearchBoundaryInRange(pattern, length, text, suffix_array,
+                                                 prefix.interval.left, prefix.interval.right,
+                                                 prefix.length, false);
+  narrowed.interval.right = SearchBoundaryInRange(pattern, length, text, suffix_array,
+                                                  narrowed.interval.left, prefix.interval.right,
+                                                  prefix.length, true);
+  return narrowed;
+}
+
+template <typename Text>
+std::vector<SuffixArrayInterval> SearchPatternsIn(const std::vector<std::string> &patterns,
+                                                  const Text &text,
+                                                  const PackedArray &suffix_array,
+                                                  const SearchLcp &search_lcp, int num_threads) {
+  std::vector<SuffixArrayInterval> intervals(patterns.size());
+  std::vector<size_t> order(patterns.size());
+  std::iota(order.begin(), order.end(), 0);
+
+  ParallelSort(&order, [&patterns](size_t lhs, size_t rhs) {
+    return patterns[lhs] < patterns[rhs];
+  }, num_threads);
+
+  ParallelFor(num_threads, order.size(), [&](int, size_t begin, size_t end) {
+    // Intervals of prefixes of the previous pattern, from the empty one (the whole suffix array)
+    // to the longest one.
+    PrefixInterval empty_prefix = {0, {0, suffix_array.size()}};
+    std::vector<PrefixInterval> prefixes(1, empty_prefix);
+
+    for (size_t k = begin; k < end; ++k) {
+      const std::string &pattern = patterns[order[k]];
+      size_t shared = k > begin ? CommonPrefixLength(patterns[order[k - 1]], pattern) : 0;
+
+      while (prefixes.back().length > shared) {
+        prefixes.pop_back();
+      }
+
+      // The shared prefix is kept, so the following patterns may start from it too.
+      if (prefixes.back().length < shared) {
+        prefixes.push_back(Narrow(prefixes.back(), pattern, shared, text, suffix_array));
+      }
+
+      if (prefixes.size() == 1 && !pattern.empty()) {
+        // Nothing shared: Manber and Myers' search on the whole suffix array.
+        PrefixInterval prefix = {pattern.size(),
+                                 FindInterval(pattern, text, suffix_array, search_lcp)};
+        prefixes.push_back(prefix);
+      } else if (prefixes.back().length < pattern.size()) {
+        prefixes.push_back(Narrow(prefixes.back(), pattern, pattern.size(), text, suffix_array));
+      }
+
+      intervals[order[k]] = prefixes.back().interval;
+    }
+  });
+
+  return intervals;
+}
+
+}  // namespace
+
+std::vector<SuffixArrayInterval> SearchPatterns(const std::vector<std::string> &patterns,
+                                                const std::string &text,
+                                                const PackedArray &suffix_array,
+                                                const SearchLcp &search_lcp, int num_threads) {
+  return SearchPatternsIn(patterns, text, suffix_array, search_lcp, num_threads);
+}
+
+std::vector<SuffixArrayInterval> SearchPatterns(const std::vector<std::string> &patterns,
+                                                const BlockText &text,
+                                                const PackedArray &suffix_array,
+                                                const SearchLcp &search_lcp, int num_threads) {
+  return SearchPatternsIn(patterns, text, suffix_array, search_lcp, num_threads);
+}
+
+}  // namespace ipmt
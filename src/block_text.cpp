@@ -0,0 +1,327 @@
+#include "block_text.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <list>
+#include <mutex>
+#include <unordered_map>
+#include <utility>
+
+#include "dynamic_bitset.h"
+
+namespace ipmt {
+namespace {
+
+// Layout of the words of a block text:
+//
+//   [0, kHeaderWords)  text length, block size, number of blocks, compression type, LZ78 dictionary
+//                      options and Huffman code lengths (8 per word).
+//   Word offset of each block from the first one, plus the offset of the end of the last block.
+//   Blocks. A Huffman block is the words of its code; an LZ78 block is its number of pairs, then
+//   the pairs as a phrase (4 bytes) and a character each, padded to a whole word.
+enum HeaderField {
+  kSizeField,
+  kBlockSizeField,
+  kNumBlocksField,
+  kCompressionField,
+  kMaxPhrasesField,
+  kPolicyField,
+  kCodeLengthsField
+};
+
+const size_t kHeaderWords = kCodeLengthsField + 256 / sizeof(uint64_t);
+const size_t kPairSize = sizeof(int) + sizeof(char);
+
+// Block last read by the calling thread, from any block text. The thread keeps it alive, so reading
+// it again needs neither the cache lock nor a reference count update.
+struct RecentBlock {
+  uint64_t text_id;  // 0 if there is none.
+  size_t block;
+  std::shared_ptr<const std::string> decoded;
+};
+
+thread_local RecentBlock recent_block = {0, 0, nullptr};
+
+// Tells the views apart, so a recent block is never mistaken for one of another text.
+std::atomic<uint64_t> next_text_id(1);
+
+void AppendBytes(const std::vector<char> &bytes, std::vector<uint64_t> *words) {
+  size_t first = words->size();
+  words->resize(first + (bytes.size() + sizeof(uint64_t) - 1) / sizeof(uint64_t), 0);
+  std::memcpy(words->data() + first, bytes.data(), bytes.size());
+}
+
+}  // namespace
+
+// Least recently used decoded blocks.
+class BlockText::Cache {
+ public:
+  explicit Cache(size_t capacity) : capacity_(capacity) {}
+
+  // Returns nullptr if the block is not cached.
+  std::shared_ptr<const std::string> Find(size_t block) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = positions_.find(block);
+    if (it == positions_.end()) return nullptr;
+
+    entries_.splice(entries_.begin(), entries_, it->second);
+    return it->second->second;
+  }
+
+  void Insert(size_t block, const std::shared_ptr<const std::string> &decoded) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (positions_.count(block)) return;  // Another thread decoded it meanwhile.
+
+    entries_.emplace_front(block, decoded);
+    positions_[block] = entries_.begin();
+
+    if (entries_.size() > capacity_) {
+      positions_.erase(entries_.back().first);
+      entries_.pop_back();
+    }
+  }
+
+ private:
+  typedef std::list<std::pair<size_t, std::shared_ptr<const std::string>>> Entries;
+
+  Entries entries_;  // Most recently used first.
+  std::unordered_map<size_t, Entries::iterator> positions_;
+  size_t capacity_;
+  std::mutex mutex_;
+};
+
+const size_t BlockText::kDefaultBlockSize = 1 << 16;
+const size_t BlockText::kCacheBlocks = 256;
+
+BlockText::BlockText()
+    : data_(nullptr), num_words_(0), size_(0), block_size_(1), num_blocks_(0),
+      type_(CompressionType::kHuffman), offsets_(nullptr), blocks_(nullptr), id_(0) {}
+
+BlockText::BlockText(BlockText &&text) = default;
+BlockText::~BlockText() = default;
+BlockText& BlockText::operator=(BlockText &&text) = default;
+
+BlockText BlockText::Build(const std::string &text, CompressionType type,
+                           const LZ78Options &lz78_options, size_t block_size) {
+  return Build(text.data(), text.size(), type, lz78_options, block_size);
+}
+
+BlockText BlockText::Build(const char *text, size_t text_size, CompressionType type,
+                           const LZ78Options &lz78_options, size_t block_size, int num_threads) {
+  size_t num_blocks = (text_size + block_size - 1) / block_size;
+  std::vector<uint64_t> words(kHeaderWords + num_blocks + 1, 0);
+
+  words[kSizeField] = text_size;
+  words[kBlockSizeField] = block_size;
+  words[kNumBlocksField] = num_blocks;
+  words[kCompressionField] = static_cast<uint64_t>(type);
+  words[kMaxPhrasesField] = lz78_options.max_phrases;
+  words[kPolicyField] = static_cast<uint64_t>(lz78_options.policy);
+
+  CodeLengths code_lengths;
+  if (type == CompressionType::kHuffman) {
+    code_lengths = HuffmanCodeLengths(text, text_size, num_threads);
+    std::memcpy(&words[kCodeLengthsField], code_lengths.data(), code_lengths.size());
+  }
+
+  size_t blocks_start = words.size();
+
+  for (size_t b = 0; b < num_blocks; ++b) {
+    size_t begin = b * block_size;
+    size_t length = std::min(block_size, text_size - begin);
+    words[kHeaderWords + b] = words.size() - blocks_start;
+
+    if (type == CompressionType::kHuffman) {
+      DynamicBitset code;
+      HuffmanEncode(text + begin, length, code_lengths, &code);
+      words.insert(words.end(), code.data(), code.data() + DynamicBitset::NumWords(code.size()));
+    } else {  // type == CompressionType::kLZ78.
+      std::vector<std::pair<int, char>> code;
+      LZ78Encode(text + begin, length, &code, lz78_options);
+
+      std::vector<char> bytes(code.size() * kPairSize);
+      for (size_t i = 0; i < code.size(); ++i) {
+        std::memcpy(&bytes[i * kPairSize], &code[i].first, sizeof(int));
+        bytes[i * kPairSize + sizeof(int)] = code[i].second;
+      }
+
+      words.push_back(code.size());
+      AppendBytes(bytes, &words);
+    }
+  }
+
+  words[kHeaderWords + num_blocks] = words.size() - blocks_start;
+
+  BlockText block_text;
+  block_text.storage_ = std::move(words);
+  block_text.View(block_text.storage_.data(), block_text.storage_.size());
+
+  return block_text;
+}
+
+bool BlockText::View(const uint64_t *data, size_t num_words) {
+  if (num_words < kHeaderWords) {
+    return false;
+  }
+
+  size_t size = data[kSizeField];
+  size_t block_size = data[kBlockSizeField];
+  size_t num_blocks = data[kNumBlocksField];
+
+  if (block_size == 0 || num_blocks != size / block_size + (size % block_size != 0) ||
+      data[kCompressionField] > static_cast<uint64_t>(CompressionType::kLZ78) ||
+      num_blocks + 1 > num_words - kHeaderWords) {
+    return false;
+  }
+
+  const uint64_t *offsets = data + kHeaderWords;
+  size_t blocks_words = num_words - kHeaderWords - (num_blocks + 1);
+
+  for (size_t b = 0; b < num_blocks; ++b) {
+    if (offsets[b] > offsets[b + 1]) return false;
+  }
+
+  if (offsets[num_blocks] > blocks_words) {
+    return false;
+  }
+
+  CodeLengths code_lengths;
+  std::memcpy(code_lengths.data(), &data[kCodeLengthsField], code_lengths.size());
+  for (size_t c = 0; c < code_lengths.size(); ++c) {
+    if (code_lengths[c] > kMaxCodeLength) return false;
+  }
+
+  data_ = data;
+  num_words_ = num_words;
+  size_ = size;
+  block_size_ = block_size;
+  num_blocks_ = num_blocks;
+  type_ = static_cast<CompressionType>(data[kCompressionField]);
+  lz78_options_.max_phrases = data[kMaxPhrasesField];
+  lz78_options_.policy = static_cast<DictionaryPolicy>(data[kPolicyField]);
+  offsets_ = offsets;
+  blocks_ = offsets + num_blocks + 1;
+  id_ = next_text_id++;
+  cache_.reset(new Cache(kCacheBlocks));
+
+  // The decoding table is built once for all blocks.
+  if (type_ == CompressionType::kHuffman) {
+    decoder_ = HuffmanDecoder(code_lengths);
+  }
+
+  return true;
+}
+
+char BlockText::operator[](size_t pos) const {
+  return GetBlock(pos / block_size_)[pos % block_size_];
+}
+
+std::string BlockText::Extract(size_t pos, size_t length) const {
+  std::string result;
+  if (pos >= size_) {
+    return result;
+  }
+
+  size_t end = pos + std::min(length, size_ - pos);
+  result.reserve(end - pos);
+
+  while (pos < end) {
+    size_t block = pos / block_size_;
+    size_t offset = pos % block_size_;
+    size_t count = std::min(block_size_ - offset, end - pos);
+
+    result.append(GetBlock(block), offset, count);
+    pos += count;
+  }
+
+  return result;
+}
+
+std::string BlockText::ExtractLine(size_t pos, size_t *line_start) const {
+  // Find the line start, a block at a time backwards.
+  size_t start = pos;
+
+  while (start > 0) {
+    const std::string &block = GetBlock((start - 1) / block_size_);
+    size_t block_start = (start - 1) / block_size_ * block_size_;
+    size_t lf_index = block.rfind('\n', start - 1 - block_start);
+
+    if (lf_index != std::string::npos) {
+      start = block_start + lf_index + 1;
+      break;
+    }
+
+    start = block_start;
+  }
+
+  // Find the line end, a block at a time forwards.
+  size_t end = pos;
+
+  while (end < size_) {
+    const std::string &block = GetBlock(end / block_size_);
+    size_t block_start = end / block_size_ * block_size_;
+    size_t lf_index = block.find('\n', end - block_start);
+
+    if (lf_index != std::string::npos) {
+      end = block_start + lf_index;
+      break;
+    }
+
+    end = std::min(size_, block_start + block_size_);
+  }
+
+  *line_start = start;
+
+  return Extract(start, end - start);
+}
+
+const std::string& BlockText::GetBlock(size_t block) const {
+  RecentBlock &recent = recent_block;
+  if (recent.text_id == id_ && recent.block == block) {
+    return *recent.decoded;
+  }
+
+  std::shared_ptr<const std::string> decoded = cache_->Find(block);
+
+  // Blocks are decoded outside of the cache lock, so threads decode different blocks at once.
+  if (!decoded) {
+    decoded = std::make_shared<const std::string>(DecodeBlock(block));
+    cache_->Insert(block, decoded);
+  }
+
+  recent.text_id = id_;
+  recent.block = block;
+  recent.decoded = std::move(decoded);
+
+  return *recent.decoded;
+}
+
+// Corrupted blocks decode to the right length, so positions within the block are always valid.
+std::string BlockText::DecodeBlock(size_t block) const {
+  size_t length = std::min(block_size_, size_ - block * block_size_);
+  const uint64_t *words = blocks_ + offsets_[block];
+  size_t num_words = offsets_[block + 1] - offsets_[block];
+  std::string text;
+
+  if (type_ == CompressionType::kHuffman) {
+    text.resize(length);
+    decoder_.Decode(words, num_words, 0, length, &text[0]);
+  } else if (num_words > 0) {  // type_ == CompressionType::kLZ78.
+    const char *bytes = reinterpret_cast<const char*>(words + 1);
+    size_t code_size = std::min<size_t>(words[0], (num_words - 1) * sizeof(uint64_t) / kPairSize);
+
+    std::vector<std::pair<int, char>> code(code_size);
+    for (size_t i = 0; i < code_size; ++i) {
+      std::memcpy(&code[i].first, &bytes[i * kPairSize], sizeof(int));
+      code[i].second = bytes[i * kPairSize + sizeof(int)];
+    }
+
+    text = LZ78Decode(code, lz78_options_, length);
+  }
+
+  text.resize(length, '\0');
+  return text;
+}
+
+}  // namespace ipmt
@@ -0,0 +1,44 @@
+#include "buffered_writer.h"
+
+namespace ipmt {
+
+const size_t BufferedWriter::kDefaultCapacity = 1 << 20;
+
+BufferedWriter::BufferedWriter(std::ostream &out, size_t capacity)
+    : out_(out), buffer_(capacity > 0 ? capacity : 1), size_(0), bytes_flushed_(0) {}
+
+void BufferedWriter::WriteNumber(size_t value) {
+  char digits[20];
+  int length = 0;
+
+  do {
+    digits[length++] = static_cast<char>('0' + value % 10);
+    value /= 10;
+  } while (value > 0);
+
+  while (length > 0) Put(digits[--length]);
+}
+
+void BufferedWriter::Flush() {
+  if (size_ > 0) {
+    out_.write(buffer_.data(), size_);
+    bytes_flushed_ += size_;
+    size_ = 0;
+  }
+
+  out_.flush();
+}
+
+void BufferedWriter::WriteLarge(const char *data, size_t size) {
+  Flush();
+
+  if (size < buffer_.size()) {
+    std::copy(data, data + size, buffer_.begin());
+    size_ = size;
+  } else {
+    out_.write(data, size);
+    bytes_flushed_ += size;
+  }
+}
+
+}  // namespace ipmt
@@ -3,126 +3,95 @@
 #include <algorithm>
 
 namespace ipmt {
+namespace {
 
-const int DynamicBitset::kWordSize = 8 * sizeof(byte_t);
+// Bytes moved per read or write call by the bulk I/O functions.
+const size_t kBufferSize = 1 << 16;
 
-DynamicBitset::DynamicBitset(const DynamicBitset &bitset)
-    : data_(new byte_t[bitset.capacity()]),
-      capacity_(bitset.capacity()),
-      size_(bitset.size()) {
-  std::copy_n(bitset.data(), bitset.capacity(), data_);
-}
-
-void DynamicBitset::Flush() {
-  std::fill_n(data_, capacity_, 0);
-  size_ = 0;
-}
-
-void DynamicBitset::Resize() {
-  int new_capacity = capacity_ << 1;
-  byte_t *new_data = new byte_t[new_capacity];
-
-  std::copy_n(data_, capacity_, new_data);
+}  // namespace
 
-  delete[] data_;
-  data_ = new_data;
-  capacity_ = new_capacity;
-}
+const int DynamicBitset::kWordSize = 64;
 
-bool DynamicBitset::operator[](int index) const {
-  int word_index = index / kWordSize;
-  int bit_index = (kWordSize - (index % kWordSize + 1));
+void DynamicBitset::Append(const DynamicBitset &bitset) {
+  size_t num_words = NumWords(bitset.size());
 
-  return (data_[word_index]) & (1 << bit_index);
+  for (size_t i = 0; i < num_words; ++i) {
+    int bits = static_cast<int>(std::min<size_t>(kWordSize, bitset.size() - i * kWordSize));
+    AppendBits(bitset.words_[i] >> (kWordSize - bits), bits);
+  }
 }
 
-DynamicBitset& DynamicBitset::operator=(const DynamicBitset &bitset) {
-  if (this != &bitset) {
-    if (capacity_ < bitset.capacity()) {  // Reallocate inner container.
-      delete[] data_;
-      data_ = new byte_t[bitset.capacity()];
-      capacity_ = bitset.capacity();
-    }
+DynamicBitset DynamicBitset::GetSubsetFromInterval(size_t start, size_t end) const {
+  DynamicBitset subset;
+  end = std::min(end, size_);
 
-    std::copy_n(bitset.data(), bitset.capacity(), data_);
-    size_ = bitset.size();
+  for (size_t i = start; i < end; ++i) {
+    subset.PushBack((*this)[i]);
   }
 
-  return *this;
+  return subset;
 }
 
-void DynamicBitset::Append(byte_t word) {
-  for (int i = kWordSize - 1; i >= 0; --i) {
-    PushBack(word & (1 << i));
-  }
-}
+byte_t DynamicBitset::ReadWord(size_t index) const {
+  byte_t result = 0;
 
-void DynamicBitset::Append(const DynamicBitset &bitset) {
-  for (int i = 0; i < bitset.size(); ++i) {
-    PushBack(bitset[i]);
+  for (size_t i = 0; i < 8; ++i) {
+    if (index + i < size_ && (*this)[index + i]) {
+      result |= 1 << (7 - i);
+    }
   }
+
+  return result;
 }
 
-DynamicBitset DynamicBitset::GetSubsetFromInterval(int start, int end) const {
-  DynamicBitset subset;
+std::string DynamicBitset::ToString() const {
+  std::string result;
+  result.reserve(size_);
 
-  for (int i = start; i < end; ++i) {
-    if (i < size_) {
-      int word_index = i / kWordSize;
-      int bit_index = (kWordSize - (i % kWordSize + 1));
-      subset.PushBack((data_[word_index]) & (1 << bit_index));
-    }
+  for (size_t i = 0; i < size_; ++i) {
+    result.push_back((*this)[i] ? '1' : '0');
   }
 
-  return subset;
+  return result;
 }
 
-void DynamicBitset::PushBack(bool value) {
-  if (size_ == kWordSize * capacity_) Resize();
+void DynamicBitset::ReadBytes(std::istream &reader, size_t size) {
+  size_t num_bytes = (size + 7) / 8;
+  std::vector<byte_t> buffer(std::min(num_bytes, kBufferSize));
 
-  int word_index = size_ / kWordSize;
-  int bit_index = (kWordSize - (size_ % kWordSize + 1));
-  ++size_;
+  words_.assign(NumWords(size), 0);
+  size_ = size;
 
-  if (value) data_[word_index] |= 1 << bit_index;
-  else data_[word_index] &= ~(1 << bit_index);
-}
-
-byte_t DynamicBitset::ReadWord(int index) const {
-  byte_t result = 0;
+  for (size_t begin = 0; begin < num_bytes; begin += buffer.size()) {
+    size_t count = std::min(buffer.size(), num_bytes - begin);
+    reader.read(reinterpret_cast<char*>(buffer.data()), count);
 
-  for (int i = 0; i < kWordSize; ++i) {
-    int curr_index = index + i;
-    if (curr_index < size_) {
-      int word_index = curr_index / kWordSize;
-      int bit_index = (kWordSize - (curr_index % kWordSize + 1));
-      result |= (data_[word_index]) & (1 << bit_index);
+    for (size_t i = 0; i < count; ++i) {
+      size_t byte = begin + i;
+      words_[byte / 8] |= static_cast<uint64_t>(buffer[i]) << (56 - 8 * (byte % 8));
     }
   }
 
-  return result;
+  // Clear the padding of the last byte, so bits past the end stay zeros.
+  if (size % kWordSize != 0) {
+    words_.back() &= ~0ULL << (kWordSize - size % kWordSize);
+  }
 }
 
-std::string DynamicBitset::ToString() const {
-  std::string result;
-  result.reserve(size_);
-  
-  int bit_index = kWordSize - 1;
-  int word_index = 0;
-
-  for (int i = 0; i < size_; ++i) {
-    char masked_bit = ((data_[word_index] & (1 << bit_index)) >> bit_index);
-    result.push_back(masked_bit + '0');
-    --bit_index;
-
-    if (bit_index == 0) {
-      bit_index = kWordSize - 1;
-      ++word_index;
-    }    
-  }
+void DynamicBitset::WriteBytes(std::ostream &writer) const {
+  size_t num_bytes = (size_ + 7) / 8;
+  std::vector<byte_t> buffer(std::min(num_bytes, kBufferSize));
 
-  return result;
+  for (size_t begin = 0; begin < num_bytes; begin += buffer.size()) {
+    size_t count = std::min(buffer.size(), num_bytes - begin);
+
+    for (size_t i = 0; i < count; ++i) {
+      size_t byte = begin + i;
+      buffer[i] = static_cast<byte_t>(words_[byte / 8] >> (56 - 8 * (byte % 8)));
+    }
+
+    writer.write(reinterpret_cast<const char*>(buffer.data()), count);
+  }
 }
 
 }  // namespace ipmt
-
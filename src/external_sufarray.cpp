@@ -0,0 +1,861 @@
+#include "external_sufarray.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <functional>
+#include <limits>
+#include <memory>
+#include <utility>
+#include <vector>
+
+#include <unistd.h>
+
+#include "parallel.h"
+
+namespace ipmt {
+namespace {
+
+// Length of the prefixes named before the first doubling round, the most that fit in a name along
+// with their length.
+const size_t kInitialLength = 7;
+
+// Smallest number of values of a run (or of its merge buffer), so tiny memory limits still make
+// progress.
+const size_t kMinRunSize = 1 << 12;
+
+// Bytes of text compared at once when computing the LCP array, packed in a word (see LoadPiece).
+const uint64_t kPieceLength = sizeof(uint64_t);
+
+// Stands for the character before the first suffix of the text, which is none.
+const uint64_t kNoCharacter = 256;
+
+// Stands for the LCP value of a suffix which is that of the previous suffix of the text, minus one.
+const uint64_t kReducible = std::numeric_limits<uint64_t>::max();
+
+// Suffix at pos, named by its first h characters and by the h characters following them.
+struct NamedSuffix {
+  uint64_t name;
+  uint64_t next_name;
+  uint64_t pos;
+};
+
+// Suffix at pos, with its new name and whether other suffixes have the same name.
+struct RenamedSuffix {
+  uint64_t pos;
+  uint64_t name;
+  bool is_shared;
+};
+
+struct KeyValue {
+  uint64_t key;
+  uint64_t value;
+};
+
+// Suffix at pos, preceded on the suffix array by the suffix at prev_pos.
+struct AdjacentSuffixes {
+  uint64_t pos;
+  uint64_t prev_pos;
+};
+
+// As above, along with the character before the suffix at pos (or kNoCharacter) and the piece of
+// text it starts with, of piece_size characters.
+struct PhiSuffix {
+  uint64_t prev_pos;
+  uint64_t pos;
+  uint64_t piece;
+  uint32_t before;
+  uint32_t piece_size;
+};
+
+// Pieces of text to compare: the one at a, within the suffix at pos, and the one at b, as far
+// within the suffix before it on the suffix array. Once read, the piece at a is stored on piece,
+// and size holds its number of characters; once compared, size holds the number of them equal to
+// the characters at b.
+struct Comparison {
+  uint64_t pos;
+  uint64_t a;
+  uint64_t b;
+  uint64_t piece;
+  uint64_t size;
+};
+
+// Ties are broken by position, so the order does not depend on the number of threads.
+struct ByNames {
+  bool operator()(const NamedSuffix &lhs, const NamedSuffix &rhs) const {
+    if (lhs.name != rhs.name) return lhs.name < rhs.name;
+    if (lhs.next_name != rhs.next_name) return lhs.next_name < rhs.next_name;
+    return lhs.pos < rhs.pos;
+  }
+};
+
+struct ByPosition {
+  template <typename Suffix>
+  bool operator()(const Suffix &lhs, const Suffix &rhs) const {
+    return lhs.pos < rhs.pos;
+  }
+};
+
+struct ByPreviousPosition {
+  bool operator()(const PhiSuffix &lhs, const PhiSuffix &rhs) const {
+    return lhs.prev_pos < rhs.prev_pos;
+  }
+};
+
+struct ByKey {
+  bool operator()(const KeyValue &lhs, const KeyValue &rhs) const {
+    return lhs.key < rhs.key;
+  }
+};
+
+struct ByA {
+  bool operator()(const Comparison &lhs, const Comparison &rhs) const {
+    return lhs.a < rhs.a;
+  }
+};
+
+struct ByB {
+  bool operator()(const Comparison &lhs, const Comparison &rhs) const {
+    return lhs.b < rhs.b;
+  }
+};
+
+// The pieces of each suffix in text order.
+struct BySuffixAndA {
+  bool operator()(const Comparison &lhs, const Comparison &rhs) const {
+    if (lhs.pos != rhs.pos) return lhs.pos < rhs.pos;
+    return lhs.a < rhs.a;
+  }
+};
+
+// External merge sort of fixed-size values. Values are added to a buffer, which is sorted and
+// written to a temporary file (a run) whenever it fills up; Sort then merges all runs at once. If
+// every value fits in the buffer, nothing is written at all.
+//
+// The buffer takes a sixteenth of the memory limit, and sorting it takes as much again, which the
+// run buffers of the merge take too. Callers keep up to three sorters alive at once (e.g. one
+// being merged into two being filled), so sorting takes at most a quarter of the limit.
+template <typename T, typename Compare>
+class ExternalSorter {
+ public:
+  ExternalSorter(const std::string &dir, uint64_t memory_limit, size_t expected_size,
+                 int num_threads)
+      : dir_(dir),
+        capacity_(std::max<uint64_t>(kMinRunSize, memory_limit / (16 * sizeof(T)))),
+        num_threads_(num_threads),
+        next_(0),
+        failed_(false) {
+    buffer_.reserve(std::min(capacity_, expected_size));
+  }
+
+  ~ExternalSorter() {
+    for (size_t r = 0; r < runs_.size(); ++r) {
+      std::fclose(runs_[r].file);
+    }
+  }
+
+  void Add(const T &value) {
+    buffer_.push_back(value);
+    if (buffer_.size() == capacity_) Spill();
+  }
+
+  // Sorts the values added so far. Returns false if a run cannot be written.
+  bool Sort() {
+    if (runs_.empty()) {
+      ParallelSort(&buffer_, Compare(), num_threads_);
+      return !failed_;
+    }
+
+    if (!buffer_.empty()) Spill();
+    std::vector<T>().swap(buffer_);
+
+    // Each run merged needs a buffer of kMinRunSize values at least, so if there are too many runs
+    // for the memory, the first ones are merged into a longer run beforehand.
+    size_t max_runs = std::max<size_t>(2, capacity_ / kMinRunSize);
+    while (runs_.size() > max_runs && !failed_) {
+      MergeRuns(max_runs);
+    }
+
+    StartMerge(runs_.size());
+
+    return !failed_;
+  }
+
+  // Stores the next value, in sorted order, on value. Returns false once all values were returned
+  // or if a run cannot be read.
+  bool Next(T *value) {
+    if (runs_.empty()) {
+      if (next_ == buffer_.size()) return false;
+
+      *value = buffer_[next_++];
+      return true;
+    }
+
+    return !failed_ && Pop(value);
+  }
+
+  bool failed() const { return failed_; }
+
+ private:
+  struct Run {
+    std::FILE *file;
+    std::vector<T> buffer;
+    size_t pos;  // Next value of the buffer.
+    size_t size;  // Values read into the buffer.
+  };
+
+  typedef std::pair<T, size_t> HeapEntry;  // Head of a run and the run.
+
+  // Inverts the order, so the heap top is the smallest head.
+  struct HeapCompare {
+    bool operator()(const HeapEntry &lhs, const HeapEntry &rhs) const {
+      return Compare()(rhs.first, lhs.first);
+    }
+  };
+
+  // Appends a run with the given values, which must be sorted.
+  void WriteRun(const std::vector<T> &values) {
+    int fd = OpenTemporaryFile(dir_);
+    std::FILE *file = fd == -1 ? nullptr : fdopen(fd, "w+b");
+
+    if (!file) {
+      if (fd != -1) close(fd);
+      failed_ = true;
+      return;
+    }
+
+    if (std::fwrite(values.data(), sizeof(T), values.size(), file) != values.size()) {
+      failed_ = true;
+    }
+
+    Run run = {file, std::vector<T>(), 0, 0};
+    runs_.push_back(std::move(run));
+  }
+
+  void Spill() {
+    ParallelSort(&buffer_, Compare(), num_threads_);
+    WriteRun(buffer_);
+    buffer_.clear();
+  }
+
+  // Splits the memory among the first num_runs runs and reads their first values.
+  void StartMerge(size_t num_runs) {
+    size_t run_buffer_size = std::max(kMinRunSize, capacity_ / num_runs);
+    heap_.clear();
+
+    for (size_t r = 0; r < num_runs; ++r) {
+      std::rewind(runs_[r].file);
+      runs_[r].buffer.resize(run_buffer_size);
+      if (Fill(r)) PushHead(r);
+    }
+  }
+
+  // Replaces the first num_runs runs by a single run with their values, merged a buffer at a time.
+  void MergeRuns(size_t num_runs) {
+    StartMerge(num_runs);
+
+    std::vector<T> merged;
+    merged.reserve(kMinRunSize);
+    size_t first_run = runs_.size();
+
+    for (T value; !failed_ && Pop(&value); ) {
+      merged.push_back(value);
+
+      if (merged.size() == kMinRunSize) {
+        if (runs_.size() == first_run) {
+          WriteRun(merged);
+        } else if (std::fwrite(merged.data(), sizeof(T), merged.size(), runs_.back().file) !=
+                   merged.size()) {
+          failed_ = true;
+        }
+
+        merged.clear();
+      }
+    }
+
+    if (runs_.size() == first_run) {
+      WriteRun(merged);
+    } else if (std::fwrite(merged.data(), sizeof(T), merged.size(), runs_.back().file) !=
+               merged.size()) {
+      failed_ = true;
+    }
+
+    for (size_t r = 0; r < num_runs; ++r) {
+      std::fclose(runs_[r].file);
+    }
+
+    runs_.erase(runs_.begin(), runs_.begin() + num_runs);
+  }
+
+  // Takes the smallest head among the runs being merged.
+  bool Pop(T *value) {
+    if (heap_.empty()) {
+      return false;
+    }
+
+    std::pop_heap(heap_.begin(), heap_.end(), HeapCompare());
+    size_t r = heap_.back().second;
+    *value = heap_.back().first;
+    heap_.pop_back();
+
+    if (++runs_[r].pos < runs_[r].size || Fill(r)) PushHead(r);
+
+    return true;
+  }
+
+  // Reads the next values of the run into its buffer. Returns false if the run is over.
+  bool Fill(size_t r) {
+    Run &run = runs_[r];
+    run.size = std::fread(run.buffer.data(), sizeof(T), run.buffer.size(), run.file);
+    run.pos = 0;
+
+    if (std::ferror(run.file)) failed_ = true;
+    return run.size > 0;
+  }
+
+  void PushHead(size_t r) {
+    heap_.push_back(HeapEntry(runs_[r].buffer[runs_[r].pos], r));
+    std::push_heap(heap_.begin(), heap_.end(), HeapCompare());
+  }
+
+  std::string dir_;
+  size_t capacity_;
+  int num_threads_;
+  std::vector<T> buffer_;
+  size_t next_;  // Next value of the buffer, if there are no runs.
+  std::vector<Run> runs_;
+  std::vector<HeapEntry> heap_;
+  bool failed_;
+};
+
+// Array of integers on a temporary file of a scratch directory, accessed through windows (see
+// WordWindow) instead of a memory mapping, so only the windows take memory.
+class WordFile {
+ public:
+  WordFile() : fd_(-1), size_(0) {}
+  ~WordFile() {
+    if (fd_ != -1) close(fd_);
+  }
+
+  // Creates an array of size zeros. Returns false if the file cannot be created.
+  bool Create(const std::string &dir, size_t size) {
+    fd_ = OpenTemporaryFile(dir);
+    size_ = size;
+
+    return fd_ != -1 && ftruncate(fd_, size * sizeof(uint64_t)) == 0;
+  }
+
+  // Accessors.
+  int fd() const { return fd_; }
+  size_t size() const { return size_; }
+
+ private:
+  WordFile(const WordFile&) = delete;
+  WordFile& operator=(const WordFile&) = delete;
+
+  int fd_;
+  size_t size_;
+};
+
+// Buffer of up to capacity consecutive entries of a word file, which moves forward to each position
+// accessed, so positions must never decrease. Entries set are written back when the window moves
+// on, or by Flush.
+class WordWindow {
+ public:
+  WordWindow(const WordFile &file, size_t capacity)
+      : file_(file), capacity_(capacity), begin_(0), is_dirty_(false), failed_(false) {}
+
+  uint64_t Get(size_t pos) {
+    if (pos - begin_ >= buffer_.size()) Move(pos);
+    return buffer_[pos - begin_];
+  }
+
+  void Set(size_t pos, uint64_t value) {
+    if (pos - begin_ >= buffer_.size()) Move(pos);
+    buffer_[pos - begin_] = value;
+    is_dirty_ = true;
+  }
+
+  // Writes back the entries set. Returns false if any entry could not be read or written.
+  bool Flush() {
+    if (is_dirty_) {
+      failed_ |= !Transfer(true);
+      is_dirty_ = false;
+    }
+
+    return !failed_;
+  }
+
+  bool failed() const { return failed_; }
+
+ private:
+  WordWindow(const WordWindow&) = delete;
+  WordWindow& operator=(const WordWindow&) = delete;
+
+  void Move(size_t pos) {
+    Flush();
+    begin_ = pos;
+    buffer_.resize(std::min(capacity_, file_.size() - pos));
+    failed_ |= !Transfer(false);
+  }
+
+  // Reads or writes the buffer from or to the file.
+  bool Transfer(bool is_write) {
+    char *data = reinterpret_cast<char*>(buffer_.data());
+    size_t size = buffer_.size() * sizeof(uint64_t);
+    off_t offset = static_cast<off_t>(begin_ * sizeof(uint64_t));
+
+    for (size_t done = 0; done < size; ) {
+      ssize_t count = is_write ? pwrite(file_.fd(), data + done, size - done, offset + done) :
+                                 pread(file_.fd(), data + done, size - done, offset + done);
+      if (count <= 0) return false;
+      done += count;
+    }
+
+    return true;
+  }
+
+  const WordFile &file_;
+  size_t capacity_;
+  std::vector<uint64_t> buffer_;
+  size_t begin_;  // Position of the first entry of the buffer.
+  bool is_dirty_;
+  bool failed_;
+};
+
+// Entries of each word window, which take a thirty-second of the memory limit.
+size_t WindowCapacity(uint64_t memory_limit) {
+  return std::max<uint64_t>(kMinRunSize, memory_limit / (32 * sizeof(uint64_t)));
+}
+
+// Name of the first kInitialLength characters of the suffix at pos: the characters, padded with
+// zeros, followed by the length of the suffix up to kInitialLength, so a suffix shorter than that
+// comes before the longer suffixes it prefixes. It is never 0, which names the empty suffix.
+uint64_t InitialName(const char *text, size_t n, size_t pos) {
+  uint64_t name = 0;
+
+  for (size_t k = 0; k < kInitialLength; ++k) {
+    name = (name << 8) | (pos + k < n ? static_cast<unsigned char>(text[pos + k]) : 0);
+  }
+
+  return (name << 8) | std::min(n - pos, kInitialLength);
+}
+
+// Returns the characters of text[pos, pos + kPieceLength) packed in a word, the first one on its
+// highest byte, and stores how many there are (fewer at the end of the text) on size.
+uint64_t LoadPiece(const char *text, size_t n, size_t pos, uint64_t *size) {
+  uint64_t piece = 0;
+  *size = pos < n ? std::min(n - pos, kPieceLength) : 0;
+
+  for (size_t k = 0; k < kPieceLength; ++k) {
+    piece = (piece << 8) | (k < *size ? static_cast<unsigned char>(text[pos + k]) : 0);
+  }
+
+  return piece;
+}
+
+// Returns how many of the first characters of two pieces are equal.
+uint64_t MatchPieces(uint64_t lhs, uint64_t lhs_size, uint64_t rhs, uint64_t rhs_size) {
+  uint64_t diff = lhs ^ rhs;
+  uint64_t match = diff == 0 ? kPieceLength : __builtin_clzll(diff) / 8;
+
+  return std::min(match, std::min(lhs_size, rhs_size));
+}
+
+// Sorts the suffixes, leaving the rank of each one (plus one) on names, which holds the name of the
+// first h characters of each suffix, in text order. Each round names the first 2h characters of the
+// suffixes by one plus the number of suffixes whose first 2h characters are smaller, so the name of
+// a suffix which shares them with no other suffix is final, and the suffix is discarded from the
+// next rounds (Dementiev et al.'s discarding). The first round names all suffixes, whose initial
+// names are not of this kind. Names are read and written at increasing positions only.
+bool RankSuffixes(size_t n, const std::string &scratch_dir, uint64_t memory_limit, int num_threads,
+                  const WordFile &names) {
+  typedef ExternalSorter<uint64_t, std::less<uint64_t>> PositionSorter;
+  typedef ExternalSorter<NamedSuffix, ByNames> NameSorter;
+  typedef ExternalSorter<RenamedSuffix, ByPosition> RenameSorter;
+  std::unique_ptr<PositionSorter> pending;  // Suffixes left, or all of them if null.
+  size_t window_capacity = WindowCapacity(memory_limit);
+
+  for (size_t h = kInitialLength; ; h *= 2) {
+    bool is_first_round = !pending;
+    std::unique_ptr<NameSorter> by_names(new NameSorter(scratch_dir, memory_limit, n,
+                                                        num_threads));
+    WordWindow name(names, window_capacity);
+    WordWindow next_name(names, window_capacity);
+    uint64_t i = 0;
+
+    while (pending ? pending->Next(&i) : i < n) {
+      NamedSuffix suffix = {name.Get(i), i + h < n ? next_name.Get(i + h) : 0, i};
+      by_names->Add(suffix);
+      if (!pending) ++i;
+    }
+
+    if ((pending && pending->failed()) || name.failed() || next_name.failed() ||
+        !by_names->Sort()) {
+      return false;
+    }
+
+    pending.reset();
+
+    // Each suffix is renamed once the next one is known, to tell whether it shares its name.
+    std::unique_ptr<RenameSorter> by_pos(new RenameSorter(scratch_dir, memory_limit, n,
+                                                          num_threads));
+    NamedSuffix suffix;
+    NamedSuffix prev = {0, 0, 0};
+    RenamedSuffix renamed = {0, 0, false};
+    size_t index = 0;
+    size_t group_index = 0;  // Index of the first suffix with the same name.
+    size_t subgroup_index = 0;  // Index of the first suffix with the same name and next name.
+
+    for (; by_names->Next(&suffix); ++index) {
+      bool same_name = index > 0 && (suffix.name == prev.name || is_first_round);
+      bool same_names = same_name && suffix.next_name == prev.next_name &&
+                        suffix.name == prev.name;
+
+      if (!same_name) group_index = index;
+      if (!same_names) subgroup_index = index;
+
+      if (index > 0) {
+        renamed.is_shared |= same_names;
+        by_pos->Add(renamed);
+      }
+
+      renamed.pos = suffix.pos;
+      renamed.name = (is_first_round ? 1 : suffix.name) + subgroup_index - group_index;
+      renamed.is_shared = same_names;
+      prev = suffix;
+    }
+
+    if (index > 0) by_pos->Add(renamed);
+
+    if (by_names->failed() || !by_pos->Sort()) {
+      return false;
+    }
+
+    by_names.reset();
+
+    std::unique_ptr<PositionSorter> next_pending(new PositionSorter(scratch_dir, memory_limit, n,
+                                                                    num_threads));
+    WordWindow new_name(names, window_capacity);
+    bool is_done = true;
+
+    while (by_pos->Next(&renamed)) {
+      new_name.Set(renamed.pos, renamed.name);
+
+      if (renamed.is_shared) {
+        next_pending->Add(renamed.pos);
+        is_done = false;
+      }
+    }
+
+    if (by_pos->failed() || !new_name.Flush() || !next_pending->Sort()) {
+      return false;
+    } else if (is_done) {
+      return true;
+    }
+
+    pending = std::move(next_pending);
+  }
+}
+
+// Writes the suffix array from the ranks of the suffixes, sorting them by rank.
+bool InvertRanks(size_t n, const std::string &scratch_dir, uint64_t memory_limit, int num_threads,
+                 const WordFile &names, PageReleaser *releaser, PackedArray *suffix_array) {
+  ExternalSorter<KeyValue, ByKey> by_rank(scratch_dir, memory_limit, n, num_threads);
+  WordWindow name(names, WindowCapacity(memory_limit));
+
+  for (size_t i = 0; i < n; ++i) {
+    KeyValue rank = {name.Get(i) - 1, i};
+    by_rank.Add(rank);
+  }
+
+  if (name.failed() || !by_rank.Sort()) {
+    return false;
+  }
+
+  for (KeyValue rank; by_rank.Next(&rank); ) {
+    suffix_array->Set(rank.key, rank.value);
+    releaser->Advance(sizeof(uint64_t));
+  }
+
+  return !by_rank.failed();
+}
+
+typedef ExternalSorter<KeyValue, ByKey> LcpSorter;
+typedef ExternalSorter<Comparison, ByPosition> PendingSorter;
+
+// Adds the LCP of each suffix whose comparisons (sorted by suffix and piece) found unequal pieces
+// to plcp, from the first unequal one, and the suffixes whose pieces were all equal to pending, for
+// comparing the pieces after them.
+bool FinishComparisons(ExternalSorter<Comparison, BySuffixAndA> *comparisons, LcpSorter *plcp,
+                       PendingSorter *pending, size_t *num_pending) {
+  Comparison last = {0, 0, 0, 0, 0};  // Last comparison of the suffix, if all were equal.
+  bool is_equal = false;
+  uint64_t found_pos = 0;  // Suffix whose LCP was found, if is_found.
+  bool is_found = false;
+  *num_pending = 0;
+
+  for (Comparison comparison; ; ) {
+    bool has_next = comparisons->Next(&comparison);
+
+    if (is_equal && (!has_next || comparison.pos != last.pos)) {
+      Comparison next = {last.pos, last.a + kPieceLength, last.b + kPieceLength, 0, 0};
+      pending->Add(next);
+      ++*num_pending;
+      is_equal = false;
+    }
+
+    if (!has_next) {
+      break;
+    } else if (is_found && comparison.pos == found_pos) {
+      continue;  // The pieces after the first unequal one.
+    }
+
+    if (comparison.size < kPieceLength) {
+      KeyValue suffix_lcp = {comparison.pos, comparison.a - comparison.pos + comparison.size};
+      plcp->Add(suffix_lcp);
+      found_pos = comparison.pos;
+      is_found = true;
+      is_equal = false;
+    } else {
+      last = comparison;
+      is_equal = true;
+    }
+  }
+
+  return !comparisons->failed();
+}
+
+// LCP of each suffix with the one before it on the suffix array, computed in text order as by
+// Karkkainen, Manzini and Puglisi's Phi algorithm (2009), but reading the text in order only. The
+// LCP of a suffix whose previous character is also the one before the suffix preceding it on the
+// suffix array is that of the previous suffix of the text minus one (a reducible value). The other
+// (irreducible) values add up to O(n log n), and are found by comparing pieces of the text: sorted
+// by their position on one suffix, read, sorted by their position on the other one and compared.
+// Suffixes whose pieces are all equal go on to another round, which compares twice as many pieces
+// after them. The LCP values are then filled in text order and sorted by rank, read from names.
+bool ComputeLcp(const char *text, size_t n, const std::string &scratch_dir, uint64_t memory_limit,
+                int num_threads, const PackedArray &suffix_array, const WordFile &names,
+                PageReleaser *releaser, ScratchArray *lcp) {
+  typedef ExternalSorter<AdjacentSuffixes, ByPosition> AdjacentSorter;
+  typedef ExternalSorter<PhiSuffix, ByPreviousPosition> PhiSorter;
+
+  std::unique_ptr<AdjacentSorter> by_pos(new AdjacentSorter(scratch_dir, memory_limit, n,
+                                                            num_threads));
+
+  for (size_t rank = 1; rank < n; ++rank) {
+    AdjacentSuffixes suffixes = {suffix_array[rank], suffix_array[rank - 1]};
+    by_pos->Add(suffixes);
+    releaser->Advance(sizeof(uint64_t));
+  }
+
+  if (!by_pos->Sort()) {
+    return false;
+  }
+
+  // Read the character before each suffix and its first piece, in text order.
+  std::unique_ptr<PhiSorter> by_prev_pos(new PhiSorter(scratch_dir, memory_limit, n,
+                                                       num_threads));
+  uint64_t read_pos = 0;
+
+  for (AdjacentSuffixes suffixes; by_pos->Next(&suffixes); ) {
+    uint64_t i = suffixes.pos;
+    uint64_t before = i > 0 ? static_cast<unsigned char>(text[i - 1]) : kNoCharacter;
+    uint64_t piece_size;
+    uint64_t piece = LoadPiece(text, n, i, &piece_size);
+    PhiSuffix suffix = {suffixes.prev_pos, i, piece, static_cast<uint32_t>(before),
+                        static_cast<uint32_t>(piece_size)};
+
+    by_prev_pos->Add(suffix);
+    releaser->Advance(i - read_pos);
+    read_pos = i;
+  }
+
+  if (by_pos->failed() || !by_prev_pos->Sort()) {
+    return false;
+  }
+
+  by_pos.reset();
+
+  // Tell the reducible values apart and compare the first pieces of the others, in the order of the
+  // suffixes before them.
+  LcpSorter plcp(scratch_dir, memory_limit, n, num_threads);
+  std::unique_ptr<PendingSorter> pending(new PendingSorter(scratch_dir, memory_limit, n,
+                                                           num_threads));
+  size_t num_pending = 0;
+  releaser->Release();
+  read_pos = 0;
+
+  for (PhiSuffix suffix; by_prev_pos->Next(&suffix); ) {
+    uint64_t j = suffix.prev_pos;
+    releaser->Advance(j - read_pos);
+    read_pos = j;
+
+    if (j > 0 && suffix.before == static_cast<unsigned char>(text[j - 1])) {
+      KeyValue reducible = {suffix.pos, kReducible};
+      plcp.Add(reducible);
+      continue;
+    }
+
+    uint64_t piece_size;
+    uint64_t piece = LoadPiece(text, n, j, &piece_size);
+    uint64_t match = MatchPieces(suffix.piece, suffix.piece_size, piece, piece_size);
+
+    if (match < kPieceLength) {
+      KeyValue suffix_lcp = {suffix.pos, match};
+      plcp.Add(suffix_lcp);
+    } else {
+      Comparison next = {suffix.pos, suffix.pos + kPieceLength, j + kPieceLength, 0, 0};
+      pending->Add(next);
+      ++num_pending;
+    }
+  }
+
+  if (by_prev_pos->failed() || !pending->Sort()) {
+    return false;
+  }
+
+  by_prev_pos.reset();
+
+  for (uint64_t num_pieces = 2; num_pending > 0; num_pieces *= 2) {
+    ExternalSorter<Comparison, ByA> by_a(scratch_dir, memory_limit, n, num_threads);
+
+    for (Comparison suffix; pending->Next(&suffix); ) {
+      for (uint64_t p = 0; p < num_pieces; ++p) {
+        Comparison comparison = {suffix.pos, suffix.a + p * kPieceLength,
+                                 suffix.b + p * kPieceLength, 0, 0};
+        by_a.Add(comparison);
+      }
+    }
+
+    if (pending->failed() || !by_a.Sort()) {
+      return false;
+    }
+
+    pending.reset();
+
+    ExternalSorter<Comparison, ByB> by_b(scratch_dir, memory_limit, n, num_threads);
+    releaser->Release();
+    read_pos = 0;
+
+    for (Comparison comparison; by_a.Next(&comparison); ) {
+      comparison.piece = LoadPiece(text, n, comparison.a, &comparison.size);
+      by_b.Add(comparison);
+      releaser->Advance(std::min<uint64_t>(comparison.a, n) - read_pos);
+      read_pos = std::min<uint64_t>(comparison.a, n);
+    }
+
+    if (by_a.failed() || !by_b.Sort()) {
+      return false;
+    }
+
+    ExternalSorter<Comparison, BySuffixAndA> by_suffix(scratch_dir, memory_limit, n, num_threads);
+    releaser->Release();
+    read_pos = 0;
+
+    for (Comparison comparison; by_b.Next(&comparison); ) {
+      uint64_t piece_size;
+      uint64_t piece = LoadPiece(text, n, comparison.b, &piece_size);
+      comparison.size = MatchPieces(comparison.piece, comparison.size, piece, piece_size);
+      by_suffix.Add(comparison);
+      releaser->Advance(std::min<uint64_t>(comparison.b, n) - read_pos);
+      read_pos = std::min<uint64_t>(comparison.b, n);
+    }
+
+    if (by_b.failed() || !by_suffix.Sort()) {
+      return false;
+    }
+
+    pending.reset(new PendingSorter(scratch_dir, memory_limit, n, num_threads));
+    if (!FinishComparisons(&by_suffix, &plcp, pending.get(), &num_pending) || !pending->Sort()) {
+      return false;
+    }
+  }
+
+  pending.reset();
+
+  if (!plcp.Sort()) {
+    return false;
+  }
+
+  // The first suffix of the suffix array has no LCP value, so the suffix after it in the text is
+  // never reducible.
+  LcpSorter by_rank(scratch_dir, memory_limit, n, num_threads);
+  WordWindow name(names, WindowCapacity(memory_limit));
+  uint64_t prev_lcp = 0;
+  uint64_t max_lcp = 0;
+
+  for (KeyValue suffix_lcp; plcp.Next(&suffix_lcp); ) {
+    uint64_t value = suffix_lcp.value == kReducible ? prev_lcp - 1 : suffix_lcp.value;
+    KeyValue rank_lcp = {name.Get(suffix_lcp.key) - 1, value};
+
+    by_rank.Add(rank_lcp);
+    max_lcp = std::max(max_lcp, value);
+    prev_lcp = value;
+  }
+
+  if (plcp.failed() || name.failed() || !by_rank.Sort() ||
+      !lcp->Create(scratch_dir, n, PackedArray::RequiredWidth(max_lcp))) {
+    return false;
+  }
+
+  lcp->AddTo(releaser);
+
+  for (KeyValue rank_lcp; by_rank.Next(&rank_lcp); ) {
+    lcp->mutable_array()->Set(rank_lcp.key, rank_lcp.value);
+    releaser->Advance(sizeof(uint64_t));
+  }
+
+  return !by_rank.failed();
+}
+
+}  // namespace
+
+bool ScratchArray::Create(const std::string &dir, size_t size, int width) {
+  if (!file_.CreateTemporary(dir, PackedArray::NumWords(size, width) * sizeof(uint64_t))) {
+    return false;
+  }
+
+  array_ = PackedArray::MutableView(reinterpret_cast<uint64_t*>(file_.mutable_data()), size,
+                                    width);
+  return true;
+}
+
+bool BuildSuffixArrayExternal(const char *text, size_t n, const std::string &scratch_dir,
+                              uint64_t memory_limit, int num_threads, ScratchArray *suffix_array,
+                              ScratchArray *lcp) {
+  int width = PackedArray::RequiredWidth(n > 0 ? n - 1 : 0);
+
+  if (!suffix_array->Create(scratch_dir, n, width)) {
+    return false;
+  } else if (n == 0) {
+    return lcp->Create(scratch_dir, 0, 1);
+  }
+
+  PageReleaser releaser(ReleaseInterval(memory_limit));
+  releaser.Add(text, n);
+  suffix_array->AddTo(&releaser);
+
+  WordFile names;
+  if (!names.Create(scratch_dir, n)) {
+    return false;
+  }
+
+  WordWindow initial_name(names, WindowCapacity(memory_limit));
+  for (size_t i = 0; i < n; ++i) {
+    initial_name.Set(i, InitialName(text, n, i));
+    releaser.Advance(1);
+  }
+
+  return initial_name.Flush() &&
+         RankSuffixes(n, scratch_dir, memory_limit, num_threads, names) &&
+         InvertRanks(n, scratch_dir, memory_limit, num_threads, names, &releaser,
+                     suffix_array->mutable_array()) &&
+         ComputeLcp(text, n, scratch_dir, memory_limit, num_threads, suffix_array->array(), names,
+                    &releaser, lcp);
+}
+
+uint64_t ReleaseInterval(uint64_t memory_limit) {
+  return std::max<uint64_t>(1 << 18, memory_limit / 16);
+}
+
+}  // namespace ipmt
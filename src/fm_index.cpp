@@ -0,0 +1,312 @@
+#include "fm_index.h"
+
+#include <algorithm>
+#include <utility>
+
+namespace ipmt {
+namespace {
+
+// Layout of the words of an FM-index:
+//
+//   [0, kHeaderWords)  size, primary row, sample rate, alphabet size, wavelet tree levels, number
+//                      and width of suffix array samples, number and width of inverse samples,
+//                      code of each byte (256 words) and cumulative counts of each code (257).
+//   Wavelet tree of the BWT codes.
+//   Bitvector of sampled rows.
+//   Suffix array samples and inverse suffix array samples, as packed array words.
+enum HeaderField {
+  kSizeField,
+  kPrimaryField,
+  kSampleRateField,
+  kAlphabetSizeField,
+  kLevelsField,
+  kSASamplesField,
+  kSAWidthField,
+  kISASamplesField,
+  kISAWidthField,
+  kCodesField
+};
+
+const size_t kCountsField = kCodesField + 256;
+const size_t kHeaderWords = kCountsField + 257;
+const uint64_t kAbsentCode = 256;
+
+// Number of characters extracted at a time when looking for line feeds.
+const size_t kLineChunk = 256;
+
+}  // namespace
+
+const size_t FMIndex::kDefaultSampleRate = 32;
+
+FMIndex FMIndex::Build(const std::string &text, const PackedArray &suffix_array,
+                       size_t sample_rate) {
+  return Build(text.data(), text.size(), suffix_array, sample_rate);
+}
+
+FMIndex FMIndex::Build(const char *text, size_t n, const PackedArray &suffix_array,
+                       size_t sample_rate) {
+  std::vector<uint64_t> words(kHeaderWords, 0);
+
+  // Map the bytes of the text to a contiguous range of codes.
+  std::vector<size_t> counts(256, 0);
+  for (size_t i = 0; i < n; ++i) {
+    ++counts[static_cast<unsigned char>(text[i])];
+  }
+
+  size_t sigma = 0;
+  size_t smaller = 1;  // The sentinel is smaller than any character.
+
+  for (int c = 0; c < 256; ++c) {
+    if (counts[c] > 0) {
+      words[kCodesField + c] = sigma;
+      words[kCountsField + sigma] = smaller;
+      smaller += counts[c];
+      ++sigma;
+    } else {
+      words[kCodesField + c] = kAbsentCode;
+    }
+  }
+
+  int levels = PackedArray::RequiredWidth(sigma > 0 ? sigma - 1 : 0);
+
+  // Row 0 of the BWT matrix is the sentinel suffix; row i > 0 is the suffix suffix_array[i - 1].
+  // The sentinel itself is stored as code 0, and Occ discounts it.
+  std::vector<uint8_t> bwt(n + 1);
+  std::vector<uint64_t> sampled((n + 64) / 64, 0);
+  std::vector<uint64_t> sa_samples;
+  PackedArray isa_samples((n + sample_rate - 1) / sample_rate, PackedArray::RequiredWidth(n));
+  size_t primary = 0;
+
+  for (size_t row = 0; row <= n; ++row) {
+    size_t pos = row == 0 ? n : suffix_array[row - 1];
+
+    if (pos == 0) {
+      bwt[row] = 0;
+      primary = row;
+    } else {
+      bwt[row] = words[kCodesField + static_cast<unsigned char>(text[pos - 1])];
+    }
+
+    if (pos % sample_rate == 0 || pos == n) {
+      sampled[row >> 6] |= 1ULL << (row & 63);
+      sa_samples.push_back(pos);
+    }
+
+    if (pos % sample_rate == 0 && pos < n) {
+      isa_samples.Set(pos / sample_rate, row);
+    }
+  }
+
+  PackedArray packed_sa_samples = PackArray(sa_samples);
+  sa_samples = std::vector<uint64_t>();
+
+  words[kSizeField] = n;
+  words[kPrimaryField] = primary;
+  words[kSampleRateField] = sample_rate;
+  words[kAlphabetSizeField] = sigma;
+  words[kLevelsField] = levels;
+  words[kSASamplesField] = packed_sa_samples.size();
+  words[kSAWidthField] = packed_sa_samples.width();
+  words[kISASamplesField] = isa_samples.size();
+  words[kISAWidthField] = isa_samples.width();
+
+  WaveletTree::Append(bwt, levels, &words);
+  RankBitvector::Append(sampled, n + 1, &words);
+  words.insert(words.end(), packed_sa_samples.data(),
+               packed_sa_samples.data() + packed_sa_samples.num_words());
+  words.insert(words.end(), isa_samples.data(), isa_samples.data() + isa_samples.num_words());
+
+  FMIndex fm_index;
+  fm_index.storage_ = std::move(words);
+  fm_index.View(fm_index.storage_.data(), fm_index.storage_.size());
+
+  return fm_index;
+}
+
+bool FMIndex::View(const uint64_t *data, size_t num_words) {
+  if (num_words < kHeaderWords) {
+    return false;
+  }
+
+  size_t n = data[kSizeField];
+  size_t levels = data[kLevelsField];
+  size_t sigma = data[kAlphabetSizeField];
+
+  if (levels < 1 || levels > WaveletTree::kMaxLevels || sigma > 256 ||
+      data[kSampleRateField] == 0 || data[kPrimaryField] > n ||
+      data[kSAWidthField] < 1 || data[kSAWidthField] > 64 ||
+      data[kISAWidthField] < 1 || data[kISAWidthField] > 64) {
+    return false;
+  }
+
+  size_t bwt_words = WaveletTree::NumWords(n + 1, levels);
+  size_t sampled_words = RankBitvector::NumWords(n + 1);
+  size_t sa_words = PackedArray::NumWords(data[kSASamplesField], data[kSAWidthField]);
+  size_t isa_words = PackedArray::NumWords(data[kISASamplesField], data[kISAWidthField]);
+
+  if (kHeaderWords + bwt_words + sampled_words + sa_words + isa_words > num_words) {
+    return false;
+  }
+
+  data_ = data;
+  num_words_ = num_words;
+  size_ = n;
+  primary_ = data[kPrimaryField];
+  sample_rate_ = data[kSampleRateField];
+
+  for (int c = 0; c < 256; ++c) {
+    uint64_t code = data[kCodesField + c];
+    code_[c] = code < sigma ? static_cast<int>(code) : -1;
+    if (code < sigma) symbol_[code] = static_cast<char>(c);
+  }
+
+  for (size_t code = 0; code < 257; ++code) {
+    c_[code] = data[kCountsField + code];
+  }
+
+  const uint64_t *section = data + kHeaderWords;
+  bwt_.View(section, n + 1, levels);
+  section += bwt_words;
+
+  sampled_.View(section, n + 1);
+  section += sampled_words;
+
+  sa_samples_ = PackedArray::View(section, data[kSASamplesField], data[kSAWidthField]);
+  section += sa_words;
+
+  isa_samples_ = PackedArray::View(section, data[kISASamplesField], data[kISAWidthField]);
+
+  return true;
+}
+
+size_t FMIndex::Occ(uint8_t code, size_t index) const {
+  size_t occ = bwt_.Rank(code, index);
+  return code == 0 && index > primary_ ? occ - 1 : occ;
+}
+
+size_t FMIndex::LF(size_t row, char *c) const {
+  uint8_t code;
+  size_t rank = bwt_.InverseSelect(row, &code);
+
+  *c = symbol_[code];
+  if (code == 0 && row > primary_) --rank;
+
+  return c_[code] + rank;
+}
+
+void FMIndex::BackwardSearch(const std::string &pattern, size_t *begin, size_t *end) const {
+  size_t sp = pattern.empty() ? 1 : 0;  // The sentinel row never matches.
+  size_t ep = size_ + 1;
+
+  for (size_t i = pattern.size(); i-- > 0 && sp < ep;) {
+    int code = code_[static_cast<unsigned char>(pattern[i])];
+
+    if (code < 0) {
+      sp = ep = 0;
+    } else {
+      sp = c_[code] + Occ(code, sp);
+      ep = c_[code] + Occ(code, ep);
+    }
+  }
+
+  *begin = sp;
+  *end = std::max(sp, ep);
+}
+
+size_t FMIndex::Count(const std::string &pattern) const {
+  size_t begin, end;
+  BackwardSearch(pattern, &begin, &end);
+
+  return end - begin;
+}
+
+std::vector<size_t> FMIndex::Locate(const std::string &pattern, size_t limit) const {
+  size_t begin, end;
+  BackwardSearch(pattern, &begin, &end);
+
+  return SortSmallest(end - begin, limit, [this, begin](size_t i) { return LocateRow(begin + i); });
+}
+
+size_t FMIndex::LocateRow(size_t row) const {
+  size_t steps = 0;
+  char c;
+
+  // Walk backwards on the text until a sampled suffix is found. The sentinel row and the row of
+  // the whole text are always sampled, so this stops after at most sample_rate steps.
+  while (!sampled_[row]) {
+    row = LF(row, &c);
+    ++steps;
+  }
+
+  return sa_samples_[sampled_.Rank1(row)] + steps;
+}
+
+std::string FMIndex::Extract(size_t pos, size_t length) const {
+  if (pos >= size_) {
+    return std::string();
+  }
+
+  size_t end = pos + std::min(length, size_ - pos);
+
+  // Start from the first sampled position at or after end, and walk backwards up to pos.
+  size_t curr = std::min(size_, (end + sample_rate_ - 1) / sample_rate_ * sample_rate_);
+  size_t row = curr == size_ ? 0 : isa_samples_[curr / sample_rate_];
+  std::string result(end - pos, '\0');
+
+  while (curr > pos) {
+    char c;
+    row = LF(row, &c);
+    --curr;
+
+    if (curr < end) result[curr - pos] = c;
+  }
+
+  return result;
+}
+
+std::string FMIndex::ExtractLine(size_t pos, size_t *line_start) const {
+  // Find the line start, extracting the text backwards.
+  std::string prefix;
+  size_t start = pos;
+
+  while (true) {
+    size_t chunk_start = start > kLineChunk ? start - kLineChunk : 0;
+    std::string chunk = Extract(chunk_start, start - chunk_start);
+    size_t lf_index = chunk.find_last_of('\n');
+
+    if (lf_index != std::string::npos) {
+      prefix = chunk.substr(lf_index + 1) + prefix;
+      *line_start = chunk_start + lf_index + 1;
+      break;
+    }
+
+    prefix = chunk + prefix;
+    if (chunk_start == 0) {
+      *line_start = 0;
+      break;
+    }
+
+    start = chunk_start;
+  }
+
+  // Find the line end, extracting the text forwards.
+  std::string line = prefix;
+  size_t curr = pos;
+
+  while (curr < size_) {
+    std::string chunk = Extract(curr, kLineChunk);
+    size_t lf_index = chunk.find_first_of('\n');
+
+    if (lf_index != std::string::npos) {
+      line += chunk.substr(0, lf_index);
+      break;
+    }
+
+    line += chunk;
+    curr += chunk.size();
+  }
+
+  return line;
+}
+
+}  // namespace ipmt
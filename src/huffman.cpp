@@ -1,10 +1,19 @@
 #include "huffman.h"
 
+#include <algorithm>
+#include <cstdint>
 #include <queue>
+#include <vector>
+
+#include "parallel.h"
 
 namespace ipmt {
 namespace {
 
+// Characters each thread gets at least when counting or encoding on threads; fewer are not worth
+// starting a thread for.
+const size_t kMinThreadLength = 1 << 16;
+
 // Functor used to implement the partial order relation for the nodes on
 // priority queue.
 struct Compare {
@@ -14,124 +23,570 @@ struct Compare {
 };
 
 typedef std::priority_queue<HuffmanHeapNode*, std::vector<HuffmanHeapNode*>, Compare> HuffmanHeap;
-typedef std::unordered_map<char, int> FrequencyTable;
 
-// TODO(Mateus): supports ASCII alphabet only.
-FrequencyTable ComputeFrequencyTable(const std::string &text) {
+// Counts on four tables, each one taking every fourth character, so runs of the same character
+// do not make each increment wait for the previous one.
+FrequencyTable CountFrequencies(const char *text, size_t length) {
+  const unsigned char *bytes = reinterpret_cast<const unsigned char*>(text);
+  std::vector<uint64_t> counts(4 * 256, 0);
+  size_t i = 0;
+
+  for (; i + 4 <= length; i += 4) {
+    ++counts[bytes[i]];
+    ++counts[256 + bytes[i + 1]];
+    ++counts[512 + bytes[i + 2]];
+    ++counts[768 + bytes[i + 3]];
+  }
+
+  for (; i < length; ++i) {
+    ++counts[bytes[i]];
+  }
+
   FrequencyTable freq_table;
+  for (int c = 0; c < 256; ++c) {
+    freq_table[c] = counts[c] + counts[256 + c] + counts[512 + c] + counts[768 + c];
+  }
+
+  return freq_table;
+}
 
-  for (size_t i = 0; i < text.size(); ++i) {
-    ++freq_table[text[i]];
+// Returns the number of threads to count or encode length characters on, at most num_threads.
+int GetUsefulThreads(size_t length, int num_threads) {
+  return static_cast<int>(std::max<size_t>(1, std::min<size_t>(num_threads,
+                                                               length / kMinThreadLength)));
+}
+
+// Each thread counts a chunk of the text on its own tables, which are then summed.
+FrequencyTable ComputeFrequencyTable(const char *text, size_t length, int num_threads) {
+  num_threads = GetUsefulThreads(length, num_threads);
+  std::vector<FrequencyTable> thread_tables(num_threads);
+
+  ParallelFor(num_threads, length, [&](int t, size_t begin, size_t end) {
+    thread_tables[t] = CountFrequencies(text + begin, end - begin);
+  });
+
+  FrequencyTable freq_table = thread_tables[0];
+  for (int t = 1; t < num_threads; ++t) {
+    for (int c = 0; c < 256; ++c) {
+      freq_table[c] += thread_tables[t][c];
+    }
   }
 
   return freq_table;
 }
 
-void FillCodeTable(const HuffmanHeapNode *root, const DynamicBitset &codeword,
-                   CodeTable *code_table) {
-  if (!root) {
-    return;
-  } else if (!root->left && !root->right) {
-    (*code_table)[root->c] = codeword;
+void DeleteTree(HuffmanHeapNode *root) {
+  if (root) {
+    DeleteTree(root->left);
+    DeleteTree(root->right);
+    delete root;
+  }
+}
+
+void FillCodeLengths(const HuffmanHeapNode *root, int depth, CodeLengths *code_lengths) {
+  if (!root->left && !root->right) {
+    // A lone character still needs a one-bit codeword.
+    (*code_lengths)[static_cast<unsigned char>(root->c)] = std::max(depth, 1);
   } else {
-    DynamicBitset left_word = codeword;
-    left_word.PushBack(false);
-    FillCodeTable(root->left, left_word, code_table);
+    FillCodeLengths(root->left, depth + 1, code_lengths);
+    FillCodeLengths(root->right, depth + 1, code_lengths);
+  }
+}
+
+// Computes the codeword lengths of Huffman's algorithm. Returns the length of the longest one.
+int ComputeCodeLengths(const FrequencyTable &freq_table, CodeLengths *code_lengths) {
+  HuffmanHeap min_heap;
+  code_lengths->fill(0);
+
+  for (int c = 0; c < 256; ++c) {
+    if (freq_table[c] > 0) {
+      min_heap.push(new HuffmanHeapNode(static_cast<char>(c), freq_table[c]));
+    }
+  }
+
+  if (min_heap.empty()) {
+    return 0;
+  }
+
+  while (min_heap.size() > 1) {
+    HuffmanHeapNode *x = min_heap.top();
+    min_heap.pop();
 
-    DynamicBitset right_word = codeword;
-    right_word.PushBack(true);
-    FillCodeTable(root->right, right_word, code_table);
-  }  
+    HuffmanHeapNode *y = min_heap.top();
+    min_heap.pop();
+
+    HuffmanHeapNode *z = new HuffmanHeapNode;
+    z->left = x;
+    z->right = y;
+    z->freq = x->freq + y->freq;
+    min_heap.push(z);
+  }
+
+  HuffmanHeapNode *root = min_heap.top();
+  FillCodeLengths(root, 0, code_lengths);
+  DeleteTree(root);
+
+  return *std::max_element(code_lengths->begin(), code_lengths->end());
 }
 
-}  // namespace
+// Computes the codeword lengths, limited to kMaxCodeLength bits. While some codeword is too long,
+// the frequencies are halved (rare characters keep a frequency of one), which flattens the tree at
+// a small cost in compression.
+void ComputeLimitedCodeLengths(FrequencyTable freq_table, CodeLengths *code_lengths) {
+  while (ComputeCodeLengths(freq_table, code_lengths) > kMaxCodeLength) {
+    for (int c = 0; c < 256; ++c) {
+      freq_table[c] = (freq_table[c] + 1) / 2;
+    }
+  }
+}
 
-HuffmanHeapNode* BuildTreeFromTable(const CodeTable &code_table) {
-  HuffmanHeapNode *root = new HuffmanHeapNode;
-  HuffmanHeapNode *current = root;
+// Assigns the canonical codeword of each byte, right aligned.
+void AssignCanonicalCodes(const CodeLengths &code_lengths, std::array<uint64_t, 256> *codes) {
+  uint64_t next_code = 0;
+  codes->fill(0);
 
-  for (auto it = code_table.begin(); it != code_table.end(); ++it) {
-    DynamicBitset codeword = it->second;
-    for (int j = 0; j < codeword.size(); ++j) {
-      if (codeword[j]) {
-        if (!current->right) current->right = new HuffmanHeapNode;
-        current = current->right;
-      } else {
-        if (!current->left) current->left = new HuffmanHeapNode;
-        current = current->left;
+  for (int length = 1; length <= kMaxCodeLength; ++length) {
+    for (int c = 0; c < 256; ++c) {
+      if (code_lengths[c] == length) {
+        (*codes)[c] = next_code++;
       }
     }
 
-    // No need for the frequencies here.
-    current->c = it->first;
-    current = root;
+    next_code <<= 1;
   }
+}
+
+// Words of the code of a chunk of the text which the chunks around it may share: its first word
+// and, if the chunk does not end on a word boundary, its last one.
+struct ChunkEdges {
+  size_t first_word;
+  uint64_t first_bits;
+  size_t last_word;  // Equal to first_word if the chunk has no other partial word.
+  uint64_t last_bits;
+};
+
+// Writes the code of text[0, length) to words, starting at bit bit_offset, a word at a time. The
+// words shared with other chunks are stored on edges instead, for OR-ing in once all chunks are
+// written; all other words are owned by the chunk.
+void EncodeChunk(const char *text, size_t length, const CodeLengths &code_lengths,
+                 const std::array<uint64_t, 256> &codes, size_t bit_offset, uint64_t *words,
+                 ChunkEdges *edges) {
+  const int kWordSize = DynamicBitset::kWordSize;
+  size_t word = bit_offset / kWordSize;
+  int filled = bit_offset % kWordSize;
+  uint64_t buffer = 0;
+
+  edges->first_word = edges->last_word = word;
+  edges->first_bits = edges->last_bits = 0;
+
+  for (size_t i = 0; i < length; ++i) {
+    unsigned char c = static_cast<unsigned char>(text[i]);
+    int num_bits = code_lengths[c];
+    int free_bits = kWordSize - filled;
+
+    if (num_bits < free_bits) {
+      buffer |= codes[c] << (free_bits - num_bits);
+      filled += num_bits;
+      continue;
+    }
+
+    int rest = num_bits - free_bits;
+    buffer |= codes[c] >> rest;
+
+    if (word == edges->first_word) {
+      edges->first_bits = buffer;
+    } else {
+      words[word] = buffer;
+    }
 
-  return root;
+    ++word;
+    buffer = rest > 0 ? codes[c] << (kWordSize - rest) : 0;
+    filled = rest;
+  }
+
+  if (filled > 0 && word == edges->first_word) {
+    edges->first_bits = buffer;
+  } else if (filled > 0) {
+    edges->last_word = word;
+    edges->last_bits = buffer;
+  }
 }
 
-// Returns the original text which the input code represents.
-std::string HuffmanDecode(const DynamicBitset &code, HuffmanHeapNode *root) {
-  if (root) {
-    HuffmanHeapNode *current = root;
-    std::string text;
+}  // namespace
+
+// Reads bitset words through a 64-bit buffer, which is consumed by shifts and refilled with two
+// word loads only once most of its bits are consumed, instead of loading the words on every read.
+class BitReader {
+ public:
+  explicit BitReader(const DynamicBitset &bitset, size_t position = 0)
+      : BitReader(bitset.data(), DynamicBitset::NumWords(bitset.size()), position) {}
+  BitReader(const uint64_t *data, size_t num_words, size_t position)
+      : data_(data), num_words_(num_words), buffer_(0), count_(0), next_(position) {}
+
+  // Fills the buffer with the next bits of the bitset, aligned to its most significant bit. Bits
+  // past the end of the bitset are zeros.
+  void Refill() {
+    size_t word = next_ / DynamicBitset::kWordSize;
+    int offset = next_ % DynamicBitset::kWordSize;
+
+    uint64_t high = word < num_words_ ? data_[word] : 0;
+    uint64_t low = word + 1 < num_words_ ? data_[word + 1] : 0;
+    uint64_t bits = offset == 0 ? high :
+                    high << offset | low >> (DynamicBitset::kWordSize - offset);
+
+    buffer_ |= bits >> count_;
+    next_ += DynamicBitset::kWordSize - count_;
+    count_ = DynamicBitset::kWordSize;
+  }
 
-    for (int i = 0; i < code.size(); ++i) {
-      if (!current->left && !current->right) {
-        text += current->c;
-        current = root;
+  // Returns the next bits (at most 63) of the buffer, which must hold them.
+  uint64_t Peek(int bits) const { return buffer_ >> 1 >> (63 - bits); }
+  void Skip(int bits) {
+    buffer_ <<= bits;
+    count_ -= bits;
+  }
+
+  int count() const { return count_; }  // Returns the number of bits left in the buffer.
+  size_t position() const { return next_ - count_; }
+
+ private:
+  const uint64_t *data_;
+  size_t num_words_;
+  uint64_t buffer_;
+  int count_;
+  size_t next_;  // Position of the first bit after the buffer.
+};
+
+// Codeword aligned to the most significant bit.
+struct Codeword {
+  uint64_t bits;
+  int length;
+  unsigned char symbol;
+};
+
+// Multi-level lookup table for decoding Huffman codes a whole codeword per step. The first table
+// is indexed by the next kTableBits bits of the code; its entries either hold a symbol and the
+// length of its codeword, or link to a second-level table for longer codewords, indexed by the
+// following bits, and so on. All tables lie on a single array, each one a range of entries indexed
+// by the bits after the prefix which leads to it. Codewords must not be longer than 64 bits, which
+// would only happen for texts with trillions of characters.
+class HuffmanDecodingTable {
+ public:
+  explicit HuffmanDecodingTable(std::vector<Codeword> codewords);
+
+  static const int kTableBits = 10;
+
+  // The buffer of the reader is refilled at most once per codeword, before its first bit.
+  char DecodeSymbol(BitReader *reader) const {
+    size_t offset = 0;
+    int bits = root_bits_;
+
+    if (reader->count() < max_length_) reader->Refill();
+
+    while (true) {
+      Entry entry = entries_[offset + reader->Peek(bits)];
+
+      if (entry.is_leaf) {
+        reader->Skip(entry.bits);
+        return static_cast<char>(entry.value);
       }
-      current = code[i] ? current->right : current->left;
+
+      reader->Skip(bits);
+      offset = entry.value;
+      bits = entry.bits;
     }
+  }
 
-    return text;
-  } else {
+  int max_length() const { return max_length_; }
+
+ private:
+  // Leaves hold a symbol and the number of bits of its codeword within the table; links hold the
+  // offset of the next table and the number of bits which index it.
+  struct Entry {
+    uint32_t value;
+    uint8_t bits;
+    bool is_leaf;
+  };
+
+  // Returns the next length bits of the codeword after its first depth bits.
+  static uint64_t GetBits(const Codeword &codeword, int depth, int length) {
+    return length > 0 ? (codeword.bits << depth) >> (64 - length) : 0;
+  }
+
+  // Builds the table for codewords [first, last), which share their first depth bits, returning
+  // its number of index bits. The table starts at offset.
+  int BuildTable(const std::vector<Codeword> &codewords, size_t first, size_t last, int depth,
+                 size_t offset);
+
+  std::vector<Entry> entries_;
+  int root_bits_;
+  int max_length_;
+};
+
+// Sorted by their bits, the codewords sharing a prefix are consecutive, so each table is built from
+// a range of them.
+HuffmanDecodingTable::HuffmanDecodingTable(std::vector<Codeword> codewords) : max_length_(0) {
+  std::sort(codewords.begin(), codewords.end(), [](const Codeword &lhs, const Codeword &rhs) {
+    return lhs.bits < rhs.bits || (lhs.bits == rhs.bits && lhs.length < rhs.length);
+  });
+
+  for (size_t i = 0; i < codewords.size(); ++i) {
+    max_length_ = std::max(max_length_, std::min(codewords[i].length, 64));
+  }
+
+  root_bits_ = BuildTable(codewords, 0, codewords.size(), 0, 0);
+}
+
+int HuffmanDecodingTable::BuildTable(const std::vector<Codeword> &codewords, size_t first,
+                                     size_t last, int depth, size_t offset) {
+  int max_length = 0;
+  for (size_t i = first; i < last; ++i) {
+    max_length = std::max(max_length, codewords[i].length - depth);
+  }
+
+  int bits = std::min(max_length, kTableBits);
+  // Entries no codeword reaches, which only corrupted codes index, decode to a null character.
+  Entry unused = {0, 1, true};
+  entries_.resize(std::max(entries_.size(), offset + (1 << bits)), unused);
+
+  // Codewords ending on this table fill all entries prefixed by them; each run of the others with
+  // the same next bits gets a subtable.
+  size_t i = first;
+  while (i < last) {
+    int remaining = codewords[i].length - depth;
+    uint64_t index = GetBits(codewords[i], depth, std::min(remaining, bits));
+
+    if (remaining <= bits) {
+      Entry entry = {codewords[i].symbol, static_cast<uint8_t>(remaining), true};
+      std::fill_n(entries_.begin() + offset + (index << (bits - remaining)),
+                  1 << (bits - remaining), entry);
+      ++i;
+      continue;
+    }
+
+    size_t run_end = i + 1;
+    while (run_end < last && codewords[run_end].length - depth > bits &&
+           GetBits(codewords[run_end], depth, bits) == index) {
+      ++run_end;
+    }
+
+    size_t subtable = entries_.size();
+    int subtable_bits = BuildTable(codewords, i, run_end, depth + bits, subtable);
+
+    Entry entry = {static_cast<uint32_t>(subtable), static_cast<uint8_t>(subtable_bits), false};
+    entries_[offset + index] = entry;
+    i = run_end;
+  }
+
+  return bits;
+}
+
+namespace {
+
+std::string DecodeText(const DynamicBitset &code, const std::vector<Codeword> &codewords,
+                       size_t text_length) {
+  if (codewords.empty()) {
     return std::string();
   }
+
+  HuffmanDecodingTable table(codewords);
+  BitReader reader(code);
+  std::string text;
+
+  if (text_length != std::string::npos) {
+    text.resize(text_length);
+    for (size_t i = 0; i < text_length; ++i) {
+      text[i] = table.DecodeSymbol(&reader);
+    }
+  } else if (table.max_length() > 0) {
+    text.reserve(code.size() / table.max_length());
+    while (reader.position() < code.size()) {
+      text.push_back(table.DecodeSymbol(&reader));
+    }
+  }
+
+  return text;
 }
 
-// Returns the Huffman code of the input text and a pointer to the tree generated by Huffman's
-// algorithm. One must free the memory allocated for the tree structure in a further stage
-// on application.
-void HuffmanEncode(const std::string &text, DynamicBitset *code, CodeTable *code_table) {
-  if (text.size() > 0) {
-    // Build tree using Huffman's algorithm.
-    FrequencyTable freq_table = ComputeFrequencyTable(text);
-    HuffmanHeap min_heap;
+std::vector<Codeword> GetCanonicalCodewords(const CodeLengths &code_lengths) {
+  std::array<uint64_t, 256> codes;
+  AssignCanonicalCodes(code_lengths, &codes);
 
-    for (auto it = freq_table.begin(); it != freq_table.end(); ++it) {
-      min_heap.push(new HuffmanHeapNode(it->first, it->second));
+  std::vector<Codeword> codewords;
+  for (int c = 0; c < 256; ++c) {
+    if (code_lengths[c] > 0) {
+      Codeword codeword = {codes[c] << (64 - code_lengths[c]), code_lengths[c],
+                           static_cast<unsigned char>(c)};
+      codewords.push_back(codeword);
     }
+  }
+
+  return codewords;
+}
+
+}  // namespace
 
-    while (min_heap.size() > 1) {
-      HuffmanHeapNode *x = min_heap.top();
-      min_heap.pop();
+HuffmanDecoder::HuffmanDecoder() = default;
 
-      HuffmanHeapNode *y = min_heap.top();
-      min_heap.pop();
+HuffmanDecoder::HuffmanDecoder(const CodeLengths &code_lengths) {
+  std::vector<Codeword> codewords = GetCanonicalCodewords(code_lengths);
+  if (!codewords.empty()) table_.reset(new HuffmanDecodingTable(codewords));
+}
+
+HuffmanDecoder::HuffmanDecoder(HuffmanDecoder &&decoder) = default;
+HuffmanDecoder::~HuffmanDecoder() = default;
+HuffmanDecoder& HuffmanDecoder::operator=(HuffmanDecoder &&decoder) = default;
+
+// Without codewords, there is nothing to decode but null characters.
+void HuffmanDecoder::Decode(const uint64_t *words, size_t num_words, size_t position,
+                            size_t length, char *text) const {
+  if (!table_) {
+    std::fill_n(text, length, '\0');
+    return;
+  }
+
+  BitReader reader(words, num_words, position);
+  for (size_t i = 0; i < length; ++i) {
+    text[i] = table_->DecodeSymbol(&reader);
+  }
+}
+
+// Returns the original text, of the given length, which the input canonical code represents.
+std::string HuffmanDecode(const DynamicBitset &code, const CodeLengths &code_lengths,
+                          size_t text_length) {
+  return DecodeText(code, GetCanonicalCodewords(code_lengths), text_length);
+}
 
-      HuffmanHeapNode *z = new HuffmanHeapNode;
-      z->left = x;
-      z->right = y;      
-      z->freq = x->freq + y->freq;
-      min_heap.push(z); 
+// Each thread decodes a contiguous range of parts, from the sync point of its first one, into its
+// own characters of the text; the decoder is shared.
+std::string HuffmanDecode(const DynamicBitset &code, const CodeLengths &code_lengths,
+                          size_t text_length, const std::vector<uint64_t> &sync_points,
+                          size_t sync_interval, int num_threads) {
+  HuffmanDecoder decoder(code_lengths);
+  std::string text(text_length, '\0');
+  size_t num_parts = sync_points.size() + 1;
+
+  ParallelFor(num_threads, num_parts, [&](int, size_t begin, size_t end) {
+    size_t text_begin = std::min(text_length, begin * sync_interval);
+    size_t text_end = end < num_parts ? std::min(text_length, end * sync_interval) : text_length;
+
+    decoder.Decode(code.data(), DynamicBitset::NumWords(code.size()),
+                   begin > 0 ? sync_points[begin - 1] : 0, text_end - text_begin,
+                   &text[text_begin]);
+  });
+
+  return text;
+}
+
+// Returns the original text which the input code represents. If the text length is unknown
+// (std::string::npos), the code is decoded up to its last bit.
+std::string HuffmanDecode(const DynamicBitset &code, const CodeTable &code_table,
+                          size_t text_length) {
+  std::vector<Codeword> codewords;
+
+  for (auto it = code_table.begin(); it != code_table.end(); ++it) {
+    Codeword codeword = {0, static_cast<int>(it->second.size()),
+                         static_cast<unsigned char>(it->first)};
+    for (int i = 0; i < codeword.length; ++i) {
+      if (it->second[i]) codeword.bits |= 1ULL << (63 - i);
     }
 
-    HuffmanHeapNode *root = min_heap.top();
-    min_heap.pop();
+    codewords.push_back(codeword);
+  }
 
-    // Build code for this text.
-    FillCodeTable(root, *code, code_table);
-    delete root;
+  return DecodeText(code, codewords, text_length);
+}
 
-    for (size_t i = 0; i < text.size(); ++i) {
-      DynamicBitset codeword = (*code_table)[text[i]];
-      for (int j = 0; j < codeword.size(); ++j) {
-        code->PushBack(codeword[j]);
-      }
+// Returns the canonical Huffman code of the input text and the length of each codeword.
+void HuffmanEncode(const std::string &text, DynamicBitset *code, CodeLengths *code_lengths) {
+  *code_lengths = HuffmanCodeLengths(text);
+  HuffmanEncode(text.data(), text.size(), *code_lengths, code);
+}
+
+// The text is split into a chunk per thread. The size of the code of each chunk, and so the bit
+// where it starts, follows from the frequencies of its characters; then every chunk is encoded in
+// place, and only the words shared by two chunks are combined afterwards. The code is the same for
+// any number of threads.
+void HuffmanEncode(const char *text, size_t length, const CodeLengths &code_lengths,
+                   DynamicBitset *code, int num_threads) {
+  std::array<uint64_t, 256> codes;
+  AssignCanonicalCodes(code_lengths, &codes);
+
+  num_threads = GetUsefulThreads(length, num_threads);
+  std::vector<size_t> offsets(num_threads + 1, 0);
+
+  ParallelFor(num_threads, length, [&](int t, size_t begin, size_t end) {
+    FrequencyTable freq_table = CountFrequencies(text + begin, end - begin);
+
+    for (int c = 0; c < 256; ++c) {
+      offsets[t + 1] += freq_table[c] * code_lengths[c];
     }
+  });
+
+  offsets[0] = code->size();
+  for (int t = 0; t < num_threads; ++t) {
+    offsets[t + 1] += offsets[t];
+  }
+
+  code->Resize(offsets[num_threads]);
+  uint64_t *words = code->mutable_data();
+  std::vector<ChunkEdges> edges(num_threads);
+
+  ParallelFor(num_threads, length, [&](int t, size_t begin, size_t end) {
+    EncodeChunk(text + begin, end - begin, code_lengths, codes, offsets[t], words, &edges[t]);
+  });
+
+  for (int t = 0; t < num_threads; ++t) {
+    if (edges[t].first_bits != 0) words[edges[t].first_word] |= edges[t].first_bits;
+    if (edges[t].last_bits != 0) words[edges[t].last_word] |= edges[t].last_bits;
   }
 }
 
-}  // namespace ipmt
+// Returns the length of the canonical Huffman codeword of each byte of the text, limited to
+// kMaxCodeLength bits.
+CodeLengths HuffmanCodeLengths(const std::string &text) {
+  return HuffmanCodeLengths(text.data(), text.size());
+}
+
+CodeLengths HuffmanCodeLengths(const char *text, size_t length, int num_threads) {
+  return HuffmanCodeLengths(ComputeFrequencyTable(text, length, num_threads));
+}
+
+CodeLengths HuffmanCodeLengths(const FrequencyTable &freq_table) {
+  CodeLengths code_lengths;
+  ComputeLimitedCodeLengths(freq_table, &code_lengths);
+
+  return code_lengths;
+}
+
+void CountCharacters(const char *text, size_t length, FrequencyTable *freq_table,
+                     int num_threads) {
+  FrequencyTable counts = ComputeFrequencyTable(text, length, num_threads);
+
+  for (int c = 0; c < 256; ++c) {
+    (*freq_table)[c] += counts[c];
+  }
+}
+
+std::vector<uint64_t> HuffmanCodeSizes(const char *text, size_t length,
+                                       const CodeLengths &code_lengths, size_t interval,
+                                       int num_threads) {
+  std::vector<uint64_t> sizes((length + interval - 1) / interval, 0);
+
+  ParallelFor(GetUsefulThreads(length, num_threads), sizes.size(),
+              [&](int, size_t begin, size_t end) {
+    for (size_t p = begin; p < end; ++p) {
+      size_t part_begin = p * interval;
+      FrequencyTable freq_table = CountFrequencies(text + part_begin,
+                                                   std::min(interval, length - part_begin));
+
+      for (int c = 0; c < 256; ++c) {
+        sizes[p] += freq_table[c] * code_lengths[c];
+      }
+    }
+  });
 
+  return sizes;
+}
+
+}  // namespace ipmt
@@ -0,0 +1,875 @@
+#include "index_file.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <istream>
+#include <streambuf>
+#include <utility>
+#include <vector>
+
+#include "dynamic_bitset.h"
+#include "huffman.h"
+#include "lz78.h"
+#include "utils.h"
+
+// Index file format (version 5). All integers are stored in the host byte order.
+//
+//   IndexHeader    magic number, version and number of sections.
+//   SectionEntry   one entry per section: type, parameter, number of elements, offset and size.
+//   Sections       each one starting at the offset given by its entry.
+//
+// Sections holding packed arrays are page aligned (or word aligned, if smaller than a page) and
+// store the array words as they are in memory, so search mode maps the index file and uses them in
+// place, without copying or decoding. A text Huffman coded whole is followed by its sync points,
+// from which it is decoded on threads.
+//
+// Index files written before this format (see ReadLegacyIndexFile) are still read.
+
+namespace ipmt {
+namespace {
+
+const char kIndexMagic[8] = {'I', 'P', 'M', 'T', 'I', 'D', 'X', '\0'};
+const uint32_t kIndexVersion = 5;
+const size_t kSectionAlignment = 4096;
+// Characters between Huffman sync points. It divides the chunks encoded by WriteHuffmanCode.
+const size_t kHuffmanSyncInterval = 1 << 18;
+
+enum SectionType : uint32_t {
+  kSuffixArraySection = 1,  // Packed array; parameter is its width.
+  kLlcpSection = 2,  // Packed array; parameter is its width.
+  kRlcpSection = 3,  // Packed array; parameter is its width.
+  kTextSection = 4,  // Compressed text; parameter is its compression type.
+  kFMIndexSection = 5,  // FM-index words.
+  kBlockTextSection = 6,  // Block text words; parameter is its compression type.
+  kLineSamplesSection = 7,  // Packed array; parameter is its width.
+  // Bit where the Huffman code of every parameter-th character of the text starts (character 0
+  // excluded), as 64-bit integers.
+  kHuffmanSyncSection = 8
+};
+
+struct IndexHeader {
+  char magic[8];
+  uint32_t version;
+  uint32_t num_sections;
+};
+
+struct SectionEntry {
+  uint32_t type;
+  uint32_t param;
+  uint64_t count;
+  uint64_t offset;
+  uint64_t size;
+};
+
+// Read-only stream buffer over a memory region, used to decode sections of mapped index files.
+class MemoryBuffer : public std::streambuf {
+ public:
+  MemoryBuffer(const char *data, size_t size) {
+    char *begin = const_cast<char*>(data);
+    setg(begin, begin, begin + size);
+  }
+};
+
+void SplitFilename(const std::string &pathname, std::string *filename, std::string *dir) {
+  size_t index = pathname.find_last_of("/\\");
+
+  *filename = index == std::string::npos ? pathname : pathname.substr(index + 1);
+  *dir = index == std::string::npos ? "" : pathname.substr(0, index) + "/";
+}
+
+std::string GetBasenameFromFilename(const std::string &filename) {
+  size_t index = filename.find_last_of(".");
+  return index == std::string::npos ? filename : filename.substr(0, index);
+}
+
+// Reads a bitset prefixed by its number of bits, which legacy index files store as an int. Returns
+// false, without allocating the bitset, if it does not fit in the remaining bytes of the input,
+// which are then updated.
+bool ReadBitset(std::istream &reader, bool is_legacy, size_t *remaining, DynamicBitset *bitset) {
+  uint64_t bits = 0;
+  size_t prefix_size = is_legacy ? sizeof(int) : sizeof(uint64_t);
+
+  if (*remaining < prefix_size) {
+    return false;
+  } else if (!is_legacy) {
+    reader.read(reinterpret_cast<char*>(&bits), sizeof(uint64_t));
+  } else {
+    int narrow_bits = 0;
+    reader.read(reinterpret_cast<char*>(&narrow_bits), sizeof(int));
+    bits = static_cast<uint32_t>(narrow_bits);
+  }
+
+  *remaining -= prefix_size;
+  uint64_t num_bytes = bits / 8 + (bits % 8 != 0);
+  if (!reader || num_bytes > *remaining) {
+    return false;
+  }
+
+  *remaining -= num_bytes;
+  bitset->ReadBytes(reader, bits);
+
+  return true;
+}
+
+// Reads an array of ints prefixed by their number, as written by legacy index files. Returns false,
+// without allocating the array, if it does not fit in the remaining bytes of the input, which are
+// then updated.
+bool ReadIntArray(std::istream &reader, size_t *remaining, std::vector<int> *values) {
+  size_t size = 0;
+  if (*remaining < sizeof(size_t)) {
+    return false;
+  }
+
+  reader.read(reinterpret_cast<char*>(&size), sizeof(size_t));
+  *remaining -= sizeof(size_t);
+
+  if (!reader || size > *remaining / sizeof(int)) {
+    return false;
+  }
+
+  values->resize(size);
+  reader.read(reinterpret_cast<char*>(values->data()), size * sizeof(int));
+  *remaining -= size * sizeof(int);
+
+  return static_cast<bool>(reader);
+}
+
+// Decodes the compressed text, whose length is std::string::npos if unknown (legacy index files do
+// not store it), from the next size bytes of the input. Legacy index files store a Huffman code
+// with its code table and an LZ78 code without the dictionary options. A Huffman code with sync
+// points (see kHuffmanSyncSection) is decoded on num_threads threads. Returns -2 if the compression
+// type is invalid and -3 if the code is corrupted, e.g. if it claims more bytes than there are.
+int ReadText(std::istream &reader, CompressionType type, bool is_legacy, size_t text_length,
+             size_t size, std::string *text,
+             const std::vector<uint64_t> &sync_points = std::vector<uint64_t>(),
+             size_t sync_interval = 0, int num_threads = 1) {
+  if (type == CompressionType::kHuffman && !is_legacy) {
+    CodeLengths code_lengths;
+    if (size < code_lengths.size()) return -3;
+
+    reader.read(reinterpret_cast<char*>(code_lengths.data()), code_lengths.size());
+    size -= code_lengths.size();
+
+    for (size_t i = 0; i < code_lengths.size(); ++i) {
+      if (code_lengths[i] > kMaxCodeLength) return -3;
+    }
+
+    DynamicBitset code;
+    if (!ReadBitset(reader, is_legacy, &size, &code)) return -3;
+
+    *text = sync_interval > 0 ?
+        ipmt::HuffmanDecode(code, code_lengths, text_length, sync_points, sync_interval,
+                            num_threads) :
+        ipmt::HuffmanDecode(code, code_lengths, text_length);
+  } else if (type == CompressionType::kHuffman) {
+    // Read code table.
+    ipmt::CodeTable code_table;
+    size_t table_size;
+    if (size < sizeof(size_t)) return -3;
+
+    reader.read(reinterpret_cast<char*>(&table_size), sizeof(size_t));
+    size -= sizeof(size_t);
+
+    // Each byte has at most one codeword, of 1 to 64 bits.
+    if (table_size > 256) return -3;
+
+    for (size_t i = 0; i < table_size; ++i) {
+      char key;
+      if (size < sizeof(char)) return -3;
+
+      reader.read(&key, sizeof(char));
+      size -= sizeof(char);
+
+      DynamicBitset codeword;
+      if (!ReadBitset(reader, is_legacy, &size, &codeword) || codeword.size() == 0 ||
+          codeword.size() > 64) {
+        return -3;
+      }
+
+      code_table[key] = codeword;
+    }
+
+    DynamicBitset code;
+    if (!ReadBitset(reader, is_legacy, &size, &code)) return -3;
+
+    // Decode index file's text.
+    *text = ipmt::HuffmanDecode(code, code_table, text_length);
+  } else if (type == CompressionType::kLZ78) {
+    LZ78Options options;
+    if (!is_legacy) {
+      uint64_t max_phrases;
+      uint32_t policy;
+      if (size < sizeof(uint64_t) + sizeof(uint32_t)) return -3;
+
+      reader.read(reinterpret_cast<char*>(&max_phrases), sizeof(uint64_t));
+      reader.read(reinterpret_cast<char*>(&policy), sizeof(uint32_t));
+      size -= sizeof(uint64_t) + sizeof(uint32_t);
+
+      options.max_phrases = max_phrases;
+      options.policy = static_cast<DictionaryPolicy>(policy);
+    }
+
+    // Read code size.
+    size_t code_size;
+    if (size < sizeof(size_t)) return -3;
+
+    reader.read(reinterpret_cast<char*>(&code_size), sizeof(size_t));
+    size -= sizeof(size_t);
+
+    // Read the pairs at once, then unpack them.
+    const size_t kPairSize = sizeof(int) + sizeof(char);
+    if (!reader || code_size > size / kPairSize) return -3;
+
+    std::vector<char> buffer(code_size * kPairSize);
+    reader.read(buffer.data(), buffer.size());
+
+    std::vector<std::pair<int, char>> code(code_size);
+    for (size_t i = 0; i < code_size; ++i) {
+      std::memcpy(&code[i].first, &buffer[i * kPairSize], sizeof(int));
+      code[i].second = buffer[i * kPairSize + sizeof(int)];
+    }
+
+    *text = ipmt::LZ78Decode(code, options, text_length);
+  } else {  // Invalid compression type.
+    return -2;
+  }
+
+  return 0;
+}
+
+// Characters of the text counted or encoded at once by num_threads threads.
+size_t HuffmanChunkSize(int num_threads) {
+  return (1 << 20) * static_cast<size_t>(num_threads);
+}
+
+// Writes the Huffman code of the text as a bitset prefixed by its number of bits (see ReadBitset),
+// but encodes the text a chunk at a time and writes each chunk as soon as it is encoded, so the
+// code is never whole in memory. The number of bits is only known at the end, so it is written
+// last. Each chunk is encoded on num_threads threads, taking a part of the chunk each. Appends the
+// bit where the code of every kHuffmanSyncInterval-th character starts to sync_points. Encoding the
+// chunks goes to the "encode" phase of the statistics, if given, and writing them to "write".
+void WriteHuffmanCode(std::ostream &writer, const char *text, size_t length,
+                      const CodeLengths &code_lengths, Stats *stats, PageReleaser *releaser,
+                      int num_threads, std::vector<uint64_t> *sync_points) {
+  const size_t kChunkSize = HuffmanChunkSize(num_threads);
+
+  size_t bits_offset = writer.tellp();
+  uint64_t bits = 0;
+  writer.write(reinterpret_cast<const char*>(&bits), sizeof(uint64_t));
+
+  DynamicBitset code;
+  std::vector<char> bytes;
+
+  for (size_t begin = 0; begin < length; begin += kChunkSize) {
+    if (stats) stats->BeginPhase("encode");
+
+    size_t chunk_size = std::min(kChunkSize, length - begin);
+    std::vector<uint64_t> sizes = HuffmanCodeSizes(text + begin, chunk_size, code_lengths,
+                                                   kHuffmanSyncInterval, num_threads);
+    uint64_t sync_point = bits + code.size();
+
+    for (size_t p = 0; p < sizes.size(); ++p) {
+      if (begin > 0 || p > 0) sync_points->push_back(sync_point);
+      sync_point += sizes[p];
+    }
+
+    HuffmanEncode(text + begin, chunk_size, code_lengths, &code, num_threads);
+    if (releaser) releaser->Advance(chunk_size);
+
+    if (stats) stats->BeginPhase("write");
+
+    // Write the whole words and keep the bits of the last one for the next chunk.
+    size_t num_words = code.size() / DynamicBitset::kWordSize;
+    bytes.resize(num_words * sizeof(uint64_t));
+
+    for (size_t byte = 0; byte < bytes.size(); ++byte) {
+      bytes[byte] = static_cast<char>(code.data()[byte / 8] >> (56 - 8 * (byte % 8)));
+    }
+
+    writer.write(bytes.data(), bytes.size());
+    bits += num_words * DynamicBitset::kWordSize;
+
+    int rest = code.size() % DynamicBitset::kWordSize;
+    uint64_t last_word = rest > 0 ? code.data()[num_words] : 0;
+
+    code = DynamicBitset();
+    if (rest > 0) code.AppendBits(last_word >> (DynamicBitset::kWordSize - rest), rest);
+  }
+
+  bits += code.size();
+  code.WriteBytes(writer);
+
+  size_t end = writer.tellp();
+  writer.seekp(bits_offset);
+  writer.write(reinterpret_cast<const char*>(&bits), sizeof(uint64_t));
+  writer.seekp(end);
+}
+
+// Compressed text, encoded before any part of the index file is written. Only the code lengths of
+// a Huffman coded text are computed beforehand, as its code is encoded while it is written (see
+// WriteHuffmanCode). The characters of a Huffman coded text are counted a chunk at a time, so the
+// pages of a memory mapped text may be released in between.
+struct EncodedText {
+  CodeLengths code_lengths;
+  std::vector<std::pair<int, char>> lz78_code;
+  BlockText block_text;
+};
+
+void EncodeText(const char *text, size_t length, CompressionType type,
+                const LZ78Options &lz78_options, size_t block_size, PageReleaser *releaser,
+                int num_threads, EncodedText *encoded) {
+  if (block_size > 0) {
+    encoded->block_text = BlockText::Build(text, length, type, lz78_options, block_size,
+                                           num_threads);
+    if (releaser) releaser->Advance(length);
+  } else if (type == CompressionType::kHuffman) {
+    const size_t kChunkSize = HuffmanChunkSize(num_threads);
+    FrequencyTable freq_table = FrequencyTable();
+
+    for (size_t begin = 0; begin < length; begin += kChunkSize) {
+      size_t chunk_size = std::min(kChunkSize, length - begin);
+      CountCharacters(text + begin, chunk_size, &freq_table, num_threads);
+      if (releaser) releaser->Advance(chunk_size);
+    }
+
+    encoded->code_lengths = HuffmanCodeLengths(freq_table);
+  } else {  // type == CompressionType::kLZ78.
+    LZ78Encode(text, length, &encoded->lz78_code, lz78_options);
+    if (releaser) releaser->Advance(length);
+  }
+}
+
+// Writes the text encoded by EncodeText without blocks. The sync points of a Huffman code are
+// appended to sync_points.
+void WriteText(std::ostream &writer, const char *text, size_t length, CompressionType type,
+               const LZ78Options &lz78_options, const EncodedText &encoded, Stats *stats,
+               PageReleaser *releaser, int num_threads, std::vector<uint64_t> *sync_points) {
+  if (type == CompressionType::kHuffman) {
+    // Write code lengths.
+    writer.write(reinterpret_cast<const char*>(encoded.code_lengths.data()),
+                 encoded.code_lengths.size());
+
+    // Write encoded text.
+    WriteHuffmanCode(writer, text, length, encoded.code_lengths, stats, releaser, num_threads,
+                     sync_points);
+  } else {  // type == CompressionType::kLZ78.
+    const std::vector<std::pair<int, char>> &code = encoded.lz78_code;
+
+    // Write dictionary options.
+    uint64_t max_phrases = lz78_options.max_phrases;
+    uint32_t policy = static_cast<uint32_t>(lz78_options.policy);
+    writer.write(reinterpret_cast<const char*>(&max_phrases), sizeof(uint64_t));
+    writer.write(reinterpret_cast<const char*>(&policy), sizeof(uint32_t));
+
+    // Write encoded text.
+    size_t code_size = code.size();
+    writer.write(reinterpret_cast<const char*>(&code_size), sizeof(size_t));
+
+    for (size_t i = 0; i < code_size; ++i) {
+      writer.write(reinterpret_cast<const char*>(&code[i].first), sizeof(int));
+      writer.write(&code[i].second, sizeof(char));
+    }
+  }
+}
+
+// Compatibility path for index files written before the versioned format: the suffix array, as
+// plain ints prefixed by their number, then the compressed text after a newline-terminated tag
+// naming its compression type. They have no LCP arrays, so they are searched by plain binary
+// search. As any file without the magic number of the versioned format ends up here, every size
+// read is checked against the bytes left before allocating, and the suffix array against the text.
+int ReadLegacyIndexFile(const std::string &index_path, Index *index, Stats *stats) {
+  std::ifstream reader(index_path, std::ifstream::binary | std::ifstream::ate);
+  if (!reader) {  // Cannot open file.
+    return -1;
+  }
+
+  size_t remaining = reader.tellg();
+  reader.seekg(0);
+
+  // Read suffix array.
+  std::vector<int> suffix_array;
+  if (!ReadIntArray(reader, &remaining, &suffix_array)) {
+    return -3;
+  }
+
+  std::string compression_type;
+  std::getline(reader, compression_type);
+
+  if (!compression_type.compare("huffman")) {
+    index->compression_type = CompressionType::kHuffman;
+  } else if (!compression_type.compare("lz78")) {
+    index->compression_type = CompressionType::kLZ78;
+  } else {  // Invalid compression type.
+    return -2;
+  }
+
+  if (stats) stats->BeginPhase("decode");
+  size_t text_start = reader.tellg();
+  reader.seekg(0, std::ios_base::end);
+  size_t text_end = reader.tellg();
+  reader.seekg(text_start);
+
+  if (!reader || text_end < text_start) {
+    return -3;
+  }
+
+  int status = ReadText(reader, index->compression_type, true, std::string::npos,
+                        text_end - text_start, &index->text);
+  if (status != 0) {
+    return status;
+  }
+
+  // Searches read the text at every position of the suffix array. The LZ78 encoder of those
+  // files drops the last phrase if the text ends within a phrase already in the dictionary, so the
+  // text may be shorter than the suffix array, whose positions past its end are dropped then.
+  size_t text_size = index->text.size();
+  if (suffix_array.size() < text_size) {
+    return -3;
+  }
+
+  for (size_t i = 0; i < suffix_array.size(); ++i) {
+    if (suffix_array[i] < 0 || static_cast<size_t>(suffix_array[i]) >= suffix_array.size()) {
+      return -3;
+    }
+  }
+
+  suffix_array.erase(std::remove_if(suffix_array.begin(), suffix_array.end(),
+                                    [text_size](int pos) {
+                                      return static_cast<size_t>(pos) >= text_size;
+                                    }),
+                     suffix_array.end());
+  index->suffix_array = PackArray(suffix_array);
+
+  if (stats) {
+    stats->set_text_size(index->text.size());
+    stats->set_compressed_size(static_cast<size_t>(reader.tellg()) - text_start);
+  }
+
+  return 0;
+}
+
+// Pads the file with zeros up to the next multiple of alignment and starts a new section there.
+SectionEntry BeginSection(std::ofstream &writer, SectionType type, uint32_t param,
+                          uint64_t count, size_t alignment) {
+  size_t offset = writer.tellp();
+  size_t padding = (alignment - offset % alignment) % alignment;
+  std::vector<char> zeros(padding, 0);
+  writer.write(zeros.data(), padding);
+
+  SectionEntry entry;
+  entry.type = type;
+  entry.param = param;
+  entry.count = count;
+  entry.offset = offset + padding;
+  entry.size = 0;
+
+  return entry;
+}
+
+void EndSection(std::ofstream &writer, SectionEntry *entry) {
+  entry->size = static_cast<uint64_t>(writer.tellp()) - entry->offset;
+}
+
+// Arrays smaller than a page are only word aligned, so small texts do not get large index files.
+// Arrays are written a chunk at a time, so the pages of a memory mapped array may be released in
+// between.
+SectionEntry WritePackedArraySection(std::ofstream &writer, SectionType type,
+                                     const PackedArray &array, PageReleaser *releaser = nullptr) {
+  const size_t kChunkSize = 1 << 20;
+  const char *data = reinterpret_cast<const char*>(array.data());
+  size_t bytes = array.num_words() * sizeof(uint64_t);
+  size_t alignment = bytes < kSectionAlignment ? sizeof(uint64_t) : kSectionAlignment;
+
+  SectionEntry entry = BeginSection(writer, type, array.width(), array.size(), alignment);
+  for (size_t begin = 0; begin < bytes; begin += kChunkSize) {
+    size_t chunk_size = std::min(kChunkSize, bytes - begin);
+    writer.write(data + begin, chunk_size);
+    if (releaser) releaser->Advance(chunk_size);
+  }
+  EndSection(writer, &entry);
+
+  return entry;
+}
+
+// Returns a view of the packed array stored on the section, or false if the section is too small.
+bool ViewPackedArraySection(const MappedFile &file, const SectionEntry &entry,
+                            PackedArray *array) {
+  if (entry.param == 0 || entry.param > 64 || entry.offset % sizeof(uint64_t) != 0 ||
+      PackedArray::NumWords(entry.count, entry.param) * sizeof(uint64_t) > entry.size) {
+    return false;
+  }
+
+  const uint64_t *words = reinterpret_cast<const uint64_t*>(file.data() + entry.offset);
+  *array = PackedArray::View(words, entry.count, entry.param);
+
+  return true;
+}
+
+// Writes zeros in place of the header and the section table, which are written by
+// WriteSectionTable once all sections are written.
+void ReserveSectionTable(std::ofstream &writer, uint32_t num_sections) {
+  std::vector<char> zeros(sizeof(IndexHeader) + num_sections * sizeof(SectionEntry), 0);
+  writer.write(zeros.data(), zeros.size());
+}
+
+void WriteSectionTable(std::ofstream &writer, const std::vector<SectionEntry> &sections) {
+  IndexHeader header;
+  std::memcpy(header.magic, kIndexMagic, sizeof(kIndexMagic));
+  header.version = kIndexVersion;
+  header.num_sections = sections.size();
+
+  writer.seekp(0);
+  writer.write(reinterpret_cast<const char*>(&header), sizeof(IndexHeader));
+  writer.write(reinterpret_cast<const char*>(sections.data()),
+               sections.size() * sizeof(SectionEntry));
+}
+
+// Index files are written to a temporary file which then replaces the index file, so processes
+// which have the index file mapped (e.g. a search server) never see it partially written.
+std::string GetTemporaryPath(const std::string &index_path) {
+  return index_path + ".tmp";
+}
+
+int CommitIndexFile(std::ofstream &writer, const std::string &index_path, Stats *stats) {
+  writer.seekp(0, std::ios_base::end);
+  if (stats) stats->AddBytesWritten(writer.tellp());
+
+  writer.close();
+
+  if (!writer || std::rename(GetTemporaryPath(index_path).c_str(), index_path.c_str()) != 0) {
+    std::remove(GetTemporaryPath(index_path).c_str());
+    return -1;
+  }
+
+  return 0;
+}
+
+}  // namespace
+
+std::string GetIndexPath(const std::string &pathname) {
+  std::string filename, dir;
+
+  SplitFilename(pathname, &filename, &dir);
+
+  return dir + GetBasenameFromFilename(filename) + ".idx";
+}
+
+int ReadIndexFile(const std::string &index_path, Index *index, Stats *stats, int num_threads) {
+  if (stats) stats->BeginPhase("load");
+
+  MappedFile file;
+  if (!file.Open(index_path)) {
+    return -1;
+  }
+
+  index->index_type = IndexType::kSuffixArray;
+  if (stats) stats->AddBytesRead(file.size());
+
+  IndexHeader header;
+  if (file.size() < sizeof(IndexHeader) ||
+      std::memcmp(file.data(), kIndexMagic, sizeof(kIndexMagic))) {
+    file.Close();
+    return ReadLegacyIndexFile(index_path, index, stats);
+  }
+
+  std::memcpy(&header, file.data(), sizeof(IndexHeader));
+  size_t table_end = sizeof(IndexHeader) + header.num_sections * sizeof(SectionEntry);
+
+  if (header.version != kIndexVersion || table_end > file.size()) {
+    return -3;
+  }
+
+  const SectionEntry *table = reinterpret_cast<const SectionEntry*>(file.data() +
+                                                                    sizeof(IndexHeader));
+  // The text is decoded once all sections are read, since its sync points may come after it.
+  SectionEntry text_entry = SectionEntry();
+  SectionEntry sync_entry = SectionEntry();
+  bool has_text = false;
+  bool has_block_text = false;
+  bool has_sync_points = false;
+
+  for (uint32_t i = 0; i < header.num_sections; ++i) {
+    SectionEntry entry;
+    std::memcpy(&entry, &table[i], sizeof(SectionEntry));
+
+    if (entry.offset > file.size() || entry.size > file.size() - entry.offset) {
+      return -3;
+    }
+
+    bool is_valid = true;
+
+    switch (entry.type) {
+      case kSuffixArraySection:
+        is_valid = ViewPackedArraySection(file, entry, &index->suffix_array);
+        break;
+
+      case kLlcpSection:
+        is_valid = ViewPackedArraySection(file, entry, &index->search_lcp.llcp);
+        break;
+
+      case kRlcpSection:
+        is_valid = ViewPackedArraySection(file, entry, &index->search_lcp.rlcp);
+        break;
+
+      case kLineSamplesSection:
+        is_valid = ViewPackedArraySection(file, entry, &index->line_samples);
+        break;
+
+      case kTextSection:
+        text_entry = entry;
+        has_text = true;
+        break;
+
+      case kHuffmanSyncSection:
+        sync_entry = entry;
+        has_sync_points = true;
+        is_valid = entry.param > 0 && entry.count <= entry.size / sizeof(uint64_t);
+        break;
+
+      case kBlockTextSection:
+        index->compression_type = static_cast<CompressionType>(entry.param);
+        if (stats) {
+          stats->set_text_size(entry.count);
+          stats->set_compressed_size(entry.size);
+        }
+
+        has_block_text = true;
+        is_valid = entry.offset % sizeof(uint64_t) == 0 &&
+                   index->block_text.View(reinterpret_cast<const uint64_t*>(file.data() +
+                                                                            entry.offset),
+                                          entry.size / sizeof(uint64_t));
+        break;
+
+      case kFMIndexSection:
+        index->index_type = IndexType::kFMIndex;
+        if (stats) {
+          stats->set_text_size(entry.count);
+          stats->set_compressed_size(entry.size);
+        }
+
+        is_valid = entry.offset % sizeof(uint64_t) == 0 &&
+                   index->fm_index.View(reinterpret_cast<const uint64_t*>(file.data() +
+                                                                          entry.offset),
+                                        entry.size / sizeof(uint64_t));
+        break;
+
+      default:  // Unknown sections are skipped.
+        break;
+    }
+
+    if (!is_valid) {
+      return -3;
+    }
+  }
+
+  // A suffix array index needs its text, and its arrays must have an entry per character of it (so
+  // the length of the text is bounded by the size of the file too).
+  if (index->index_type == IndexType::kSuffixArray) {
+    size_t text_size = has_text ? text_entry.count : index->block_text.size();
+
+    if ((!has_text && !has_block_text) || index->suffix_array.size() != text_size ||
+        index->search_lcp.llcp.size() != text_size || index->search_lcp.rlcp.size() != text_size) {
+      return -3;
+    }
+  }
+
+  if (has_text) {
+    MemoryBuffer buffer(file.data() + text_entry.offset, text_entry.size);
+    std::istream reader(&buffer);
+    std::vector<uint64_t> sync_points;
+    size_t sync_interval = 0;
+
+    // There must be a sync point at each multiple of the interval within the text.
+    if (has_sync_points) {
+      sync_interval = sync_entry.param;
+      size_t num_parts = (text_entry.count + sync_interval - 1) / sync_interval;
+
+      if (sync_entry.count != std::max<size_t>(num_parts, 1) - 1) {
+        return -3;
+      }
+
+      sync_points.resize(sync_entry.count);
+      std::memcpy(sync_points.data(), file.data() + sync_entry.offset,
+                  sync_points.size() * sizeof(uint64_t));
+    }
+
+    index->compression_type = static_cast<CompressionType>(text_entry.param);
+    if (stats) stats->BeginPhase("decode");
+
+    int status = ReadText(reader, index->compression_type, false, text_entry.count,
+                          text_entry.size, &index->text, sync_points, sync_interval, num_threads);
+    if (status != 0) return status;
+
+    if (stats) {
+      stats->set_text_size(text_entry.count);
+      stats->set_compressed_size(text_entry.size);
+      stats->BeginPhase("load");
+    }
+  }
+
+  index->file = std::move(file);
+
+  return 0;
+}
+
+int WriteIndexFile(const std::string &index_path, const PackedArray &suffix_array,
+                   const SearchLcp &search_lcp, const PackedArray &line_samples,
+                   const std::string &text, const CompressionType &type,
+                   const LZ78Options &lz78_options, size_t block_size, Stats *stats,
+                   int num_threads) {
+  return WriteIndexFile(index_path, suffix_array, search_lcp, line_samples, text.data(),
+                        text.size(), type, lz78_options, block_size, stats, num_threads);
+}
+
+int WriteIndexFile(const std::string &index_path, const PackedArray &suffix_array,
+                   const SearchLcp &search_lcp, const PackedArray &line_samples,
+                   const char *text, size_t text_size, const CompressionType &type,
+                   const LZ78Options &lz78_options, size_t block_size, Stats *stats,
+                   int num_threads, PageReleaser *releaser) {
+  if (stats) stats->BeginPhase("encode");
+
+  EncodedText encoded;
+  EncodeText(text, text_size, type, lz78_options, block_size, releaser, num_threads, &encoded);
+
+  if (stats) stats->BeginPhase("write");
+
+  std::ofstream writer(GetTemporaryPath(index_path), std::ofstream::binary);
+  std::vector<SectionEntry> sections;
+  ReserveSectionTable(writer, 6);
+
+  // Write suffix array, LCP arrays and line samples.
+  sections.push_back(WritePackedArraySection(writer, kSuffixArraySection, suffix_array, releaser));
+  sections.push_back(WritePackedArraySection(writer, kLlcpSection, search_lcp.llcp, releaser));
+  sections.push_back(WritePackedArraySection(writer, kRlcpSection, search_lcp.rlcp, releaser));
+  sections.push_back(WritePackedArraySection(writer, kLineSamplesSection, line_samples));
+
+  // Write compressed text, either as a single code (with its sync points, if Huffman coded) or in
+  // blocks.
+  uint64_t compressed_size = 0;
+
+  if (block_size == 0) {
+    std::vector<uint64_t> sync_points;
+    SectionEntry text_section = BeginSection(writer, kTextSection, static_cast<uint32_t>(type),
+                                             text_size, sizeof(uint64_t));
+    WriteText(writer, text, text_size, type, lz78_options, encoded, stats, releaser, num_threads,
+              &sync_points);
+    EndSection(writer, &text_section);
+    sections.push_back(text_section);
+    compressed_size = text_section.size;
+
+    if (type == CompressionType::kHuffman) {
+      SectionEntry sync_section = BeginSection(writer, kHuffmanSyncSection, kHuffmanSyncInterval,
+                                               sync_points.size(), sizeof(uint64_t));
+      writer.write(reinterpret_cast<const char*>(sync_points.data()),
+                   sync_points.size() * sizeof(uint64_t));
+      EndSection(writer, &sync_section);
+      sections.push_back(sync_section);
+    }
+  } else {
+    const BlockText &block_text = encoded.block_text;
+    SectionEntry text_section = BeginSection(writer, kBlockTextSection,
+                                             static_cast<uint32_t>(type), text_size,
+                                             sizeof(uint64_t));
+    writer.write(reinterpret_cast<const char*>(block_text.data()),
+                 block_text.num_words() * sizeof(uint64_t));
+    EndSection(writer, &text_section);
+    sections.push_back(text_section);
+    compressed_size = text_section.size;
+  }
+
+  if (stats) {
+    stats->set_text_size(text_size);
+    stats->set_compressed_size(compressed_size);
+  }
+
+  WriteSectionTable(writer, sections);
+
+  return CommitIndexFile(writer, index_path, stats);
+}
+
+// FM-index files have a section with the words of the FM-index, which replaces both the suffix
+// array and the text, besides the line samples.
+int WriteFMIndexFile(const std::string &index_path, const FMIndex &fm_index,
+                     const PackedArray &line_samples, Stats *stats) {
+  if (stats) stats->BeginPhase("write");
+
+  std::ofstream writer(GetTemporaryPath(index_path), std::ofstream::binary);
+  std::vector<SectionEntry> sections;
+  ReserveSectionTable(writer, 2);
+
+  SectionEntry entry = BeginSection(writer, kFMIndexSection, 0, fm_index.size(),
+                                    kSectionAlignment);
+  writer.write(reinterpret_cast<const char*>(fm_index.data()),
+               fm_index.num_words() * sizeof(uint64_t));
+  EndSection(writer, &entry);
+  sections.push_back(entry);
+  sections.push_back(WritePackedArraySection(writer, kLineSamplesSection, line_samples));
+
+  if (stats) {
+    stats->set_text_size(fm_index.size());
+    stats->set_compressed_size(entry.size);
+  }
+
+  WriteSectionTable(writer, sections);
+
+  return CommitIndexFile(writer, index_path, stats);
+}
+
+size_t GetTextSize(const Index &index) {
+  if (index.index_type == IndexType::kFMIndex) {
+    return index.fm_index.size();
+  }
+
+  return index.block_text.empty() ? index.text.size() : index.block_text.size();
+}
+
+std::string ExtractText(const Index &index, size_t pos, size_t length) {
+  if (index.index_type == IndexType::kFMIndex) {
+    return index.fm_index.Extract(pos, length);
+  } else if (!index.block_text.empty()) {
+    return index.block_text.Extract(pos, length);
+  }
+
+  return pos < index.text.size() ? index.text.substr(pos, length) : std::string();
+}
+
+std::string ExtractTextLine(const Index &index, size_t pos, size_t *line_start) {
+  if (index.index_type == IndexType::kFMIndex) {
+    return index.fm_index.ExtractLine(pos, line_start);
+  } else if (!index.block_text.empty()) {
+    return index.block_text.ExtractLine(pos, line_start);
+  }
+
+  const std::string &text = index.text;
+  const void *lf = pos > 0 ? memrchr(text.data(), '\n', pos) : nullptr;
+  *line_start = lf ? static_cast<const char*>(lf) - text.data() + 1 : 0;
+
+  size_t end = pos < text.size() ? text.find('\n', pos) : std::string::npos;
+  return text.substr(*line_start, (end == std::string::npos ? text.size() : end) - *line_start);
+}
+
+size_t CountOccurrences(const Index &index, const std::string &pattern) {
+  if (index.index_type == IndexType::kFMIndex) {
+    return index.fm_index.Count(pattern);
+  } else if (!index.block_text.empty()) {
+    return FindInterval(pattern, index.block_text, index.suffix_array, index.search_lcp).size();
+  }
+
+  return FindInterval(pattern, index.text, index.suffix_array, index.search_lcp).size();
+}
+
+std::vector<size_t> LocateOccurrences(const Index &index, const std::string &pattern,
+                                      size_t limit) {
+  if (index.index_type == IndexType::kFMIndex) {
+    return index.fm_index.Locate(pattern, limit);
+  } else if (!index.block_text.empty()) {
+    return GetOccurrences(pattern, index.block_text, index.suffix_array, index.search_lcp, limit);
+  }
+
+  return GetOccurrences(pattern, index.text, index.suffix_array, index.search_lcp, limit);
+}
+
+}  // namespace ipmt
@@ -0,0 +1,520 @@
+#include "indexer.h"
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <limits>
+#include <mutex>
+#include <new>
+#include <thread>
+#include <utility>
+
+#include "external_sufarray.h"
+#include "fm_index.h"
+#include "index_file.h"
+#include "line_samples.h"
+#include "manifest.h"
+#include "mapped_file.h"
+#include "packed_array.h"
+#include "segmented_index.h"
+#include "sufarray.h"
+
+#include <sys/stat.h>
+
+namespace ipmt {
+namespace {
+
+struct Job {
+  std::string filename;
+  uint64_t memory;
+};
+
+// Hands out jobs to the worker threads, keeping the estimated memory of the running jobs within the
+// budget. Jobs are sorted by decreasing memory, so large files start first and small ones fill the
+// memory left.
+class JobQueue {
+ public:
+  JobQueue(std::vector<Job> jobs, uint64_t memory_budget)
+      : jobs_(std::move(jobs)), memory_budget_(memory_budget), memory_used_(0), running_(0) {
+    std::stable_sort(jobs_.begin(), jobs_.end(), [](const Job &lhs, const Job &rhs) {
+      return lhs.memory > rhs.memory;
+    });
+  }
+
+  // Waits for a job which fits in the memory left (any job, if none is running) and takes it.
+  // Returns false once all jobs were taken.
+  bool Take(Job *job) {
+    std::unique_lock<std::mutex> lock(mutex_);
+
+    while (!jobs_.empty()) {
+      for (auto it = jobs_.begin(); it != jobs_.end(); ++it) {
+        if (running_ == 0 || memory_used_ + it->memory <= memory_budget_) {
+          *job = *it;
+          jobs_.erase(it);
+          memory_used_ += job->memory;
+          ++running_;
+
+          return true;
+        }
+      }
+
+      finished_.wait(lock);
+    }
+
+    return false;
+  }
+
+  void Finish(const Job &job) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    memory_used_ -= job.memory;
+    --running_;
+    finished_.notify_all();
+  }
+
+  // Prints a message without interleaving it with messages from other threads.
+  void Report(const std::string &message, std::ostream &out = std::cout) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    out << message << std::endl;
+  }
+
+ private:
+  std::vector<Job> jobs_;
+  uint64_t memory_budget_;
+  uint64_t memory_used_;
+  int running_;
+  std::mutex mutex_;
+  std::condition_variable finished_;
+};
+
+// Returns -1 if the file does not exist or is not a regular file.
+int64_t GetFileSize(const std::string &filename) {
+  struct stat file_stat;
+  if (stat(filename.c_str(), &file_stat) != 0 || !S_ISREG(file_stat.st_mode)) {
+    return -1;
+  }
+
+  return file_stat.st_size;
+}
+
+std::string GetErrorMessage(int status, const std::string &filename) {
+  switch (status) {
+    case -1:
+      return "Cannot read file " + filename + ".";
+    case -2:
+      return "Cannot write index file of " + filename + ".";
+    case -4:
+      return "Cannot write temporary files to index file " + filename + ".";
+    default:
+      return "Not enough memory to index file " + filename + ".";
+  }
+}
+
+// Temporary files go next to the given file (the text or index file) unless a scratch directory is
+// given.
+std::string GetScratchDir(const std::string &filename, const IndexOptions &options) {
+  if (!options.scratch_dir.empty()) {
+    return options.scratch_dir;
+  }
+
+  size_t index = filename.find_last_of("/\\");
+  return index == std::string::npos ? "." : filename.substr(0, index);
+}
+
+// IndexText for the external algorithm, on a memory mapped text. Besides the buffers of the
+// external sorts, memory only holds the pages of the text and of the scratch arrays gone through
+// since they were last released, and the line samples. The FM-index, text blocks and LZ78 code are
+// built in memory, though.
+int IndexTextExternal(const char *text, size_t text_size, const std::string &index_path,
+                      const std::string &scratch_dir, const IndexOptions &options,
+                      Stats *stats) {
+  if (stats) stats->BeginPhase("build");
+
+  try {
+    ScratchArray suffix_array, lcp;
+
+    if (!BuildSuffixArrayExternal(text, text_size, scratch_dir, options.memory_limit,
+                                  options.num_threads, &suffix_array, &lcp)) {
+      return -4;
+    }
+
+    PageReleaser releaser(ReleaseInterval(options.memory_limit));
+    releaser.Add(text, text_size);
+    suffix_array.AddTo(&releaser);
+    lcp.AddTo(&releaser);
+
+    PackedArray line_samples = SampleLineStarts(text, text_size, &releaser);
+    int status;
+
+    if (options.index_type == IndexType::kFMIndex) {
+      if (stats) stats->BeginPhase("encode");
+      FMIndex fm_index = FMIndex::Build(text, text_size, suffix_array.array());
+      status = WriteFMIndexFile(index_path, fm_index, line_samples, stats);
+    } else {
+      ScratchArray llcp, rlcp;
+      if (!llcp.Create(scratch_dir, text_size, lcp.array().width()) ||
+          !rlcp.Create(scratch_dir, text_size, lcp.array().width())) {
+        return -4;
+      }
+
+      llcp.AddTo(&releaser);
+      rlcp.AddTo(&releaser);
+
+      SearchLcp search_lcp = {llcp.array(), rlcp.array()};
+      BuildSearchLcp(lcp.array(), &search_lcp, &releaser);
+      status = WriteIndexFile(index_path, suffix_array.array(), search_lcp, line_samples, text,
+                              text_size, options.compression_type, options.lz78_options,
+                              options.block_size, stats, options.num_threads, &releaser);
+    }
+
+    return status == 0 ? 0 : -2;
+  } catch (const std::bad_alloc&) {
+    return -3;
+  }
+}
+
+// Returns the number of line feeds of the file, or -1 if it cannot be read.
+int64_t CountFileLineFeeds(const std::string &filename) {
+  if (GetFileSize(filename) == 0) {
+    return 0;
+  }
+
+  MappedFile text;
+  if (!text.Open(filename)) {
+    return -1;
+  }
+
+  return std::count(text.data(), text.data() + text.size(), '\n');
+}
+
+// Run of consecutive segments to be merged by CompactSegments: segments [first, last).
+struct SegmentRun {
+  size_t first;
+  size_t last;
+  uint64_t size;
+};
+
+// Size-tiered compaction: going from the oldest segment to the newest, a run is merged with the
+// run before it while that one is at most kCompactionRatio times larger. Runs then grow
+// geometrically towards the oldest ones, so there are O(log n) of them and each position is merged
+// again O(log n) times as text is appended.
+const uint64_t kCompactionRatio = 2;
+
+std::vector<SegmentRun> PlanCompaction(const std::vector<Segment> &segments, bool full) {
+  std::vector<SegmentRun> runs;
+
+  for (size_t i = 0; i < segments.size(); ++i) {
+    SegmentRun run = {i, i + 1, segments[i].size};
+    runs.push_back(run);
+
+    while (runs.size() > 1 &&
+           (full || runs[runs.size() - 2].size <= kCompactionRatio * runs.back().size)) {
+      runs[runs.size() - 2].last = runs.back().last;
+      runs[runs.size() - 2].size += runs.back().size;
+      runs.pop_back();
+    }
+  }
+
+  return runs;
+}
+
+}  // namespace
+
+// The text and its code, plus the integer arrays of the text size that suffix array construction
+// keeps alive at its peak: SA-IS two (the suffix array and the array of the LCP pass), Manber and
+// Myers' algorithm four and parallel prefix doubling seven (three per entry, on the entries and on
+// those kept by each round, and the ranks). The external algorithm keeps to its own memory limit.
+uint64_t EstimateIndexMemory(uint64_t text_size, SuffixArrayAlgorithm algorithm) {
+  uint64_t index_size = text_size < static_cast<uint64_t>(std::numeric_limits<int>::max()) ?
+                        sizeof(int) : sizeof(int64_t);
+  uint64_t num_arrays = algorithm == SuffixArrayAlgorithm::kSAIS ? 2 :
+                        algorithm == SuffixArrayAlgorithm::kParallelDoubling ? 7 : 4;
+
+  return text_size * (2 + num_arrays * index_size);
+}
+
+int IndexFile(const std::string &filename, const IndexOptions &options, Stats *stats) {
+  return IndexFile(filename, GetIndexPath(filename), options, stats);
+}
+
+int IndexFile(const std::string &filename, const std::string &index_path,
+              const IndexOptions &options, Stats *stats) {
+  if (stats) stats->BeginPhase("read");
+
+  // Empty files cannot be mapped, but take no memory either.
+  int64_t file_size = GetFileSize(filename);
+  if (options.algorithm == SuffixArrayAlgorithm::kExternal && file_size > 0) {
+    MappedFile text;
+    if (!text.Open(filename)) {
+      return -1;
+    }
+
+    if (stats) stats->AddBytesRead(text.size());
+    return IndexTextExternal(text.data(), text.size(), index_path,
+                             GetScratchDir(filename, options), options, stats);
+  }
+
+  std::ifstream ifs(filename, std::ifstream::binary);
+  if (file_size < 0 || !ifs) {
+    return -1;
+  }
+
+  try {
+    std::string text(file_size, '\0');
+    ifs.read(&text[0], text.size());
+    if (!ifs) {
+      return -1;
+    }
+
+    if (stats) stats->AddBytesRead(text.size());
+    return IndexText(text, index_path, options, stats);
+  } catch (const std::bad_alloc&) {
+    return -3;
+  }
+}
+
+int IndexText(const std::string &text, const std::string &index_path,
+              const IndexOptions &options, Stats *stats) {
+  // The external algorithm reads the text through a file mapping, whose pages it can drop from
+  // memory, so a text already in memory is copied to a temporary file first.
+  if (options.algorithm == SuffixArrayAlgorithm::kExternal && !text.empty()) {
+    std::string scratch_dir = GetScratchDir(index_path, options);
+    MappedFile mapped_text;
+
+    if (!mapped_text.CreateTemporary(scratch_dir, text.size())) {
+      return -4;
+    }
+
+    std::memcpy(mapped_text.mutable_data(), text.data(), text.size());
+    return IndexTextExternal(mapped_text.data(), mapped_text.size(), index_path, scratch_dir,
+                             options, stats);
+  }
+
+  if (stats) stats->BeginPhase("build");
+
+  try {
+    // Build index and write index file. The FM-index is built from the suffix array, but replaces
+    // both it and the text.
+    PackedArray suffix_array = BuildSuffixArray(text, options.algorithm, options.num_threads);
+    PackedArray line_samples = SampleLineStarts(text);
+    int status;
+
+    if (options.index_type == IndexType::kFMIndex) {
+      if (stats) stats->BeginPhase("encode");
+      FMIndex fm_index = FMIndex::Build(text, suffix_array);
+      status = WriteFMIndexFile(index_path, fm_index, line_samples, stats);
+    } else {
+      SearchLcp search_lcp = BuildSearchLcp(BuildLcpArray(text, suffix_array));
+      status = WriteIndexFile(index_path, suffix_array, search_lcp, line_samples, text,
+                              options.compression_type, options.lz78_options,
+                              options.block_size, stats, options.num_threads);
+    }
+
+    return status == 0 ? 0 : -2;
+  } catch (const std::bad_alloc&) {
+    return -3;
+  }
+}
+
+size_t IndexFiles(const std::vector<std::string> &filenames, const IndexOptions &options,
+                  int num_jobs, uint64_t memory_budget) {
+  std::vector<Job> jobs;
+  jobs.reserve(filenames.size());
+
+  for (size_t i = 0; i < filenames.size(); ++i) {
+    // Files which cannot be read take no memory; IndexFile reports them.
+    uint64_t memory = options.algorithm == SuffixArrayAlgorithm::kExternal ? options.memory_limit :
+                      EstimateIndexMemory(std::max<int64_t>(GetFileSize(filenames[i]), 0),
+                                          options.algorithm);
+    Job job = {filenames[i], memory};
+    jobs.push_back(job);
+  }
+
+  JobQueue queue(std::move(jobs), memory_budget);
+  std::atomic<size_t> failures(0);
+  size_t num_threads = std::min(static_cast<size_t>(std::max(num_jobs, 1)), filenames.size());
+
+  // Files indexed at once split the threads instead of each taking them all; the first
+  // options.num_threads % num_workers workers get one more.
+  int num_workers = static_cast<int>(std::max<size_t>(num_threads, 1));
+
+  auto worker = [&](int w) {
+    IndexOptions job_options = options;
+    job_options.num_threads = std::max(1, options.num_threads / num_workers +
+                                              (w < options.num_threads % num_workers ? 1 : 0));
+    Job job;
+
+    while (queue.Take(&job)) {
+      // The peak memory is per file only while files are indexed one at a time.
+      Stats stats("index", job.filename);
+      if (num_threads <= 1) ResetPeakRss();
+
+      bool has_stats = options.stats_format != StatsFormat::kNone;
+      int status = IndexFile(job.filename, job_options, has_stats ? &stats : nullptr);
+      queue.Finish(job);
+
+      if (status != 0) {
+        ++failures;
+        queue.Report(GetErrorMessage(status, job.filename));
+      } else if (has_stats) {
+        queue.Report(stats.Format(options.stats_format), std::cerr);
+      }
+    }
+  };
+
+  if (num_threads <= 1) {
+    worker(0);
+  } else {
+    std::vector<std::thread> threads;
+    for (size_t i = 0; i < num_threads; ++i) {
+      threads.emplace_back(worker, static_cast<int>(i));
+    }
+
+    for (size_t i = 0; i < threads.size(); ++i) {
+      threads[i].join();
+    }
+  }
+
+  return failures;
+}
+
+bool AppendSegments(const std::string &manifest_path, const std::vector<std::string> &filenames,
+                    const IndexOptions &options) {
+  Manifest manifest;
+  int status = GetFileSize(manifest_path) < 0 ? 0 : ReadManifest(manifest_path, &manifest);
+
+  if (status != 0) {
+    std::cout << "Corrupted or unsupported manifest " << manifest_path << "." << std::endl;
+    return false;
+  }
+
+  // Segment files written so far, removed if any file fails.
+  std::vector<std::string> segment_paths;
+  bool failed = false;
+
+  for (size_t i = 0; i < filenames.size() && !failed; ++i) {
+    Segment segment;
+    segment.filename = GetSegmentFilename(manifest_path, manifest.next_id);
+    segment_paths.push_back(GetSegmentPath(manifest_path, segment.filename));
+
+    Stats stats("index", filenames[i]);
+    ResetPeakRss();
+
+    bool has_stats = options.stats_format != StatsFormat::kNone;
+    int64_t line_feeds = CountFileLineFeeds(filenames[i]);
+    status = line_feeds < 0 ? -1 : IndexFile(filenames[i], segment_paths.back(), options,
+                                             has_stats ? &stats : nullptr);
+
+    if (status != 0) {
+      std::cout << GetErrorMessage(status, filenames[i]) << std::endl;
+      failed = true;
+      continue;
+    } else if (has_stats) {
+      std::cerr << stats.Format(options.stats_format) << std::endl;
+    }
+
+    segment.size = GetFileSize(filenames[i]);
+    segment.line_feeds = line_feeds;
+    manifest.segments.push_back(segment);
+    ++manifest.next_id;
+  }
+
+  if (!failed && !WriteManifest(manifest_path, manifest)) {
+    std::cout << "Cannot write manifest " << manifest_path << "." << std::endl;
+    failed = true;
+  }
+
+  if (failed) {
+    for (size_t i = 0; i < segment_paths.size(); ++i) {
+      std::remove(segment_paths[i].c_str());
+    }
+  }
+
+  return !failed;
+}
+
+// The merged text is decoded from the segments into memory, then indexed as a new segment. The old
+// segment files are removed only once the new manifest replaced the old one, so readers which
+// loaded the old manifest keep a consistent set of segments.
+bool CompactSegments(const std::string &manifest_path, const IndexOptions &options, bool full) {
+  SegmentedIndex index;
+  int status = index.Open(manifest_path);
+
+  if (status == -1) {
+    std::cout << "Cannot open manifest " << manifest_path << " or its segments." << std::endl;
+    return false;
+  } else if (status != 0) {
+    std::cout << "Corrupted or unsupported manifest " << manifest_path << "." << std::endl;
+    return false;
+  }
+
+  const Manifest &old_manifest = index.manifest();
+  Manifest manifest;
+  manifest.next_id = old_manifest.next_id;
+
+  std::vector<SegmentRun> runs = PlanCompaction(old_manifest.segments, full);
+  std::vector<std::string> old_paths, new_paths;
+  bool failed = false;
+
+  for (size_t i = 0; i < runs.size() && !failed; ++i) {
+    const SegmentRun &run = runs[i];
+
+    if (run.last - run.first == 1 && run.size > 0) {
+      manifest.segments.push_back(old_manifest.segments[run.first]);
+      continue;
+    }
+
+    // Empty runs are dropped.
+    Segment segment = {GetSegmentFilename(manifest_path, manifest.next_id), run.size, 0};
+
+    for (size_t j = run.first; j < run.last; ++j) {
+      segment.line_feeds += old_manifest.segments[j].line_feeds;
+      old_paths.push_back(GetSegmentPath(manifest_path, old_manifest.segments[j].filename));
+    }
+
+    if (run.size == 0) continue;
+
+    new_paths.push_back(GetSegmentPath(manifest_path, segment.filename));
+
+    Stats stats("compact", new_paths.back());
+    ResetPeakRss();
+
+    bool has_stats = options.stats_format != StatsFormat::kNone;
+    if (has_stats) stats.BeginPhase("read");
+
+    try {
+      std::string text = index.Extract(index.segment_start(run.first), run.size);
+      status = IndexText(text, new_paths.back(), options, has_stats ? &stats : nullptr);
+    } catch (const std::bad_alloc&) {
+      status = -3;
+    }
+
+    if (status != 0) {
+      std::cout << GetErrorMessage(status, manifest_path) << std::endl;
+      failed = true;
+      continue;
+    } else if (has_stats) {
+      std::cerr << stats.Format(options.stats_format) << std::endl;
+    }
+
+    manifest.segments.push_back(segment);
+    ++manifest.next_id;
+  }
+
+  if (!failed && !WriteManifest(manifest_path, manifest)) {
+    std::cout << "Cannot write manifest " << manifest_path << "." << std::endl;
+    failed = true;
+  }
+
+  std::vector<std::string> &unused_paths = failed ? new_paths : old_paths;
+  for (size_t i = 0; i < unused_paths.size(); ++i) {
+    std::remove(unused_paths[i].c_str());
+  }
+
+  return !failed;
+}
+
+}  // namespace ipmt
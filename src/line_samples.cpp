@@ -0,0 +1,52 @@
+#include "line_samples.h"
+
+#include <algorithm>
+#include <cstring>
+#include <vector>
+
+namespace ipmt {
+
+PackedArray SampleLineStarts(const std::string &text) {
+  return SampleLineStarts(text.data(), text.size());
+}
+
+// The text is scanned a chunk at a time, so pages may be released in between.
+PackedArray SampleLineStarts(const char *data, size_t length, PageReleaser *releaser) {
+  const size_t kChunkSize = 1 << 20;
+  std::vector<size_t> samples(1, 0);
+  size_t line = 0;
+
+  for (size_t begin = 0; begin < length; begin += kChunkSize) {
+    const char *end = data + std::min(length, begin + kChunkSize);
+
+    for (const char *lf = data + begin;
+         (lf = static_cast<const char*>(std::memchr(lf, '\n', end - lf))); ++lf) {
+      if (++line % kLineSampleRate == 0) {
+        samples.push_back(lf + 1 - data);
+      }
+    }
+
+    if (releaser) releaser->Advance(end - data - begin);
+  }
+
+  return PackArray(samples);
+}
+
+size_t CountLineSamples(const PackedArray &line_samples, size_t pos) {
+  size_t left = 0;
+  size_t right = line_samples.size();
+
+  while (left < right) {
+    size_t mid = left + (right - left) / 2;
+
+    if (line_samples[mid] <= pos) {
+      left = mid + 1;
+    } else {
+      right = mid;
+    }
+  }
+
+  return left;
+}
+
+}  // namespace ipmt
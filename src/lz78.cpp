@@ -1,47 +1,172 @@
 #include "lz78.h"
 
-#include <unordered_map>
+#include <algorithm>
+#include <cstdint>
+#include <vector>
 
 namespace ipmt {
+namespace {
 
-std::string LZ78Decode(const std::vector<std::pair<int, char>> &code) {
-  std::string text;
-  std::unordered_map<int, std::string> dict;
-  int d = 1;
+// Dictionary of the LZ78 encoder. Each phrase is stored as its longest proper prefix (the parent
+// phrase) and its last character, so a phrase is extended by a single lookup, without building it.
+// Phrase 0 is the empty phrase, which is never stored.
+class PhraseTable {
+ public:
+  PhraseTable() : slots_(kInitialCapacity, kEmptySlot), size_(0) {}
 
-  dict[0] = "";
+  // Returns the phrase extending parent by c, or 0 if there is none.
+  int Find(int parent, unsigned char c) const {
+    uint64_t key = Key(parent, c);
+
+    for (size_t i = SlotIndex(key); ; i = (i + 1) & (slots_.size() - 1)) {
+      if (slots_[i].key == key) return slots_[i].phrase;
+      if (slots_[i].key == kEmptyKey) return 0;
+    }
+  }
+
+  void Insert(int parent, unsigned char c, int phrase) {
+    if (2 * (size_ + 1) > slots_.size()) {
+      Grow();
+    }
+
+    Place(Key(parent, c), phrase);
+    ++size_;
+  }
+
+  void Clear() {
+    std::fill(slots_.begin(), slots_.end(), kEmptySlot);
+    size_ = 0;
+  }
+
+ private:
+  struct Slot {
+    uint64_t key;
+    int phrase;
+  };
+
+  static const size_t kInitialCapacity = 1 << 12;
+  static const uint64_t kEmptyKey = ~static_cast<uint64_t>(0);
+  static const Slot kEmptySlot;
+
+  static uint64_t Key(int parent, unsigned char c) {
+    return static_cast<uint64_t>(parent) << 8 | c;
+  }
+
+  // Fibonacci hashing; the table size is a power of two.
+  size_t SlotIndex(uint64_t key) const {
+    return (key * 0x9E3779B97F4A7C15ULL) >> (64 - __builtin_ctzll(slots_.size()));
+  }
+
+  void Place(uint64_t key, int phrase) {
+    size_t i = SlotIndex(key);
+    while (slots_[i].key != kEmptyKey) {
+      i = (i + 1) & (slots_.size() - 1);
+    }
+
+    slots_[i].key = key;
+    slots_[i].phrase = phrase;
+  }
+
+  void Grow() {
+    std::vector<Slot> slots(2 * slots_.size(), kEmptySlot);
+    slots_.swap(slots);
+
+    for (size_t i = 0; i < slots.size(); ++i) {
+      if (slots[i].key != kEmptyKey) Place(slots[i].key, slots[i].phrase);
+    }
+  }
+
+  std::vector<Slot> slots_;
+  size_t size_;
+};
+
+const PhraseTable::Slot PhraseTable::kEmptySlot = {PhraseTable::kEmptyKey, 0};
+
+}  // namespace
+
+// Decodes the output of LZ78Encode, given the options it was encoded with. Each phrase is kept as
+// the position and length of its first occurrence in the text, from where it is copied whenever a
+// later pair extends it. If the text length is known, the text is allocated once up front.
+std::string LZ78Decode(const std::vector<std::pair<int, char>> &code, const LZ78Options &options,
+                       size_t text_length) {
+  // Phrase 0, the empty phrase, is the first entry.
+  struct Phrase {
+    size_t offset;
+    size_t length;
+  };
+
+  std::vector<Phrase> dict(1, Phrase{0, 0});
+  dict.reserve(options.max_phrases > 0 ? options.max_phrases + 1 : code.size() + 1);
+
+  std::string text(text_length != std::string::npos ? text_length : 0, '\0');
+  size_t position = 0;
 
   for (size_t j = 0; j < code.size(); ++j) {
-    int dict_index = code[j].first;
-    char decoded_char = code[j].second;
+    size_t dict_index = static_cast<size_t>(code[j].first);
+    Phrase parent = dict_index < dict.size() ? dict[dict_index] : dict[0];
+    Phrase phrase = {position, parent.length + 1};
+
+    if (position + phrase.length > text.size()) {  // Unknown (or wrong) text length.
+      text.resize(std::max(2 * text.size(), position + phrase.length));
+    }
+
+    std::copy(text.begin() + parent.offset, text.begin() + parent.offset + parent.length,
+              text.begin() + position);
+    text[position + parent.length] = code[j].second;
+    position += phrase.length;
 
-    std::string next_entry = dict[dict_index] + decoded_char;
-    dict[d++] = next_entry;
-    text += next_entry;
+    // Same dictionary updates as the encoder.
+    if (options.max_phrases == 0 || dict.size() <= options.max_phrases) {
+      dict.push_back(phrase);
+    } else if (options.policy == DictionaryPolicy::kReset) {
+      dict.resize(1);
+    }
   }
 
+  text.resize(position);
   return text;
 }
 
-void LZ78Encode(const std::string &text, std::vector<std::pair<int, char>> *code) {
-  std::unordered_map<std::string, int> dict;
-  int d = 1;
-  std::string dict_entry;
-  
-  dict[""] = 0;
+// Encodes the text as pairs of (phrase, character). Each pair stands for a phrase seen before,
+// extended by one character, which becomes a new phrase while the dictionary is not full. A phrase
+// left pending at the end of the text is written as its parent phrase and its last character.
+void LZ78Encode(const std::string &text, std::vector<std::pair<int, char>> *code,
+                const LZ78Options &options) {
+  LZ78Encode(text.data(), text.size(), code, options);
+}
+
+void LZ78Encode(const char *text, size_t length, std::vector<std::pair<int, char>> *code,
+                const LZ78Options &options) {
+  PhraseTable dict;
+  size_t d = 1;
+  int phrase = 0;
+  int parent = 0;
+
+  for (size_t i = 0; i < length; ++i) {
+    unsigned char c = static_cast<unsigned char>(text[i]);
+    int next = dict.Find(phrase, c);
+
+    if (next != 0) {
+      parent = phrase;
+      phrase = next;
+      continue;
+    }
 
-  for (size_t i = 0; i < text.size(); ++i) {
-    auto it = dict.find(dict_entry + text[i]);
+    code->push_back(std::make_pair(phrase, text[i]));
 
-    if (it != dict.end()) {
-      dict_entry += text[i];
-    } else {
-      code->push_back(std::make_pair(dict[dict_entry], text[i]));
-      dict[dict_entry + text[i]] = d++;
-      dict_entry.clear();
+    if (options.max_phrases == 0 || d <= options.max_phrases) {
+      dict.Insert(phrase, c, static_cast<int>(d++));
+    } else if (options.policy == DictionaryPolicy::kReset) {
+      dict.Clear();
+      d = 1;
     }
+
+    phrase = 0;
+  }
+
+  if (phrase != 0) {
+    code->push_back(std::make_pair(parent, text[length - 1]));
   }
 }
 
 }  // namespace ipmt
-
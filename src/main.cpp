@@ -1,15 +1,34 @@
+#include <cstdlib>
 #include <fstream>
 #include <iostream>
 #include <string>
 #include <vector>
 #include <utility>
 
+#include <algorithm>
 #include <getopt.h>
+#include <unistd.h>
 
+#include "approximate_search.h"
+#include "batch_search.h"
+#include "buffered_writer.h"
 #include "compression_type.h"
+#include "dictionary_policy.h"
+#include "index_file.h"
 #include "index_type.h"
-#include "huffman.h"
+#include "indexer.h"
 #include "lz78.h"
+#include "manifest.h"
+#include "match_distance.h"
+#include "occurrence_printer.h"
+#include "occurrence_range.h"
+#include "parallel.h"
+#include "regex_search.h"
+#include "segmented_index.h"
+#include "server.h"
+#include "stats.h"
+#include "stats_format.h"
+#include "suffix_array_algorithm.h"
 #include "sufarray.h"
 #include "utils.h"
 
@@ -25,27 +44,80 @@ int main(int argc, char *argv[]) {
   if (!mode.compare("index")) {
     // ## Processing index mode options.
     ipmt::Option long_options[] = {
+      {"algorithm", required_argument, nullptr, 'a'},
+      {"append", required_argument, nullptr, 'A'},
+      {"blocksize", required_argument, nullptr, 'b'},
       {"compression", required_argument, nullptr, 'c'},
+      {"compact", optional_argument, nullptr, 'C'},
+      {"dictsize", required_argument, nullptr, 'd'},
       {"help", no_argument, nullptr, 'h'},
-      {"indextype", required_argument, nullptr, 'i'}
+      {"indextype", required_argument, nullptr, 'i'},
+      {"jobs", required_argument, nullptr, 'j'},
+      {"memory", required_argument, nullptr, 'm'},
+      {"dictpolicy", required_argument, nullptr, 'r'},
+      {"stats", optional_argument, nullptr, 's'},
+      {"threads", required_argument, nullptr, 't'},
+      {"tmpdir", required_argument, nullptr, 'T'},
+      {nullptr, 0, nullptr, 0}
     };
 
     int option_index = 0;
-    int c = getopt_long(argc, argv, "c:hi:", long_options, &option_index);
-
-    ipmt::CompressionType compression_type = ipmt::CompressionType::kHuffman;
-    ipmt::IndexType index_type = ipmt::IndexType::kSuffixArray;
+    int c = getopt_long(argc, argv, "a:A:b:c:C::d:hi:j:m:r:s::t:T:", long_options, &option_index);
+
+    ipmt::IndexOptions options;
+    options.num_threads = ipmt::HardwareThreads();
+    int num_jobs = 1;
+    // By default, indexing may use half of the physical memory.
+    uint64_t memory_budget = static_cast<uint64_t>(sysconf(_SC_PHYS_PAGES)) *
+                             sysconf(_SC_PAGE_SIZE) / 2;
+    // Segmented indexes: the manifest text files are appended to, and whether (and how) to compact.
+    std::string manifest_path;
+    bool compact = false;
+    bool compact_full = false;
     std::string option_arg;
+    char *end;
     
     while (c != -1) {
       switch (c){
+        case 'a':
+          option_arg = optarg;
+
+          if (!option_arg.compare("sais")) {
+            options.algorithm = ipmt::SuffixArrayAlgorithm::kSAIS;
+          } else if (!option_arg.compare("mm")) {
+            options.algorithm = ipmt::SuffixArrayAlgorithm::kManberMyers;
+          } else if (!option_arg.compare("pd")) {
+            options.algorithm = ipmt::SuffixArrayAlgorithm::kParallelDoubling;
+          } else if (!option_arg.compare("ext")) {
+            options.algorithm = ipmt::SuffixArrayAlgorithm::kExternal;
+          } else {
+            std::cout << "Unimplemented or invalid suffix array algorithm." << std::endl;
+            return EXIT_FAILURE;
+          }
+
+          break;
+
+        case 'A':
+          manifest_path = optarg;
+          break;
+
+        case 'b':
+          options.block_size = std::strtoull(optarg, &end, 10) << 10;
+
+          if (*optarg == '\0' || *optarg == '-' || *end != '\0') {
+            std::cout << "Invalid block size." << std::endl;
+            return EXIT_FAILURE;
+          }
+
+          break;
+
         case 'c':
           option_arg = optarg;
 
           if (!option_arg.compare("huffman")) {
-            compression_type = ipmt::CompressionType::kHuffman;
+            options.compression_type = ipmt::CompressionType::kHuffman;
           } else if (!option_arg.compare("lz78")) {
-            compression_type = ipmt::CompressionType::kLZ78;
+            options.compression_type = ipmt::CompressionType::kLZ78;
           } else {
             std::cout << "Unimplemented or invalid compression algorithm." << std::endl;
             return EXIT_FAILURE;
@@ -53,6 +125,29 @@ int main(int argc, char *argv[]) {
 
           break;
 
+        case 'C':
+          option_arg = optarg ? optarg : "tiered";
+          compact = true;
+
+          if (!option_arg.compare("full")) {
+            compact_full = true;
+          } else if (option_arg.compare("tiered")) {
+            std::cout << "Invalid compaction policy." << std::endl;
+            return EXIT_FAILURE;
+          }
+
+          break;
+
+        case 'd':
+          options.lz78_options.max_phrases = std::strtoull(optarg, &end, 10);
+
+          if (*optarg == '\0' || *optarg == '-' || *end != '\0') {
+            std::cout << "Invalid dictionary size." << std::endl;
+            return EXIT_FAILURE;
+          }
+
+          break;
+
         case 'h':
           ipmt::PrintIndexModeHelp();
           return 0;
@@ -61,7 +156,9 @@ int main(int argc, char *argv[]) {
           option_arg = optarg;
 
           if (!option_arg.compare("sa")) {
-            index_type = ipmt::IndexType::kSuffixArray;
+            options.index_type = ipmt::IndexType::kSuffixArray;
+          } else if (!option_arg.compare("fm")) {
+            options.index_type = ipmt::IndexType::kFMIndex;
           } else {
             std::cout << "Unimplemented or invalid index structure." << std::endl;
             return EXIT_FAILURE;
@@ -69,56 +166,153 @@ int main(int argc, char *argv[]) {
 
           break;
 
+        case 'j':
+          num_jobs = std::strtol(optarg, &end, 10);
+
+          if (*end != '\0' || num_jobs < 1) {
+            std::cout << "Invalid number of jobs." << std::endl;
+            return EXIT_FAILURE;
+          }
+
+          break;
+
+        case 'm':
+          memory_budget = std::strtoull(optarg, &end, 10) << 20;
+
+          if (*optarg == '\0' || *optarg == '-' || *end != '\0') {
+            std::cout << "Invalid memory budget." << std::endl;
+            return EXIT_FAILURE;
+          }
+
+          break;
+
+        case 'r':
+          option_arg = optarg;
+
+          if (!option_arg.compare("reset")) {
+            options.lz78_options.policy = ipmt::DictionaryPolicy::kReset;
+          } else if (!option_arg.compare("freeze")) {
+            options.lz78_options.policy = ipmt::DictionaryPolicy::kFreeze;
+          } else {
+            std::cout << "Unimplemented or invalid dictionary policy." << std::endl;
+            return EXIT_FAILURE;
+          }
+
+          break;
+
+        case 's':
+          option_arg = optarg ? optarg : "text";
+
+          if (!option_arg.compare("text")) {
+            options.stats_format = ipmt::StatsFormat::kText;
+          } else if (!option_arg.compare("json")) {
+            options.stats_format = ipmt::StatsFormat::kJson;
+          } else {
+            std::cout << "Invalid statistics format." << std::endl;
+            return EXIT_FAILURE;
+          }
+
+          break;
+
+        case 't':
+          options.num_threads = std::strtol(optarg, &end, 10);
+
+          if (*end != '\0' || options.num_threads < 1) {
+            std::cout << "Invalid number of threads." << std::endl;
+            return EXIT_FAILURE;
+          }
+
+          break;
+
+        case 'T':
+          options.scratch_dir = optarg;
+          break;
+
         default:
           std::cout << "Invalid option argument." << std::endl;
           return EXIT_FAILURE;
       }
 
-      c = getopt_long(argc, argv, "c:hi:", long_options, &option_index);
+      c = getopt_long(argc, argv, "a:A:b:c:C::d:hi:j:m:r:s::t:T:", long_options, &option_index);
     }
 
-    if (optind >= argc) {
+    // Text files may be left out only when compacting the manifest appended to.
+    if (optind >= argc && (manifest_path.empty() || !compact)) {
       std::cout << "Incorrect number of arguments (type ipmt --help for more details)."
                 << std::endl;
       return EXIT_FAILURE;
     }
 
+    // The external algorithm splits the memory budget among the files indexed at the same time.
+    options.memory_limit = memory_budget / num_jobs;
+
     // ## For each text file, build its respective index file.
+    std::vector<std::string> filenames;
+    bool failed = false;
+
     for (int i = optind; i < argc; ++i) {
-      std::vector<std::string> filenames = ipmt::GetFilenames(argv[i]);
-      
-      for (size_t j = 0; j < filenames.size(); ++j) {
-        std::ifstream ifs(filenames[j], std::ifstream::ate | std::ifstream::binary);
-        if (!ifs) {
-          std::cout << "Cannot open file(s) from argument list." << std::endl;
-          return EXIT_FAILURE;
-        }
-         
-        size_t file_size = ifs.tellg();
-        ifs.seekg(0, ifs.beg);
-        
-        std::vector<char> text(file_size);
-        ifs.read(&text[0], text.size());
-
-        // Build index and write index file. Since we only have suffix arrays right now, we will
-        // not perform any type checking for the IndexType value.
-        std::vector<int> suffix_array = ipmt::BuildSuffixArray(text.data());
-        ipmt::WriteIndexFile(filenames[j], suffix_array, text.data(), compression_type);
+      std::vector<std::string> matches = ipmt::GetFilenames(argv[i]);
+      filenames.insert(filenames.end(), matches.begin(), matches.end());
+
+      if (matches.empty()) {
+        std::cout << "Cannot open file " << argv[i] << "." << std::endl;
+        failed = true;
       }
     }
+
+    // Text files are appended to the manifest as new segments, one per file, and only if all of
+    // them exist. Without a manifest to append to, compaction takes the manifests as arguments
+    // instead of text files.
+    if (!manifest_path.empty()) {
+      failed = failed ||
+               (!filenames.empty() && !ipmt::AppendSegments(manifest_path, filenames, options)) ||
+               (compact && !ipmt::CompactSegments(manifest_path, options, compact_full));
+    } else if (compact) {
+      for (size_t i = 0; i < filenames.size(); ++i) {
+        failed |= !ipmt::CompactSegments(filenames[i], options, compact_full);
+      }
+    } else {
+      failed |= ipmt::IndexFiles(filenames, options, num_jobs, memory_budget) > 0;
+    }
+
+    if (failed) {
+      return EXIT_FAILURE;
+    }
   } else if (!mode.compare("search")){
     // ## Processing search mode options.
     ipmt::Option long_options[] = {
       {"count", no_argument, nullptr, 'c'},      
+      {"edits", required_argument, nullptr, 'e'},
+      {"regex", no_argument, nullptr, 'E'},
+      {"first", no_argument, nullptr, 'f'},
       {"help", no_argument, nullptr, 'h'},
-      {"pattern", no_argument, nullptr, 'p'}
+      {"mismatches", required_argument, nullptr, 'k'},
+      {"limit", required_argument, nullptr, 'l'},
+      {"line-number", no_argument, nullptr, 'n'},
+      {"pattern", no_argument, nullptr, 'p'},
+      {"stats", optional_argument, nullptr, 's'},
+      {"threads", required_argument, nullptr, 't'},
+      {nullptr, 0, nullptr, 0}
     };
 
     int option_index = 0;
-    int c = getopt_long(argc, argv, "chp", long_options, &option_index);
+    int c = getopt_long(argc, argv, "ce:Efhk:l:nps::t:", long_options, &option_index);
 
     bool print_num_occ_only = false;
+    bool print_line_numbers = false;
     bool read_pattern_files = false;
+    int num_threads = ipmt::HardwareThreads();
+    ipmt::StatsFormat stats_format = ipmt::StatsFormat::kNone;
+    // Approximate search: occurrences may have up to max_errors mismatches (or edits).
+    bool is_approximate = false;
+    size_t max_errors = 0;
+    ipmt::MatchDistance distance = ipmt::MatchDistance::kHamming;
+    bool is_regex = false;
+    // Occurrences of each pattern counted or printed, the first ones in the text. They are cut
+    // from all the occurrences located, so the search itself does not stop early.
+    size_t limit = ipmt::kNoLimit;
+    std::string option_arg;
+    char *end;
     
     while (c != -1) {
       switch (c){
@@ -126,20 +320,84 @@ int main(int argc, char *argv[]) {
           print_num_occ_only = true;
           break;
 
+        case 'e':
+        case 'k':
+          is_approximate = true;
+          distance = c == 'e' ? ipmt::MatchDistance::kEdit : ipmt::MatchDistance::kHamming;
+          max_errors = std::strtoull(optarg, &end, 10);
+
+          if (*optarg == '\0' || *optarg == '-' || *end != '\0') {
+            std::cout << "Invalid number of errors." << std::endl;
+            return EXIT_FAILURE;
+          }
+
+          break;
+
+        case 'E':
+          is_regex = true;
+          break;
+
+        case 'f':
+          limit = 1;
+          break;
+
         case 'h':
           ipmt::PrintSearchModeHelp();
           return 0;
 
+        case 'l':
+          limit = std::strtoull(optarg, &end, 10);
+
+          if (*optarg == '\0' || *optarg == '-' || *end != '\0' || limit == 0) {
+            std::cout << "Invalid limit of occurrences." << std::endl;
+            return EXIT_FAILURE;
+          }
+
+          break;
+
+        case 'n':
+          print_line_numbers = true;
+          break;
+
         case 'p':
           read_pattern_files = true;
           break;
 
+        case 's':
+          option_arg = optarg ? optarg : "text";
+
+          if (!option_arg.compare("text")) {
+            stats_format = ipmt::StatsFormat::kText;
+          } else if (!option_arg.compare("json")) {
+            stats_format = ipmt::StatsFormat::kJson;
+          } else {
+            std::cout << "Invalid statistics format." << std::endl;
+            return EXIT_FAILURE;
+          }
+
+          break;
+
+        case 't':
+          num_threads = std::strtol(optarg, &end, 10);
+
+          if (*end != '\0' || num_threads < 1) {
+            std::cout << "Invalid number of threads." << std::endl;
+            return EXIT_FAILURE;
+          }
+
+          break;
+
         default:
           std::cout << "Invalid option argument." << std::endl;
           return EXIT_FAILURE;
       }
 
-      c = getopt_long(argc, argv, "chp", long_options, &option_index);
+      c = getopt_long(argc, argv, "ce:Efhk:l:nps::t:", long_options, &option_index);
+    }
+
+    if (is_regex && is_approximate) {
+      std::cout << "Regular expressions cannot be searched approximately." << std::endl;
+      return EXIT_FAILURE;
     }
 
     if (optind >= argc + 1) {
@@ -169,16 +427,36 @@ int main(int argc, char *argv[]) {
       patterns.push_back(argv[optind++]);
     }
 
-    // ## For each index file, decode text and find patterns occurrences.
+    // Pigeonhole seeding splits each pattern into max_errors + 1 nonempty pieces.
+    for (size_t k = 0; k < patterns.size() && is_approximate; ++k) {
+      if (patterns[k].size() <= max_errors) {
+        std::cout << "Patterns must be longer than the number of errors." << std::endl;
+        return EXIT_FAILURE;
+      }
+    }
+
+    // ## For each index file, decode text and find patterns occurrences. Lines are printed to a
+    // buffered writer, flushed after each index file.
+    ipmt::BufferedWriter writer(std::cout);
     bool has_multiple_index_files = (argc - optind) > 1;
     for (int i = optind; i < argc; ++i) {
       std::vector<std::string> index_files = ipmt::GetFilenames(argv[i]);
       has_multiple_index_files |= index_files.size() > 1;
 
       for (size_t j = 0; j < index_files.size(); ++j) {
-        std::vector<int> suffix_array;
-        std::string text;
-        int status = ipmt::ReadIndexFile(index_files[j], &text, &suffix_array);
+        // Manifests of segmented indexes are told apart from index files by their first line.
+        ipmt::Index index;
+        ipmt::SegmentedIndex segmented_index;
+        bool is_segmented = ipmt::IsManifestFile(index_files[j]);
+        ipmt::Stats stats("search", index_files[j]);
+        ipmt::Stats *file_stats = stats_format != ipmt::StatsFormat::kNone ? &stats : nullptr;
+        size_t bytes_written = writer.bytes_written();
+
+        ipmt::ResetPeakRss();
+        segmented_index.set_num_threads(num_threads);
+        int status = is_segmented ? segmented_index.Open(index_files[j], file_stats) :
+                                    ipmt::ReadIndexFile(index_files[j], &index, file_stats,
+                                                        num_threads);
 
         if (status == -1) {
           std::cout << "Cannot open index file " << index_files[j] << "." << std::endl;
@@ -186,27 +464,231 @@ int main(int argc, char *argv[]) {
         } else if (status == -2) {
           std::cout << "Invalid compression type on index file." << std::endl;
           return EXIT_FAILURE;
+        } else if (status == -3) {
+          std::cout << "Corrupted or unsupported index file " << index_files[j] << "."
+                    << std::endl;
+          return EXIT_FAILURE;
         } else {  // status == 0.
-          std::vector<int> occurrences;
+          ipmt::OccurrencePrinter printer(&writer, index.line_samples, print_line_numbers);
+          std::vector<size_t> occurrences;
           size_t total = 0;
 
-          for (size_t k = 0; k < patterns.size(); ++k) {
-            occurrences = ipmt::GetOccurrences(patterns[k], text, suffix_array);
-            if (!print_num_occ_only) {
-              std::cout << ipmt::PrintOccurrences(occurrences, text, patterns[k].size());
+          if (is_regex) {
+            // Matches have lengths of their own, and are found even when only counted.
+            for (size_t k = 0; k < patterns.size(); ++k) {
+              if (file_stats) file_stats->BeginPhase("search");
+
+              ipmt::RegexMatches matches;
+              bool is_valid = is_segmented ?
+                  ipmt::FindRegexMatches(patterns[k], segmented_index, &matches, num_threads) :
+                  ipmt::FindRegexMatches(patterns[k], index, &matches, num_threads);
+
+              if (!is_valid) {
+                std::cout << "Invalid regular expression." << std::endl;
+                return EXIT_FAILURE;
+              }
+
+              if (matches.positions.size() > limit) {
+                matches.positions.resize(limit);
+                matches.lengths.resize(limit);
+              }
+
+              total += matches.positions.size();
+              if (print_num_occ_only) continue;
+
+              if (file_stats) file_stats->BeginPhase("print");
+
+              if (is_segmented) {
+                printer.Print(matches.positions, matches.lengths, segmented_index);
+              } else if (index.index_type == ipmt::IndexType::kFMIndex) {
+                printer.Print(matches.positions, matches.lengths, index.fm_index);
+              } else if (!index.block_text.empty()) {
+                printer.Print(matches.positions, matches.lengths, index.block_text);
+              } else {
+                printer.Print(matches.positions, matches.lengths, index.text);
+              }
             }
+          } else if (is_approximate) {
+            // Approximate occurrences are located even when only counted, since each candidate is
+            // verified on the text.
+            for (size_t k = 0; k < patterns.size(); ++k) {
+              if (file_stats) file_stats->BeginPhase("search");
+
+              occurrences = is_segmented ?
+                  ipmt::LocateApproximate(patterns[k], max_errors, distance, segmented_index,
+                                          num_threads) :
+                  ipmt::LocateApproximate(patterns[k], max_errors, distance, index, num_threads);
+              if (occurrences.size() > limit) occurrences.resize(limit);
+
+              total += occurrences.size();
+              if (print_num_occ_only) continue;
+
+              if (file_stats) file_stats->BeginPhase("print");
+
+              if (is_segmented) {
+                printer.Print(occurrences, segmented_index, patterns[k].size());
+              } else if (index.index_type == ipmt::IndexType::kFMIndex) {
+                printer.Print(occurrences, index.fm_index, patterns[k].size());
+              } else if (!index.block_text.empty()) {
+                printer.Print(occurrences, index.block_text, patterns[k].size());
+              } else {
+                printer.Print(occurrences, index.text, patterns[k].size());
+              }
+            }
+          } else if (is_segmented) {
+            // Each pattern is searched on all segments at once.
+            for (size_t k = 0; k < patterns.size(); ++k) {
+              if (file_stats) file_stats->BeginPhase("search");
+
+              if (print_num_occ_only) {
+                total += std::min(segmented_index.Count(patterns[k]), limit);
+                continue;
+              }
 
-            total += occurrences.size();
+              occurrences = segmented_index.Locate(patterns[k], limit);
+
+              if (file_stats) file_stats->BeginPhase("print");
+              printer.Print(occurrences, segmented_index, patterns[k].size());
+            }
+          } else if (index.index_type == ipmt::IndexType::kFMIndex) {
+            for (size_t k = 0; k < patterns.size(); ++k) {
+              if (file_stats) file_stats->BeginPhase("search");
+
+              // Counting needs only the backward search; nothing is decoded.
+              if (print_num_occ_only) {
+                total += std::min(index.fm_index.Count(patterns[k]), limit);
+                continue;
+              }
+
+              occurrences = index.fm_index.Locate(patterns[k], limit);
+
+              if (file_stats) file_stats->BeginPhase("print");
+              printer.Print(occurrences, index.fm_index, patterns[k].size());
+            }
+          } else {
+            // All patterns are searched at once; occurrences are read from the suffix array only to
+            // be printed, and only up to the limit. Text stored in blocks is decoded only where the
+            // search and the printed lines need it.
+            bool has_blocks = !index.block_text.empty();
+            if (file_stats) file_stats->BeginPhase("search");
+
+            std::vector<ipmt::SuffixArrayInterval> intervals = has_blocks ?
+                ipmt::SearchPatterns(patterns, index.block_text, index.suffix_array,
+                                     index.search_lcp, num_threads) :
+                ipmt::SearchPatterns(patterns, index.text, index.suffix_array, index.search_lcp,
+                                     num_threads);
+
+            for (size_t k = 0; k < patterns.size(); ++k) {
+              total += std::min(intervals[k].size(), limit);
+              if (print_num_occ_only) continue;
+
+              occurrences = ipmt::OccurrenceRange(index.suffix_array, intervals[k].left,
+                                                  intervals[k].right).Sorted(limit);
+              if (file_stats) file_stats->BeginPhase("print");
+
+              if (has_blocks) {
+                printer.Print(occurrences, index.block_text, patterns[k].size());
+              } else {
+                printer.Print(occurrences, index.text, patterns[k].size());
+              }
+
+              if (file_stats) file_stats->BeginPhase("search");
+            }
           }
 
+          if (file_stats) file_stats->BeginPhase("print");
+          writer.Flush();
+
           if (print_num_occ_only && has_multiple_index_files) {
             std::cout << index_files[j] << ":" << total << std::endl;
           } else if (print_num_occ_only) {
             std::cout << total << std::endl;
           }
+
+          // Statistics go to the standard error, so they never mix with the occurrences.
+          if (file_stats) {
+            file_stats->AddBytesWritten(writer.bytes_written() - bytes_written);
+            std::cerr << file_stats->Format(stats_format) << std::endl;
+          }
         }
       }
     }
+  } else if (!mode.compare("serve")) {
+    // ## Processing serve mode options.
+    ipmt::Option long_options[] = {
+      {"help", no_argument, nullptr, 'h'},
+      {"line-number", no_argument, nullptr, 'n'},
+      {"socket", required_argument, nullptr, 's'},
+      {nullptr, 0, nullptr, 0}
+    };
+
+    int option_index = 0;
+    int c = getopt_long(argc, argv, "hns:", long_options, &option_index);
+
+    std::string socket_path;
+    bool print_line_numbers = false;
+
+    while (c != -1) {
+      switch (c) {
+        case 'h':
+          ipmt::PrintServeModeHelp();
+          return 0;
+
+        case 'n':
+          print_line_numbers = true;
+          break;
+
+        case 's':
+          socket_path = optarg;
+          break;
+
+        default:
+          std::cout << "Invalid option argument." << std::endl;
+          return EXIT_FAILURE;
+      }
+
+      c = getopt_long(argc, argv, "hns:", long_options, &option_index);
+    }
+
+    if (optind >= argc) {
+      std::cout << "Incorrect number of arguments (type ipmt --help for more details)."
+                << std::endl;
+      return EXIT_FAILURE;
+    }
+
+    // ## Load all index files, then answer requests until the input ends.
+    std::vector<std::string> index_files;
+    for (int i = optind; i < argc; ++i) {
+      std::vector<std::string> matches = ipmt::GetFilenames(argv[i]);
+      index_files.insert(index_files.end(), matches.begin(), matches.end());
+    }
+
+    if (index_files.empty()) {
+      std::cout << "Cannot open index file(s) from argument list." << std::endl;
+      return EXIT_FAILURE;
+    }
+
+    ipmt::SearchServer server;
+    server.set_number_lines(print_line_numbers);
+    int status = server.Load(index_files);
+
+    if (status == -1) {
+      std::cout << "Cannot open index file(s) from argument list." << std::endl;
+      return EXIT_FAILURE;
+    } else if (status == -2) {
+      std::cout << "Invalid compression type on index file." << std::endl;
+      return EXIT_FAILURE;
+    } else if (status == -3) {
+      std::cout << "Corrupted or unsupported index file." << std::endl;
+      return EXIT_FAILURE;
+    }
+
+    if (socket_path.empty()) {
+      server.Serve(std::cin, std::cout);
+    } else if (!server.ServeSocket(socket_path)) {
+      std::cout << "Cannot listen on socket " << socket_path << "." << std::endl;
+      return EXIT_FAILURE;
+    }
   } else if (!mode.compare("-h") || !mode.compare("--help")) {
     ipmt::PrintHelp();
   } else {
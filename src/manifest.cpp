@@ -0,0 +1,108 @@
+#include "manifest.h"
+
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+
+namespace ipmt {
+namespace {
+
+const char kManifestMagic[] = "IPMT-MANIFEST";
+const int kManifestVersion = 1;
+
+// Returns the directory of the path, with its trailing slash, or "" for the current one.
+std::string GetDirectory(const std::string &pathname) {
+  size_t index = pathname.find_last_of("/\\");
+  return index == std::string::npos ? "" : pathname.substr(0, index + 1);
+}
+
+}  // namespace
+
+bool IsManifestFile(const std::string &pathname) {
+  std::ifstream ifs(pathname, std::ifstream::binary);
+  std::string magic(sizeof(kManifestMagic) - 1, '\0');
+
+  return ifs.read(&magic[0], magic.size()) && magic == kManifestMagic;
+}
+
+int ReadManifest(const std::string &manifest_path, Manifest *manifest) {
+  std::ifstream ifs(manifest_path);
+  if (!ifs) {
+    return -1;
+  }
+
+  std::string line, magic;
+  int version;
+
+  if (!std::getline(ifs, line)) {
+    return -3;
+  }
+
+  std::istringstream header(line);
+  if (!(header >> magic >> version >> manifest->next_id) || magic != kManifestMagic ||
+      version != kManifestVersion) {
+    return -3;
+  }
+
+  manifest->segments.clear();
+
+  while (std::getline(ifs, line)) {
+    if (line.empty()) continue;
+
+    // File names may have spaces, so the numbers are taken from the end of the line.
+    size_t size_index = line.find_last_of(' ', line.find_last_of(' ') - 1);
+    if (size_index == std::string::npos || size_index == 0) {
+      return -3;
+    }
+
+    std::istringstream fields(line.substr(size_index));
+    Segment segment;
+    segment.filename = line.substr(0, size_index);
+
+    if (!(fields >> segment.size >> segment.line_feeds) || segment.line_feeds > segment.size) {
+      return -3;
+    }
+
+    manifest->segments.push_back(segment);
+  }
+
+  return 0;
+}
+
+// Written to a temporary file first, which then replaces the manifest, as index files are.
+bool WriteManifest(const std::string &manifest_path, const Manifest &manifest) {
+  std::string temporary_path = manifest_path + ".tmp";
+  std::ofstream writer(temporary_path);
+
+  writer << kManifestMagic << ' ' << kManifestVersion << ' ' << manifest.next_id << '\n';
+  for (size_t i = 0; i < manifest.segments.size(); ++i) {
+    const Segment &segment = manifest.segments[i];
+    writer << segment.filename << ' ' << segment.size << ' ' << segment.line_feeds << '\n';
+  }
+
+  writer.close();
+
+  if (!writer || std::rename(temporary_path.c_str(), manifest_path.c_str()) != 0) {
+    std::remove(temporary_path.c_str());
+    return false;
+  }
+
+  return true;
+}
+
+std::string GetSegmentPath(const std::string &manifest_path, const std::string &filename) {
+  return GetDirectory(manifest_path) + filename;
+}
+
+std::string GetSegmentFilename(const std::string &manifest_path, uint64_t id) {
+  std::string filename = manifest_path.substr(GetDirectory(manifest_path).size());
+  size_t index = filename.find_last_of(".");
+
+  if (index != std::string::npos && index > 0) {
+    filename.resize(index);
+  }
+
+  return filename + "." + std::to_string(id) + ".idx";
+}
+
+}  // namespace ipmt
@@ -0,0 +1,125 @@
+#include "mapped_file.h"
+
+#include <cstdint>
+#include <cstdlib>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace ipmt {
+
+MappedFile::MappedFile(MappedFile &&file) : data_(file.data_), size_(file.size_) {
+  file.data_ = nullptr;
+  file.size_ = 0;
+}
+
+MappedFile& MappedFile::operator=(MappedFile &&file) {
+  if (this != &file) {
+    Close();
+    data_ = file.data_;
+    size_ = file.size_;
+    file.data_ = nullptr;
+    file.size_ = 0;
+  }
+
+  return *this;
+}
+
+bool MappedFile::Open(const std::string &pathname) {
+  Close();
+
+  int fd = open(pathname.c_str(), O_RDONLY);
+  if (fd == -1) {
+    return false;
+  }
+
+  struct stat file_stat;
+  if (fstat(fd, &file_stat) == -1 || file_stat.st_size == 0) {
+    close(fd);
+    return false;
+  }
+
+  void *address = mmap(nullptr, file_stat.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);  // The mapping keeps its own reference to the file.
+
+  if (address == MAP_FAILED) {
+    return false;
+  }
+
+  data_ = static_cast<const char*>(address);
+  size_ = file_stat.st_size;
+
+  return true;
+}
+
+bool MappedFile::CreateTemporary(const std::string &dir, size_t size) {
+  Close();
+
+  int fd = OpenTemporaryFile(dir);
+  if (fd == -1) {
+    return false;
+  }
+
+  if (size == 0 || ftruncate(fd, size) == -1) {
+    close(fd);
+    return false;
+  }
+
+  void *address = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  close(fd);
+
+  if (address == MAP_FAILED) {
+    return false;
+  }
+
+  data_ = static_cast<const char*>(address);
+  size_ = size;
+
+  return true;
+}
+
+void MappedFile::Close() {
+  if (data_) {
+    munmap(const_cast<char*>(data_), size_);
+    data_ = nullptr;
+    size_ = 0;
+  }
+}
+
+void PageReleaser::Add(const void *data, size_t size) {
+  ranges_.push_back(std::make_pair(static_cast<const char*>(data), size));
+}
+
+// Only the pages entirely within each range are dropped, as the rest may belong to something else.
+void PageReleaser::Release() {
+  static const uintptr_t kPageSize = sysconf(_SC_PAGESIZE);
+
+  for (size_t r = 0; r < ranges_.size(); ++r) {
+    uintptr_t begin = reinterpret_cast<uintptr_t>(ranges_[r].first);
+    uintptr_t end = begin + ranges_[r].second;
+    begin = (begin + kPageSize - 1) / kPageSize * kPageSize;
+    end = end / kPageSize * kPageSize;
+
+    if (begin < end) madvise(reinterpret_cast<void*>(begin), end - begin, MADV_DONTNEED);
+  }
+
+  advanced_ = 0;
+}
+
+int OpenTemporaryFile(const std::string &dir) {
+  std::string pathname = (dir.empty() ? "." : dir) + "/ipmt-XXXXXX";
+  std::vector<char> buffer(pathname.begin(), pathname.end());
+  buffer.push_back('\0');
+
+  int fd = mkstemp(buffer.data());
+  if (fd != -1) {
+    unlink(buffer.data());
+  }
+
+  return fd;
+}
+
+}  // namespace ipmt
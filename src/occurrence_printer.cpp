@@ -0,0 +1,181 @@
+#include "occurrence_printer.h"
+
+#include <algorithm>
+#include <cstring>
+
+#include "line_samples.h"
+
+namespace ipmt {
+namespace {
+
+const char kANSIRedColor[] = "\033[31m";
+const char kANSIResetAll[] = "\033[0m";
+
+// Number of characters extracted at a time when counting line feeds of a compressed text.
+const size_t kCountChunk = 1 << 16;
+
+// Line of the text: its first position and its characters, without the line feed.
+struct Line {
+  size_t start;
+  const char *data;
+  size_t length;
+};
+
+// Plain texts are not copied: the line points into the text.
+Line GetLine(const std::string &text, size_t pos, std::string *) {
+  const char *data = text.data();
+  const void *lf = pos > 0 ? memrchr(data, '\n', pos) : nullptr;
+  size_t start = lf ? static_cast<const char*>(lf) - data + 1 : 0;
+
+  lf = pos < text.size() ? std::memchr(data + pos, '\n', text.size() - pos) : nullptr;
+  size_t end = lf ? static_cast<const char*>(lf) - data : text.size();
+
+  Line line = {start, data + start, end - start};
+  return line;
+}
+
+template <typename Text>
+Line GetLine(const Text &text, size_t pos, std::string *storage) {
+  Line line;
+  *storage = text.ExtractLine(pos, &line.start);
+  line.data = storage->data();
+  line.length = storage->size();
+
+  return line;
+}
+
+size_t CountLineFeeds(const std::string &text, size_t begin, size_t end) {
+  return std::count(text.begin() + begin, text.begin() + end, '\n');
+}
+
+template <typename Text>
+size_t CountLineFeeds(const Text &text, size_t begin, size_t end) {
+  size_t count = 0;
+
+  for (size_t pos = begin; pos < end; pos += kCountChunk) {
+    std::string chunk = text.Extract(pos, std::min(kCountChunk, end - pos));
+    count += std::count(chunk.begin(), chunk.end(), '\n');
+  }
+
+  return count;
+}
+
+}  // namespace
+
+void OccurrencePrinter::Print(const std::vector<size_t> &occurrences, const std::string &text,
+                              size_t pattern_length) {
+  PrintLines(occurrences, nullptr, text, pattern_length);
+}
+
+void OccurrencePrinter::Print(const std::vector<size_t> &occurrences, const BlockText &text,
+                              size_t pattern_length) {
+  PrintLines(occurrences, nullptr, text, pattern_length);
+}
+
+void OccurrencePrinter::Print(const std::vector<size_t> &occurrences, const FMIndex &fm_index,
+                              size_t pattern_length) {
+  PrintLines(occurrences, nullptr, fm_index, pattern_length);
+}
+
+void OccurrencePrinter::Print(const std::vector<size_t> &occurrences, const SegmentedIndex &index,
+                              size_t pattern_length) {
+  PrintLines(occurrences, nullptr, index, pattern_length);
+}
+
+void OccurrencePrinter::Print(const std::vector<size_t> &occurrences,
+                              const std::vector<size_t> &lengths, const std::string &text) {
+  PrintLines(occurrences, &lengths, text, 0);
+}
+
+void OccurrencePrinter::Print(const std::vector<size_t> &occurrences,
+                              const std::vector<size_t> &lengths, const BlockText &text) {
+  PrintLines(occurrences, &lengths, text, 0);
+}
+
+void OccurrencePrinter::Print(const std::vector<size_t> &occurrences,
+                              const std::vector<size_t> &lengths, const FMIndex &fm_index) {
+  PrintLines(occurrences, &lengths, fm_index, 0);
+}
+
+void OccurrencePrinter::Print(const std::vector<size_t> &occurrences,
+                              const std::vector<size_t> &lengths, const SegmentedIndex &index) {
+  PrintLines(occurrences, &lengths, index, 0);
+}
+
+template <typename Text>
+bool OccurrencePrinter::FindLineSample(const Text &, size_t pos, size_t *sample_pos,
+                                       size_t *sample_lines) const {
+  size_t samples = CountLineSamples(line_samples_, pos);
+  if (samples == 0) {
+    return false;
+  }
+
+  *sample_pos = line_samples_[samples - 1];
+  *sample_lines = (samples - 1) * kLineSampleRate;
+  return true;
+}
+
+bool OccurrencePrinter::FindLineSample(const SegmentedIndex &index, size_t pos,
+                                       size_t *sample_pos, size_t *sample_lines) const {
+  index.FindLineSample(pos, sample_pos, sample_lines);
+  return true;
+}
+
+// Overlapping occurrences are highlighted as a single one, and highlights stop at the line end.
+template <typename Text>
+void OccurrencePrinter::PrintLines(const std::vector<size_t> &occurrences,
+                                   const std::vector<size_t> *lengths, const Text &text,
+                                   size_t pattern_length) {
+  std::string storage;
+  size_t counted_pos = 0;  // Line feeds before counted_pos were counted already.
+  size_t counted_lines = 0;
+  size_t j = 0;
+
+  auto occurrence_end = [&](size_t i) {
+    return occurrences[i] + (lengths ? (*lengths)[i] : pattern_length);
+  };
+
+  while (j < occurrences.size()) {
+    Line line = GetLine(text, occurrences[j], &storage);
+    size_t line_end = line.start + line.length;
+    writer_->Write(line_prefix_);
+
+    if (number_lines_) {
+      size_t sample_pos, sample_lines;
+
+      if (FindLineSample(text, line.start, &sample_pos, &sample_lines) &&
+          sample_pos > counted_pos) {
+        counted_pos = sample_pos;
+        counted_lines = sample_lines;
+      }
+
+      counted_lines += CountLineFeeds(text, counted_pos, line.start);
+      counted_pos = line.start;
+
+      writer_->WriteNumber(counted_lines + 1);
+      writer_->Put(':');
+    }
+
+    size_t printed = line.start;
+
+    while (j < occurrences.size() && occurrences[j] <= line_end) {
+      size_t begin = occurrences[j];
+      size_t end = std::min(occurrence_end(j), line_end);
+
+      while (++j < occurrences.size() && occurrences[j] < end) {
+        end = std::max(end, std::min(occurrence_end(j), line_end));
+      }
+
+      writer_->Write(line.data + (printed - line.start), begin - printed);
+      writer_->Write(kANSIRedColor, sizeof(kANSIRedColor) - 1);
+      writer_->Write(line.data + (begin - line.start), end - begin);
+      writer_->Write(kANSIResetAll, sizeof(kANSIResetAll) - 1);
+      printed = end;
+    }
+
+    writer_->Write(line.data + (printed - line.start), line_end - printed);
+    writer_->Put('\n');
+  }
+}
+
+}  // namespace ipmt
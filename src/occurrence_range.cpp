@@ -0,0 +1,54 @@
+#include "occurrence_range.h"
+
+namespace ipmt {
+namespace {
+
+// Fewer positions than this are sorted by comparisons: the counting passes would cost more.
+const size_t kMinRadixSortSize = 1024;
+const int kRadixBits = 8;
+const size_t kRadix = size_t(1) << kRadixBits;
+
+}  // namespace
+
+void RadixSort(std::vector<size_t> *positions) {
+  size_t size = positions->size();
+
+  if (size < kMinRadixSortSize) {
+    std::sort(positions->begin(), positions->end());
+    return;
+  }
+
+  size_t max_pos = *std::max_element(positions->begin(), positions->end());
+  std::vector<size_t> buffer(size);
+  std::vector<size_t> *from = positions;
+  std::vector<size_t> *to = &buffer;
+
+  for (int shift = 0; shift < 64 && (max_pos >> shift) > 0; shift += kRadixBits) {
+    std::vector<size_t> starts(kRadix + 1, 0);
+
+    for (size_t i = 0; i < size; ++i) {
+      ++starts[(((*from)[i] >> shift) & (kRadix - 1)) + 1];
+    }
+
+    for (size_t d = 1; d <= kRadix; ++d) {
+      starts[d] += starts[d - 1];
+    }
+
+    for (size_t i = 0; i < size; ++i) {
+      size_t pos = (*from)[i];
+      (*to)[starts[(pos >> shift) & (kRadix - 1)]++] = pos;
+    }
+
+    std::swap(from, to);
+  }
+
+  if (from != positions) {
+    positions->swap(buffer);
+  }
+}
+
+std::vector<size_t> OccurrenceRange::Sorted(size_t limit) const {
+  return SortSmallest(size(), limit, [this](size_t i) { return (*this)[i]; });
+}
+
+}  // namespace ipmt
@@ -0,0 +1,121 @@
+#include "packed_array.h"
+
+#include <algorithm>
+#include <utility>
+
+namespace ipmt {
+
+const int PackedArray::kWordSize = 64;
+
+PackedArray::PackedArray(const PackedArray &array)
+    : words_(array.words_),
+      data_(array.is_view() ? array.data_ : words_.data()),
+      mutable_data_(array.is_view() ? array.mutable_data_ : words_.data()),
+      mask_(array.mask_),
+      size_(array.size_),
+      width_(array.width_) {}
+
+PackedArray::PackedArray(PackedArray &&array)
+    : data_(array.data_),
+      mutable_data_(array.mutable_data_),
+      mask_(array.mask_),
+      size_(array.size_),
+      width_(array.width_) {
+  // Moving a vector keeps its buffer, so data_ stays valid for owned words too.
+  words_ = std::move(array.words_);
+  array.data_ = nullptr;
+  array.mutable_data_ = nullptr;
+  array.size_ = 0;
+}
+
+PackedArray::PackedArray(std::vector<uint64_t> &&words, size_t size, int width)
+    : words_(std::move(words)), size_(size) {
+  SetWidth(width);
+
+  words_.resize(NumWords(size, width));
+
+  size_t bits = size * width;
+  size_t last = bits / kWordSize;
+  if (bits % kWordSize != 0) {
+    words_[last++] &= (1ULL << (bits % kWordSize)) - 1;
+  }
+  std::fill(words_.begin() + last, words_.end(), 0);
+
+  // Frees the words beyond the array, copying the rest if there were any.
+  words_.shrink_to_fit();
+  data_ = words_.data();
+  mutable_data_ = words_.data();
+}
+
+size_t PackedArray::NumWords(size_t size, int width) {
+  return (size * width + kWordSize - 1) / kWordSize + 1;
+}
+
+int PackedArray::RequiredWidth(uint64_t value) {
+  int width = 1;
+  while (width < kWordSize && (value >> width) != 0) ++width;
+
+  return width;
+}
+
+PackedArray PackedArray::View(const uint64_t *words, size_t size, int width) {
+  PackedArray view;
+  view.data_ = words;
+  view.size_ = size;
+  view.SetWidth(width);
+
+  return view;
+}
+
+PackedArray PackedArray::MutableView(uint64_t *words, size_t size, int width) {
+  PackedArray view = View(words, size, width);
+  view.mutable_data_ = words;
+
+  return view;
+}
+
+PackedArray& PackedArray::operator=(const PackedArray &array) {
+  if (this != &array) {
+    words_ = array.words_;
+    data_ = array.is_view() ? array.data_ : words_.data();
+    mutable_data_ = array.is_view() ? array.mutable_data_ : words_.data();
+    mask_ = array.mask_;
+    size_ = array.size_;
+    width_ = array.width_;
+  }
+
+  return *this;
+}
+
+PackedArray& PackedArray::operator=(PackedArray &&array) {
+  if (this != &array) {
+    data_ = array.data_;
+    mutable_data_ = array.mutable_data_;
+    words_ = std::move(array.words_);
+    mask_ = array.mask_;
+    size_ = array.size_;
+    width_ = array.width_;
+
+    array.data_ = nullptr;
+    array.mutable_data_ = nullptr;
+    array.size_ = 0;
+  }
+
+  return *this;
+}
+
+void PackedArray::Resize(size_t size, int width) {
+  size_ = size;
+  SetWidth(width);
+
+  words_.assign(NumWords(size, width), 0);
+  data_ = words_.data();
+  mutable_data_ = words_.data();
+}
+
+void PackedArray::SetWidth(int width) {
+  width_ = width;
+  mask_ = width == kWordSize ? ~0ULL : (1ULL << width) - 1;
+}
+
+}  // namespace ipmt
@@ -0,0 +1,85 @@
+#include "rank_bitvector.h"
+
+namespace ipmt {
+namespace {
+
+const size_t kBlockBits = 512;
+const size_t kWordsPerBlock = kBlockBits / 64;
+
+size_t NumBitWords(size_t size) {
+  // Rounded up to whole blocks, so Rank1 never reads past the bits.
+  return (size / kBlockBits + 1) * kWordsPerBlock;
+}
+
+size_t NumRankWords(size_t size) {
+  return size / kBlockBits + 1;
+}
+
+}  // namespace
+
+void RankBitvector::Append(const std::vector<uint64_t> &bits, size_t size,
+                           std::vector<uint64_t> *out) {
+  size_t num_bit_words = NumBitWords(size);
+  size_t used_words = (size + 63) / 64;
+  size_t start = out->size();
+
+  for (size_t i = 0; i < num_bit_words; ++i) {
+    uint64_t word = i < used_words ? bits[i] : 0;
+
+    // Clear bits past the end, so they are never counted.
+    if (i + 1 == used_words && (size & 63)) word &= (1ULL << (size & 63)) - 1;
+
+    out->push_back(word);
+  }
+
+  uint64_t rank = 0;
+  for (size_t block = 0; block < NumRankWords(size); ++block) {
+    out->push_back(rank);
+
+    for (size_t i = block * kWordsPerBlock; i < (block + 1) * kWordsPerBlock; ++i) {
+      rank += __builtin_popcountll((*out)[start + i]);
+    }
+  }
+}
+
+size_t RankBitvector::NumWords(size_t size) {
+  return NumBitWords(size) + NumRankWords(size);
+}
+
+void RankBitvector::View(const uint64_t *data, size_t size) {
+  bits_ = data;
+  ranks_ = data + NumBitWords(size);
+  size_ = size;
+}
+
+size_t RankBitvector::Select1(size_t k) const {
+  // Find the last block with at most k ones before it, then scan its words.
+  size_t low = 0;
+  size_t high = NumRankWords(size_);
+
+  while (high - low > 1) {
+    size_t mid = low + (high - low) / 2;
+    if (ranks_[mid] <= k) low = mid;
+    else high = mid;
+  }
+
+  size_t rank = ranks_[low];
+  size_t word = low * kWordsPerBlock;
+
+  while (true) {
+    size_t ones = __builtin_popcountll(bits_[word]);
+    if (rank + ones > k) break;
+
+    rank += ones;
+    ++word;
+  }
+
+  uint64_t bits = bits_[word];
+  for (size_t i = rank; i < k; ++i) {
+    bits &= bits - 1;  // Clear the lowest one.
+  }
+
+  return word * 64 + __builtin_ctzll(bits);
+}
+
+}  // namespace ipmt
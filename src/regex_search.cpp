@@ -0,0 +1,532 @@
+#include "regex_search.h"
+
+#include <algorithm>
+#include <cstring>
+#include <limits>
+
+#include <regex.h>
+
+#include "index_search_text.h"
+#include "parallel.h"
+
+namespace ipmt {
+namespace {
+
+// Characters extracted at a time when scanning the whole text.
+const size_t kScanChunk = 1 << 20;
+// Required literals are looked up only if they occur at most once every kMinCandidateGap
+// characters on average; matching the lines of more candidates one by one costs more than a scan.
+const size_t kMinCandidateGap = 16;
+const size_t kNoLine = std::numeric_limits<size_t>::max();
+
+// What is known about the strings matched by part of an expression.
+struct Info {
+  bool is_exact;  // Whether it matches exact and nothing else.
+  std::string exact;
+  std::string prefix;  // Every match starts with prefix and ends with suffix.
+  std::string suffix;
+  std::vector<std::vector<std::string>> required;  // Every match holds a literal of each list.
+};
+
+Info ExactInfo(const std::string &literal) {
+  Info info;
+  info.is_exact = true;
+  info.exact = info.prefix = info.suffix = literal;
+
+  return info;
+}
+
+// Part which may match any string, as far as literals go.
+Info AnyInfo() {
+  Info info;
+  info.is_exact = false;
+
+  return info;
+}
+
+// Lists with longer literals narrow the search down more; the shortest literal of a list counts.
+size_t Score(const std::vector<std::string> &literals) {
+  size_t score = literals.empty() ? 0 : std::numeric_limits<size_t>::max();
+  for (size_t i = 0; i < literals.size(); ++i) {
+    score = std::min(score, literals[i].size());
+  }
+
+  return score;
+}
+
+// Returns the list of required literals with the highest score (then the fewest literals), or an
+// empty list if there is none.
+std::vector<std::string> GetBestLiterals(const Info &info) {
+  std::vector<std::vector<std::string>> lists = info.required;
+  lists.push_back(std::vector<std::string>(1, info.prefix));
+  lists.push_back(std::vector<std::string>(1, info.suffix));
+
+  std::vector<std::string> best;
+  for (size_t i = 0; i < lists.size(); ++i) {
+    size_t score = Score(lists[i]);
+
+    if (score > Score(best) || (score > 0 && score == Score(best) &&
+                                lists[i].size() < best.size())) {
+      best = lists[i];
+    }
+  }
+
+  return best;
+}
+
+Info Concatenate(const Info &lhs, const Info &rhs) {
+  Info info = lhs.is_exact && rhs.is_exact ? ExactInfo(lhs.exact + rhs.exact) : AnyInfo();
+  info.required = lhs.required;
+  info.required.insert(info.required.end(), rhs.required.begin(), rhs.required.end());
+
+  if (!info.is_exact) {
+    info.prefix = lhs.is_exact ? lhs.exact + rhs.prefix : lhs.prefix;
+    info.suffix = rhs.is_exact ? lhs.suffix + rhs.exact : rhs.suffix;
+
+    std::string middle = lhs.suffix + rhs.prefix;
+    if (!middle.empty()) info.required.push_back(std::vector<std::string>(1, middle));
+  }
+
+  return info;
+}
+
+// A match of either side holds a literal of either side's best list.
+Info Alternate(const Info &lhs, const Info &rhs) {
+  if (lhs.is_exact && rhs.is_exact && lhs.exact == rhs.exact) {
+    return lhs;
+  }
+
+  Info info = AnyInfo();
+  size_t prefix_length = 0;
+  while (prefix_length < std::min(lhs.prefix.size(), rhs.prefix.size()) &&
+         lhs.prefix[prefix_length] == rhs.prefix[prefix_length]) {
+    ++prefix_length;
+  }
+
+  size_t suffix_length = 0;
+  while (suffix_length < std::min(lhs.suffix.size(), rhs.suffix.size()) &&
+         lhs.suffix[lhs.suffix.size() - 1 - suffix_length] ==
+         rhs.suffix[rhs.suffix.size() - 1 - suffix_length]) {
+    ++suffix_length;
+  }
+
+  info.prefix = lhs.prefix.substr(0, prefix_length);
+  info.suffix = lhs.suffix.substr(lhs.suffix.size() - suffix_length);
+
+  std::vector<std::string> literals = GetBestLiterals(lhs);
+  std::vector<std::string> rhs_literals = GetBestLiterals(rhs);
+
+  if (!literals.empty() && !rhs_literals.empty()) {
+    literals.insert(literals.end(), rhs_literals.begin(), rhs_literals.end());
+    std::sort(literals.begin(), literals.end());
+    literals.erase(std::unique(literals.begin(), literals.end()), literals.end());
+    info.required.push_back(literals);
+  }
+
+  return info;
+}
+
+// Repeating a part at least once keeps what every match of it holds, but no longer exactly.
+Info Repeat(const Info &info, size_t min, size_t max) {
+  if (min == 0) {
+    return AnyInfo();
+  } else if (min == 1 && max == 1) {
+    return info;
+  }
+
+  Info repeated = info;
+  repeated.is_exact = false;
+  repeated.exact.clear();
+
+  return repeated;
+}
+
+// Recursive descent parser of POSIX extended regular expressions (with the GNU escapes), which
+// only keeps what is known about the literals of each part. Anything it does not handle fails the
+// parse, rather than risk taking a literal as required when it is not.
+class LiteralParser {
+ public:
+  explicit LiteralParser(const std::string &regex) : regex_(regex), pos_(0), failed_(false) {}
+
+  // Returns false if the expression is not understood.
+  bool Parse(Info *info) {
+    *info = ParseAlternation(0);
+    return !failed_ && pos_ == regex_.size();
+  }
+
+ private:
+  Info ParseAlternation(int depth) {
+    Info info = ParseConcatenation(depth);
+
+    while (!failed_ && pos_ < regex_.size() && regex_[pos_] == '|') {
+      ++pos_;
+      info = Alternate(info, ParseConcatenation(depth));
+    }
+
+    return info;
+  }
+
+  Info ParseConcatenation(int depth) {
+    Info info = ExactInfo("");
+
+    while (!failed_ && pos_ < regex_.size() && regex_[pos_] != '|' &&
+           !(regex_[pos_] == ')' && depth > 0)) {
+      info = Concatenate(info, ParseRepetition(depth));
+    }
+
+    return info;
+  }
+
+  Info ParseRepetition(int depth) {
+    Info info = ParseAtom(depth);
+
+    while (!failed_ && pos_ < regex_.size()) {
+      size_t min = 0;
+      size_t max = std::numeric_limits<size_t>::max();
+      char c = regex_[pos_];
+
+      if (c == '+') {
+        min = 1;
+      } else if (c == '?') {
+        max = 1;
+      } else if (c == '{') {
+        if (!ParseInterval(&min, &max)) failed_ = true;
+        info = Repeat(info, min, max);
+        continue;
+      } else if (c != '*') {
+        break;
+      }
+
+      ++pos_;
+      info = Repeat(info, min, max);
+    }
+
+    return info;
+  }
+
+  Info ParseAtom(int depth) {
+    char c = regex_[pos_++];
+
+    switch (c) {
+      case '(': {
+        Info info = ParseAlternation(depth + 1);
+        if (pos_ >= regex_.size() || regex_[pos_] != ')') {
+          failed_ = true;
+        }
+
+        ++pos_;
+        return info;
+      }
+
+      // Repetitions without a part to repeat, and unmatched parentheses.
+      case ')':
+      case '*':
+      case '+':
+      case '?':
+      case '{':
+        failed_ = true;
+        return AnyInfo();
+
+      case '^':
+      case '$':
+        return ExactInfo("");
+
+      case '.':
+        return AnyInfo();
+
+      case '[': {
+        std::string single;
+        if (!ParseBracket(&single)) failed_ = true;
+        return single.empty() ? AnyInfo() : ExactInfo(single);
+      }
+
+      // Escaped special characters are literals; other escapes are classes, anchors and
+      // back-references.
+      case '\\':
+        if (pos_ >= regex_.size()) {
+          failed_ = true;
+          return AnyInfo();
+        }
+
+        c = regex_[pos_++];
+        return std::strchr(".[]()*+?{}|^$\\", c) ? ExactInfo(std::string(1, c)) : AnyInfo();
+
+      default:
+        return ExactInfo(std::string(1, c));
+    }
+  }
+
+  // Parses {min}, {min,}, {min,max} or {,max}.
+  bool ParseInterval(size_t *min, size_t *max) {
+    size_t close = regex_.find('}', pos_);
+    if (close == std::string::npos) {
+      return false;
+    }
+
+    std::string interval = regex_.substr(pos_ + 1, close - pos_ - 1);
+    size_t comma = interval.find(',');
+    std::string min_digits = interval.substr(0, comma);
+    std::string max_digits = comma == std::string::npos ? min_digits : interval.substr(comma + 1);
+
+    if (interval.find_first_not_of("0123456789,") != std::string::npos ||
+        (comma != std::string::npos && interval.find(',', comma + 1) != std::string::npos) ||
+        (min_digits.empty() && max_digits.empty())) {
+      return false;
+    }
+
+    *min = min_digits.empty() ? 0 : std::stoull(min_digits);
+    *max = max_digits.empty() ? std::numeric_limits<size_t>::max() : std::stoull(max_digits);
+    pos_ = close + 1;
+
+    return true;
+  }
+
+  // Parses a bracket expression, whose opening bracket was parsed already, and sets single to its
+  // character if it matches a single one.
+  bool ParseBracket(std::string *single) {
+    bool is_negated = pos_ < regex_.size() && regex_[pos_] == '^';
+    if (is_negated) ++pos_;
+
+    size_t num_chars = 0;
+    char first_char = '\0';
+
+    for (bool is_first = true; ; is_first = false) {
+      if (pos_ >= regex_.size()) {
+        return false;
+      }
+
+      char c = regex_[pos_];
+      if (c == ']' && !is_first) {
+        ++pos_;
+        break;
+      }
+
+      // Collating symbols, equivalence classes and character classes: [.x.], [=x=], [:name:].
+      if (c == '[' && pos_ + 1 < regex_.size() && std::strchr(".=:", regex_[pos_ + 1])) {
+        size_t close = regex_.find(std::string(1, regex_[pos_ + 1]) + "]", pos_ + 2);
+        if (close == std::string::npos) {
+          return false;
+        }
+
+        first_char = regex_[pos_ + 2];
+        num_chars += regex_[pos_ + 1] == '.' && close == pos_ + 3 ? 1 : 2;
+        pos_ = close + 2;
+      } else if (pos_ + 2 < regex_.size() && regex_[pos_ + 1] == '-' && regex_[pos_ + 2] != ']') {
+        num_chars += 2;  // Range.
+        pos_ += 3;
+      } else {
+        first_char = c;
+        ++num_chars;
+        ++pos_;
+      }
+    }
+
+    if (!is_negated && num_chars == 1) {
+      *single = std::string(1, first_char);
+    }
+
+    return true;
+  }
+
+  const std::string &regex_;
+  size_t pos_;
+  bool failed_;
+};
+
+// Compiled expression, matched against one line at a time.
+class LineMatcher {
+ public:
+  LineMatcher() : is_compiled_(false) {}
+  ~LineMatcher() {
+    if (is_compiled_) regfree(&regex_);
+  }
+
+  bool Compile(const std::string &regex) {
+    is_compiled_ = regcomp(&regex_, regex.c_str(), REG_EXTENDED) == 0;
+    return is_compiled_;
+  }
+
+  // Appends the matches within line[0, length), which starts at pos on the text. Empty matches
+  // (e.g. of "x*" between two other characters) are not recorded, and the next match is looked for
+  // one character later.
+  void Match(const char *line, size_t length, size_t pos, RegexMatches *matches) const {
+    size_t offset = 0;
+
+    while (offset <= length) {
+      regmatch_t match;
+      match.rm_so = offset;
+      match.rm_eo = length;
+
+      int flags = REG_STARTEND | (offset > 0 ? REG_NOTBOL : 0);
+      if (regexec(&regex_, line, 1, &match, flags) != 0) {
+        break;
+      }
+
+      if (match.rm_eo == match.rm_so) {
+        offset = match.rm_so + 1;
+        continue;
+      }
+
+      matches->positions.push_back(pos + match.rm_so);
+      matches->lengths.push_back(match.rm_eo - match.rm_so);
+      offset = match.rm_eo;
+    }
+  }
+
+ private:
+  LineMatcher(const LineMatcher&) = delete;
+  LineMatcher& operator=(const LineMatcher&) = delete;
+
+  regex_t regex_;
+  bool is_compiled_;
+};
+
+// Matches the lines holding candidates[begin, end), each line once. Sets line_end to the end of the
+// last line matched, or kNoLine if there is none.
+template <typename Text>
+void MatchCandidateLines(const LineMatcher &matcher, const Text &text,
+                         const std::vector<size_t> &candidates, size_t begin, size_t end,
+                         RegexMatches *matches, size_t *line_end) {
+  *line_end = kNoLine;
+
+  for (size_t i = begin; i < end; ++i) {
+    if (*line_end != kNoLine && candidates[i] <= *line_end) continue;
+
+    size_t line_start;
+    std::string line = text.ExtractLine(candidates[i], &line_start);
+    matcher.Match(line.data(), line.size(), line_start, matches);
+    *line_end = line_start + line.size();
+  }
+}
+
+// Matches the lines starting in [begin, end), a chunk of text at a time.
+template <typename Text>
+void ScanLines(const LineMatcher &matcher, const Text &text, size_t begin, size_t end,
+               RegexMatches *matches) {
+  size_t pos = begin;
+  size_t size = text.size();
+
+  // The line holding begin - 1 is left to the range before.
+  if (pos > 0) {
+    size_t line_start;
+    std::string line = text.ExtractLine(pos - 1, &line_start);
+    pos = line_start + line.size() + 1;
+  }
+
+  while (pos < end && pos < size) {
+    std::string chunk = text.Extract(pos, kScanChunk);
+    size_t offset = 0;
+
+    while (offset < chunk.size() && pos + offset < end) {
+      size_t lf_index = chunk.find('\n', offset);
+      if (lf_index == std::string::npos && pos + chunk.size() < size) break;
+
+      size_t line_end = lf_index == std::string::npos ? chunk.size() : lf_index;
+      matcher.Match(chunk.data() + offset, line_end - offset, pos + offset, matches);
+      offset = line_end + 1;
+    }
+
+    // Lines longer than a chunk are extracted whole.
+    if (offset == 0) {
+      size_t line_start;
+      std::string line = text.ExtractLine(pos, &line_start);
+      matcher.Match(line.data(), line.size(), pos, matches);
+      offset = line.size() + 1;
+    }
+
+    pos += offset;
+  }
+}
+
+template <typename Text>
+bool FindRegexMatchesIn(const std::string &regex, const Text &text, RegexMatches *matches,
+                        int num_threads) {
+  LineMatcher matcher;
+  if (!matcher.Compile(regex)) {
+    return false;
+  }
+
+  std::vector<std::string> literals = ExtractRequiredLiterals(regex);
+  size_t num_candidates = 0;
+
+  for (size_t i = 0; i < literals.size(); ++i) {
+    num_candidates += text.Count(literals[i]);
+  }
+
+  // Candidates are the occurrences of any of the literals, sorted.
+  bool is_scan = literals.empty() || num_candidates * kMinCandidateGap > text.size();
+  std::vector<size_t> candidates;
+
+  for (size_t i = 0; i < literals.size() && !is_scan; ++i) {
+    std::vector<size_t> occurrences = text.Locate(literals[i]);
+    candidates.insert(candidates.end(), occurrences.begin(), occurrences.end());
+  }
+
+  std::sort(candidates.begin(), candidates.end());
+
+  // Each thread matches a contiguous range of candidates (or of the text), so concatenating their
+  // matches keeps them sorted. A line holding candidates of two ranges is matched by both threads,
+  // so matches within the last line of the threads before are dropped.
+  size_t num_items = is_scan ? text.size() : candidates.size();
+  num_threads = static_cast<int>(std::max<size_t>(1, std::min<size_t>(num_threads, num_items)));
+  std::vector<RegexMatches> thread_matches(num_threads);
+  std::vector<size_t> line_ends(num_threads, kNoLine);
+
+  // glibc serializes the calls to regexec on the same compiled expression, so each thread compiles
+  // its own.
+  ParallelFor(num_threads, num_items, [&](int t, size_t begin, size_t end) {
+    LineMatcher thread_matcher;
+    thread_matcher.Compile(regex);
+
+    if (is_scan) {
+      ScanLines(thread_matcher, text, begin, end, &thread_matches[t]);
+    } else {
+      MatchCandidateLines(thread_matcher, text, candidates, begin, end, &thread_matches[t],
+                          &line_ends[t]);
+    }
+  });
+
+  size_t line_end = kNoLine;
+  matches->positions.clear();
+  matches->lengths.clear();
+
+  for (int t = 0; t < num_threads; ++t) {
+    const RegexMatches &part = thread_matches[t];
+
+    for (size_t i = 0; i < part.positions.size(); ++i) {
+      if (line_end != kNoLine && part.positions[i] <= line_end) continue;
+
+      matches->positions.push_back(part.positions[i]);
+      matches->lengths.push_back(part.lengths[i]);
+    }
+
+    if (line_ends[t] != kNoLine) line_end = line_ends[t];
+  }
+
+  return true;
+}
+
+}  // namespace
+
+std::vector<std::string> ExtractRequiredLiterals(const std::string &regex) {
+  Info info;
+  LiteralParser parser(regex);
+
+  if (!parser.Parse(&info)) {
+    return std::vector<std::string>();
+  }
+
+  return GetBestLiterals(info);
+}
+
+bool FindRegexMatches(const std::string &regex, const Index &index, RegexMatches *matches,
+                      int num_threads) {
+  return FindRegexMatchesIn(regex, IndexSearchText(index), matches, num_threads);
+}
+
+bool FindRegexMatches(const std::string &regex, const SegmentedIndex &index,
+                      RegexMatches *matches, int num_threads) {
+  return FindRegexMatchesIn(regex, index, matches, num_threads);
+}
+
+}  // namespace ipmt
@@ -0,0 +1,184 @@
+#include "segmented_index.h"
+
+#include <algorithm>
+
+#include "line_samples.h"
+#include "parallel.h"
+
+namespace ipmt {
+
+int SegmentedIndex::Open(const std::string &manifest_path, Stats *stats) {
+  if (stats) stats->BeginPhase("load");
+
+  int status = ReadManifest(manifest_path, &manifest_);
+  if (status != 0) {
+    return status;
+  }
+
+  segments_.clear();
+  starts_.assign(1, 0);
+  line_feeds_.assign(1, 0);
+
+  for (size_t i = 0; i < manifest_.segments.size(); ++i) {
+    const Segment &segment = manifest_.segments[i];
+    std::unique_ptr<Index> index(new Index());
+
+    status = ReadIndexFile(GetSegmentPath(manifest_path, segment.filename), index.get(), stats,
+                           num_threads_);
+    if (status != 0) {
+      return status;
+    } else if (GetTextSize(*index) != segment.size) {
+      return -3;
+    }
+
+    segments_.push_back(std::move(index));
+    starts_.push_back(starts_.back() + segment.size);
+    line_feeds_.push_back(line_feeds_.back() + segment.line_feeds);
+  }
+
+  return 0;
+}
+
+size_t SegmentedIndex::Count(const std::string &pattern) const {
+  std::vector<size_t> counts(segments_.size(), 0);
+
+  ParallelFor(num_threads_, segments_.size(), [&](int, size_t begin, size_t end) {
+    std::vector<size_t> across;
+
+    for (size_t i = begin; i < end; ++i) {
+      across.clear();
+      LocateAcrossBoundary(pattern, i, &across);
+      counts[i] = CountOccurrences(*segments_[i], pattern) + across.size();
+    }
+  });
+
+  size_t total = 0;
+  for (size_t i = 0; i < counts.size(); ++i) {
+    total += counts[i];
+  }
+
+  return total;
+}
+
+// Occurrences within a segment all start before those spanning its end, so appending each
+// segment's occurrences in text order keeps them sorted.
+std::vector<size_t> SegmentedIndex::Locate(const std::string &pattern, size_t limit) const {
+  std::vector<std::vector<size_t>> segment_occurrences(segments_.size());
+  std::vector<size_t> occurrences;
+  size_t group_size = limit == kNoLimit ? segments_.size() : num_threads_;
+
+  for (size_t first = 0; first < segments_.size() && occurrences.size() < limit;
+       first += group_size) {
+    size_t last = std::min(first + group_size, segments_.size());
+
+    ParallelFor(num_threads_, last - first, [&](int, size_t begin, size_t end) {
+      for (size_t i = first + begin; i < first + end; ++i) {
+        std::vector<size_t> &segment = segment_occurrences[i];
+        segment = LocateOccurrences(*segments_[i], pattern, limit);
+
+        for (size_t j = 0; j < segment.size(); ++j) {
+          segment[j] += starts_[i];
+        }
+
+        LocateAcrossBoundary(pattern, i, &segment);
+      }
+    });
+
+    for (size_t i = first; i < last; ++i) {
+      occurrences.insert(occurrences.end(), segment_occurrences[i].begin(),
+                         segment_occurrences[i].end());
+    }
+  }
+
+  if (occurrences.size() > limit) {
+    occurrences.resize(limit);
+  }
+
+  return occurrences;
+}
+
+std::string SegmentedIndex::Extract(size_t pos, size_t length) const {
+  std::string result;
+  size_t end = pos + std::min(length, size() - std::min(pos, size()));
+
+  for (size_t i = FindSegment(pos); pos < end; ++i) {
+    size_t count = std::min(starts_[i + 1], end) - pos;
+    result += ExtractText(*segments_[i], pos - starts_[i], count);
+    pos += count;
+  }
+
+  return result;
+}
+
+// A line starting at the start of a segment may continue on the segments before it, and one ending
+// at the end of a segment on those after it.
+std::string SegmentedIndex::ExtractLine(size_t pos, size_t *line_start) const {
+  if (segments_.empty()) {
+    *line_start = 0;
+    return std::string();
+  }
+
+  size_t i = FindSegment(pos);
+  size_t local_start;
+  std::string line = ExtractTextLine(*segments_[i], pos - starts_[i], &local_start);
+  *line_start = starts_[i] + local_start;
+
+  for (size_t j = i; j > 0 && *line_start == starts_[j]; ) {
+    --j;
+    if (starts_[j] == starts_[j + 1]) continue;  // Empty segment.
+
+    line = ExtractTextLine(*segments_[j], starts_[j + 1] - starts_[j], &local_start) + line;
+    *line_start = starts_[j] + local_start;
+  }
+
+  for (size_t j = i; j + 1 < segments_.size() && *line_start + line.size() == starts_[j + 1]; ) {
+    ++j;
+    if (starts_[j] == starts_[j + 1]) continue;
+
+    line += ExtractTextLine(*segments_[j], 0, &local_start);
+  }
+
+  return line;
+}
+
+void SegmentedIndex::FindLineSample(size_t pos, size_t *sample_pos, size_t *sample_lines) const {
+  if (segments_.empty()) {
+    *sample_pos = 0;
+    *sample_lines = 0;
+    return;
+  }
+
+  size_t i = FindSegment(pos);
+  const PackedArray &line_samples = segments_[i]->line_samples;
+  size_t samples = CountLineSamples(line_samples, pos - starts_[i]);
+
+  // The first sample of a segment is its start, which is a line start only within the segment.
+  *sample_pos = starts_[i] + (samples > 0 ? line_samples[samples - 1] : 0);
+  *sample_lines = line_feeds_[i] + (samples > 0 ? (samples - 1) * kLineSampleRate : 0);
+}
+
+size_t SegmentedIndex::FindSegment(size_t pos) const {
+  size_t i = std::upper_bound(starts_.begin(), starts_.end(), pos) - starts_.begin();
+  return std::min(i, segments_.size()) - 1;
+}
+
+void SegmentedIndex::LocateAcrossBoundary(const std::string &pattern, size_t i,
+                                          std::vector<size_t> *occurrences) const {
+  size_t m = pattern.size();
+  size_t end = starts_[i + 1];
+
+  if (m < 2 || i + 1 >= segments_.size() || end == starts_[i]) {
+    return;
+  }
+
+  // Only occurrences starting in [first, end) do not fit in the segment.
+  size_t first = std::max(starts_[i], end - std::min(end, m - 1));
+  std::string window = Extract(first, end - first + m - 1);
+
+  for (size_t j = window.find(pattern); j != std::string::npos && j < end - first;
+       j = window.find(pattern, j + 1)) {
+    occurrences->push_back(first + j);
+  }
+}
+
+}  // namespace ipmt
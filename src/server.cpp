@@ -0,0 +1,290 @@
+#include "server.h"
+
+#include <chrono>
+#include <cstring>
+#include <iostream>
+#include <new>
+#include <sstream>
+#include <stdexcept>
+#include <thread>
+#include <utility>
+
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "buffered_writer.h"
+#include "fm_index.h"
+#include "manifest.h"
+#include "occurrence_printer.h"
+#include "parallel.h"
+#include "utils.h"
+
+namespace ipmt {
+namespace {
+
+bool IsSameFile(const struct stat &file_stat, ino_t inode, off_t size, const timespec &modified) {
+  return file_stat.st_ino == inode && file_stat.st_size == size &&
+         file_stat.st_mtim.tv_sec == modified.tv_sec &&
+         file_stat.st_mtim.tv_nsec == modified.tv_nsec;
+}
+
+// Data lines are collected on a string stream, so the buffer of their writer need not be large.
+const size_t kResponseBufferSize = 1 << 16;
+
+bool WriteAll(int fd, const std::string &data) {
+  for (size_t written = 0; written < data.size(); ) {
+    ssize_t count = write(fd, data.data() + written, data.size() - written);
+    if (count <= 0) return false;
+    written += count;
+  }
+
+  return true;
+}
+
+}  // namespace
+
+int SearchServer::Load(const std::vector<std::string> &index_paths) {
+  for (size_t i = 0; i < index_paths.size(); ++i) {
+    ResidentIndex resident;
+    struct stat file_stat;
+
+    if (stat(index_paths[i].c_str(), &file_stat) != 0) {
+      return -1;
+    }
+
+    int status = LoadIndex(index_paths[i], &resident);
+    if (status != 0) {
+      return status;
+    }
+
+    resident.path = index_paths[i];
+    resident.inode = file_stat.st_ino;
+    resident.size = file_stat.st_size;
+    resident.modified = file_stat.st_mtim;
+    indexes_.push_back(std::move(resident));
+  }
+
+  return 0;
+}
+
+void SearchServer::Serve(std::istream &in, std::ostream &out) {
+  std::string request;
+
+  while (std::getline(in, request) && request != "quit") {
+    std::string response;
+    std::string status = HandleRequest(request, &response);
+    out << response << status << std::endl;
+  }
+}
+
+bool SearchServer::ServeSocket(const std::string &socket_path) {
+  sockaddr_un address;
+  if (socket_path.size() >= sizeof(address.sun_path)) {
+    return false;
+  }
+
+  std::memset(&address, 0, sizeof(address));
+  address.sun_family = AF_UNIX;
+  std::strcpy(address.sun_path, socket_path.c_str());
+
+  int listener = socket(AF_UNIX, SOCK_STREAM, 0);
+  unlink(socket_path.c_str());
+
+  if (listener < 0 || bind(listener, reinterpret_cast<sockaddr*>(&address), sizeof(address)) ||
+      listen(listener, SOMAXCONN)) {
+    if (listener >= 0) close(listener);
+    return false;
+  }
+
+  while (true) {
+    int fd = accept(listener, nullptr, nullptr);
+    if (fd >= 0) {
+      std::thread(&SearchServer::ServeConnection, this, fd).detach();
+    }
+  }
+}
+
+void SearchServer::ServeConnection(int fd) {
+  std::string buffer;
+  char chunk[4096];
+  bool is_open = true;
+
+  while (is_open) {
+    ssize_t count = read(fd, chunk, sizeof(chunk));
+    if (count <= 0) break;
+
+    buffer.append(chunk, count);
+    size_t line_start = 0;
+    size_t line_end;
+
+    while (is_open && (line_end = buffer.find('\n', line_start)) != std::string::npos) {
+      std::string request = buffer.substr(line_start, line_end - line_start);
+      line_start = line_end + 1;
+
+      if (!request.empty() && request.back() == '\r') request.pop_back();
+      if (request == "quit") break;
+
+      std::string response;
+      std::string status = HandleRequest(request, &response);
+      is_open = WriteAll(fd, response + status + "\n");
+    }
+
+    if (line_end != std::string::npos) break;  // Quit request.
+    buffer.erase(0, line_start);
+  }
+
+  close(fd);
+}
+
+std::string SearchServer::HandleRequest(const std::string &request, std::string *response) {
+  std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+  size_t space = request.find(' ');
+  std::string command = request.substr(0, space);
+
+  if (space == std::string::npos || (command != "count" && command != "search")) {
+    return "ERR Invalid request.";
+  }
+
+  std::string pattern = request.substr(space + 1);
+  std::vector<ResidentIndex> indexes = AcquireIndexes();
+  std::ostringstream lines;
+  BufferedWriter writer(lines, kResponseBufferSize);
+  size_t total = 0;
+
+  // Lines are printed as by search mode, highlighted and numbered if asked.
+  for (size_t i = 0; i < indexes.size(); ++i) {
+    const Index &index = *indexes[i].index;
+    const SegmentedIndex *segmented_index = indexes[i].segmented_index.get();
+    std::string prefix = indexes.size() > 1 ? indexes[i].path + ":" : "";
+    bool is_fm_index = index.index_type == IndexType::kFMIndex;
+    bool has_blocks = !index.block_text.empty();
+
+    if (command == "count") {
+      size_t count = segmented_index ? segmented_index->Count(pattern) :
+                     is_fm_index ? index.fm_index.Count(pattern) :
+                     has_blocks ? FindInterval(pattern, index.block_text, index.suffix_array,
+                                               index.search_lcp).size() :
+                     FindInterval(pattern, index.text, index.suffix_array,
+                                  index.search_lcp).size();
+      if (indexes.size() > 1) {
+        writer.Write(prefix);
+        writer.WriteNumber(count);
+        writer.Put('\n');
+      }
+
+      total += count;
+      continue;
+    }
+
+    OccurrencePrinter printer(&writer, index.line_samples, number_lines_);
+    printer.set_line_prefix(prefix);
+
+    if (segmented_index) {
+      std::vector<size_t> occurrences = segmented_index->Locate(pattern);
+      printer.Print(occurrences, *segmented_index, pattern.size());
+      total += occurrences.size();
+    } else if (is_fm_index) {
+      std::vector<size_t> occurrences = index.fm_index.Locate(pattern);
+      printer.Print(occurrences, index.fm_index, pattern.size());
+      total += occurrences.size();
+    } else if (has_blocks) {
+      std::vector<size_t> occurrences = GetOccurrences(pattern, index.block_text,
+                                                       index.suffix_array, index.search_lcp);
+      printer.Print(occurrences, index.block_text, pattern.size());
+      total += occurrences.size();
+    } else {
+      std::vector<size_t> occurrences = GetOccurrences(pattern, index.text, index.suffix_array,
+                                                       index.search_lcp);
+      printer.Print(occurrences, index.text, pattern.size());
+      total += occurrences.size();
+    }
+  }
+
+  writer.Flush();
+  response->append(lines.str());
+
+  std::chrono::microseconds latency = std::chrono::duration_cast<std::chrono::microseconds>(
+      std::chrono::steady_clock::now() - start);
+
+  return "OK " + std::to_string(total) + " " + std::to_string(latency.count());
+}
+
+int SearchServer::LoadIndex(const std::string &path, ResidentIndex *resident) {
+  // Manifests are told apart from index files by their first line, as by search mode.
+  std::shared_ptr<Index> index = std::make_shared<Index>();
+  int status;
+
+  try {
+    if (IsManifestFile(path)) {
+      std::shared_ptr<SegmentedIndex> segmented_index = std::make_shared<SegmentedIndex>();
+      segmented_index->set_num_threads(HardwareThreads());
+      status = segmented_index->Open(path);
+      if (status == 0) resident->segmented_index = std::move(segmented_index);
+    } else {
+      status = ReadIndexFile(path, index.get(), nullptr, HardwareThreads());
+      if (status == 0) resident->segmented_index.reset();
+    }
+  } catch (const std::length_error&) {
+    return -3;
+  } catch (const std::bad_alloc&) {
+    return -3;
+  }
+
+  if (status == 0) resident->index = std::move(index);
+  return status;
+}
+
+std::vector<SearchServer::ResidentIndex> SearchServer::AcquireIndexes() {
+  for (size_t i = 0; i < indexes_.size(); ++i) {
+    struct stat file_stat;
+    bool is_same = true;
+
+    if (stat(indexes_[i].path.c_str(), &file_stat) == 0) {
+      std::lock_guard<std::mutex> lock(mutex_);
+      is_same = IsSameFile(file_stat, indexes_[i].inode, indexes_[i].size, indexes_[i].modified);
+    }
+
+    if (!is_same) Reload(i);
+  }
+
+  std::lock_guard<std::mutex> lock(mutex_);
+  return indexes_;
+}
+
+// Loads the index file again, unless another request already did. If it cannot be loaded, the
+// previous version is kept until the file changes again.
+void SearchServer::Reload(size_t i) {
+  std::lock_guard<std::mutex> reload_lock(reload_mutex_);
+  struct stat file_stat;
+
+  if (stat(indexes_[i].path.c_str(), &file_stat) != 0) {
+    return;
+  }
+
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (IsSameFile(file_stat, indexes_[i].inode, indexes_[i].size, indexes_[i].modified)) {
+      return;
+    }
+  }
+
+  ResidentIndex resident;
+  int status = LoadIndex(indexes_[i].path, &resident);
+
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (status == 0) {
+    indexes_[i].index = std::move(resident.index);
+    indexes_[i].segmented_index = std::move(resident.segmented_index);
+  } else {
+    std::cerr << "Cannot reload index file " << indexes_[i].path
+              << "; keeping the previous one." << std::endl;
+  }
+
+  indexes_[i].inode = file_stat.st_ino;
+  indexes_[i].size = file_stat.st_size;
+  indexes_[i].modified = file_stat.st_mtim;
+}
+
+}  // namespace ipmt
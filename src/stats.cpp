@@ -0,0 +1,139 @@
+#include "stats.h"
+
+#include <cstdlib>
+#include <ctime>
+#include <fstream>
+#include <iomanip>
+#include <sstream>
+
+#include <sys/resource.h>
+
+namespace ipmt {
+namespace {
+
+double CpuSeconds() {
+  timespec now;
+  clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &now);
+
+  return now.tv_sec + now.tv_nsec / 1e9;
+}
+
+// Escapes the characters which cannot appear as they are on a JSON string.
+std::string EscapeJson(const std::string &value) {
+  std::ostringstream oss;
+
+  for (size_t i = 0; i < value.size(); ++i) {
+    unsigned char c = static_cast<unsigned char>(value[i]);
+
+    if (c == '"' || c == '\\') {
+      oss << '\\' << value[i];
+    } else if (c < 0x20) {
+      oss << "\\u" << std::hex << std::setw(4) << std::setfill('0') << static_cast<int>(c)
+          << std::dec;
+    } else {
+      oss << value[i];
+    }
+  }
+
+  return oss.str();
+}
+
+}  // namespace
+
+Stats::Stats(const std::string &mode, const std::string &filename)
+    : mode_(mode), filename_(filename), current_(0), cpu_start_(0), bytes_read_(0),
+      bytes_written_(0), text_size_(0), compressed_size_(0) {}
+
+void Stats::BeginPhase(const std::string &phase) {
+  EndPhase();
+
+  for (current_ = 0; current_ < phases_.size() && phases_[current_].name != phase; ++current_) {}
+
+  if (current_ == phases_.size()) {
+    Phase new_phase = {phase, 0, 0};
+    phases_.push_back(new_phase);
+  }
+
+  wall_start_ = std::chrono::steady_clock::now();
+  cpu_start_ = CpuSeconds();
+}
+
+void Stats::EndPhase() {
+  if (current_ >= phases_.size()) {
+    return;
+  }
+
+  phases_[current_].wall_seconds += std::chrono::duration<double>(
+      std::chrono::steady_clock::now() - wall_start_).count();
+  phases_[current_].cpu_seconds += CpuSeconds() - cpu_start_;
+  current_ = phases_.size();
+}
+
+std::string Stats::Format(StatsFormat format) {
+  EndPhase();
+
+  double ratio = text_size_ > 0 ? static_cast<double>(compressed_size_) / text_size_ : 0;
+  long peak_rss_kb = PeakRssKb();
+  std::ostringstream oss;
+  oss << std::fixed << std::setprecision(3);
+
+  if (format == StatsFormat::kJson) {
+    oss << "{\"mode\": \"" << mode_ << "\", \"file\": \"" << EscapeJson(filename_)
+        << "\", \"phases\": [";
+
+    for (size_t i = 0; i < phases_.size(); ++i) {
+      oss << (i > 0 ? ", " : "") << "{\"name\": \"" << phases_[i].name << "\", \"wall_ms\": "
+          << 1e3 * phases_[i].wall_seconds << ", \"cpu_ms\": " << 1e3 * phases_[i].cpu_seconds
+          << "}";
+    }
+
+    oss << "], \"peak_rss_kb\": " << peak_rss_kb << ", \"bytes_read\": " << bytes_read_
+        << ", \"bytes_written\": " << bytes_written_ << ", \"text_size\": " << text_size_
+        << ", \"compressed_size\": " << compressed_size_ << ", \"compression_ratio\": "
+        << std::setprecision(4) << ratio << "}\n";
+  } else {
+    oss << mode_ << " " << filename_ << ":\n";
+
+    for (size_t i = 0; i < phases_.size(); ++i) {
+      oss << "  " << std::setw(10) << std::left << phases_[i].name << std::right
+          << std::setw(12) << 1e3 * phases_[i].wall_seconds << " ms wall"
+          << std::setw(12) << 1e3 * phases_[i].cpu_seconds << " ms cpu\n";
+    }
+
+    oss << "  peak RSS: " << peak_rss_kb << " KB, read: " << bytes_read_ << " bytes, written: "
+        << bytes_written_ << " bytes\n";
+
+    if (text_size_ > 0) {
+      oss << "  text: " << text_size_ << " bytes, compressed: " << compressed_size_
+          << " bytes, ratio: " << std::setprecision(4) << ratio << "\n";
+    }
+  }
+
+  std::string result = oss.str();
+  result.pop_back();  // Last line feed.
+
+  return result;
+}
+
+void ResetPeakRss() {
+  std::ofstream clear_refs("/proc/self/clear_refs");
+  clear_refs << "5";
+}
+
+long PeakRssKb() {
+  std::ifstream status("/proc/self/status");
+  std::string line;
+
+  while (std::getline(status, line)) {
+    if (line.compare(0, 6, "VmHWM:") == 0) {
+      return std::strtol(line.c_str() + 6, nullptr, 10);
+    }
+  }
+
+  rusage usage;
+  getrusage(RUSAGE_SELF, &usage);
+
+  return usage.ru_maxrss;
+}
+
+}  // namespace ipmt
@@ -1,43 +1,290 @@
 #include "sufarray.h"
 
 #include <algorithm>
+#include <limits>
+#include <utility>
+
+#include "parallel.h"
 
 namespace ipmt {
+namespace {
+
+// Symbol accessor for the input text of SA-IS. It appends a virtual sentinel to the text, so
+// symbol 0 is reserved to it and every byte c is mapped to c + 1.
+class SentinelText {
+ public:
+  explicit SentinelText(const std::string &text) : text_(text) {}
+
+  int operator[](size_t i) const {
+    return i < text_.size() ? static_cast<unsigned char>(text_[i]) + 1 : 0;
+  }
+
+  static const int kAlphabetSize = 257;
+
+ private:
+  const std::string &text_;
+};
+
+// Type array of SA-IS, one bit per suffix: true iff the suffix is S-type.
+class TypeArray {
+ public:
+  explicit TypeArray(size_t n) : bits_(n) {}
+
+  bool IsS(size_t i) const { return bits_[i]; }
+  bool IsLMS(int64_t i) const { return i > 0 && bits_[i] && !bits_[i - 1]; }
+  void Set(size_t i, bool s_type) { bits_[i] = s_type; }
+
+ private:
+  std::vector<bool> bits_;
+};
+
+template <typename Text, typename Index>
+void GetBuckets(const Text &s, Index n, Index k, bool end, std::vector<Index> *bkt) {
+  std::fill(bkt->begin(), bkt->end(), 0);
+  for (Index i = 0; i < n; ++i) ++(*bkt)[s[i]];
+
+  Index sum = 0;
+  for (Index c = 0; c < k; ++c) {
+    sum += (*bkt)[c];
+    (*bkt)[c] = end ? sum : sum - (*bkt)[c];
+  }
+}
+
+template <typename Text, typename Index>
+void InduceL(const Text &s, const TypeArray &t, Index n, Index k, Index *sa,
+             std::vector<Index> *bkt) {
+  GetBuckets(s, n, k, false, bkt);
+
+  for (Index i = 0; i < n; ++i) {
+    Index j = sa[i] - 1;
+    if (j >= 0 && !t.IsS(j)) sa[(*bkt)[s[j]]++] = j;
+  }
+}
+
+template <typename Text, typename Index>
+void InduceS(const Text &s, const TypeArray &t, Index n, Index k, Index *sa,
+             std::vector<Index> *bkt) {
+  GetBuckets(s, n, k, true, bkt);
+
+  for (Index i = n - 1; i >= 0; --i) {
+    Index j = sa[i] - 1;
+    if (j >= 0 && t.IsS(j)) sa[--(*bkt)[s[j]]] = j;
+  }
+}
+
+// Nong, Zhang and Chan's induced sorting algorithm (SA-IS), 2009. The last symbol of s must be a
+// unique sentinel, smaller than any other symbol of s. The reduced problem is stored in the unused
+// space of sa, so the only extra memory is the type array and the buckets.
+template <typename Text, typename Index>
+void InducedSort(const Text &s, Index n, Index k, Index *sa) {
+  // Classify suffixes into S-type and L-type.
+  TypeArray t(n);
+  t.Set(n - 1, true);
+  for (Index i = n - 2; i >= 0; --i) {
+    t.Set(i, s[i] < s[i + 1] || (s[i] == s[i + 1] && t.IsS(i + 1)));
+  }
+
+  // Stage 1: sort LMS-substrings.
+  std::vector<Index> bkt(k);
+  GetBuckets(s, n, k, true, &bkt);
+  std::fill_n(sa, n, -1);
+
+  for (Index i = 1; i < n; ++i) {
+    if (t.IsLMS(i)) sa[--bkt[s[i]]] = i;
+  }
+
+  InduceL(s, t, n, k, sa, &bkt);
+  InduceS(s, t, n, k, sa, &bkt);
+
+  // Compact sorted LMS-substrings into the first n1 entries of sa.
+  Index n1 = 0;
+  for (Index i = 0; i < n; ++i) {
+    if (t.IsLMS(sa[i])) sa[n1++] = sa[i];
+  }
+
+  // Name LMS-substrings. Since no two LMS positions are adjacent, position p gets stored at
+  // sa[n1 + p / 2] without collisions.
+  std::fill(sa + n1, sa + n, -1);
+  Index name = 0;
+  Index prev = -1;
+
+  for (Index i = 0; i < n1; ++i) {
+    Index pos = sa[i];
+    bool diff = false;
+
+    for (Index d = 0; d < n; ++d) {
+      if (prev == -1 || s[pos + d] != s[prev + d] || t.IsS(pos + d) != t.IsS(prev + d)) {
+        diff = true;
+        break;
+      } else if (d > 0 && (t.IsLMS(pos + d) || t.IsLMS(prev + d))) {
+        break;
+      }
+    }
+
+    if (diff) {
+      ++name;
+      prev = pos;
+    }
+
+    sa[n1 + pos / 2] = name - 1;
+  }
+
+  for (Index i = n - 1, j = n - 1; i >= n1; --i) {
+    if (sa[i] >= 0) sa[j--] = sa[i];
+  }
+
+  // Stage 2: sort the reduced string, recursing if names are not yet unique.
+  Index *sa1 = sa;
+  Index *s1 = sa + n - n1;
+
+  if (name < n1) {
+    InducedSort(static_cast<const Index*>(s1), n1, name, sa1);
+  } else {
+    for (Index i = 0; i < n1; ++i) sa1[s1[i]] = i;
+  }
+
+  // Stage 3: induce the final suffix array from the sorted LMS-suffixes.
+  for (Index i = 1, j = 0; i < n; ++i) {
+    if (t.IsLMS(i)) s1[j++] = i;
+  }
+
+  for (Index i = 0; i < n1; ++i) sa1[i] = s1[sa1[i]];
+  std::fill(sa + n1, sa + n, -1);
+
+  GetBuckets(s, n, k, true, &bkt);
+  for (Index i = n1 - 1; i >= 0; --i) {
+    Index j = sa[i];
+    sa[i] = -1;
+    sa[--bkt[s[j]]] = j;
+  }
+
+  InduceL(s, t, n, k, sa, &bkt);
+  InduceS(s, t, n, k, sa, &bkt);
+}
+
+// Computes min(lcp[left + 1..right]), i.e. the LCP between the suffixes at the boundaries left and
+// right of a binary search interval, and fills the search arrays for every midpoint inside it.
+// Both boundaries may be virtual (-1 and n), whose LCP with any suffix is 0.
+uint64_t FillSearchLcp(int64_t left, int64_t right, const PackedArray &lcp, SearchLcp *search_lcp,
+                       PageReleaser *releaser) {
+  int64_t n = static_cast<int64_t>(lcp.size());
+
+  if (right - left == 1) {
+    // The arrays are gone through from left to right, an entry of each at a time.
+    if (releaser) releaser->Advance(3 * sizeof(uint64_t));
+    return right < n ? lcp[right] : 0;
+  }
+
+  int64_t mid = left + (right - left) / 2;
+  uint64_t left_lcp = FillSearchLcp(left, mid, lcp, search_lcp, releaser);
+  uint64_t right_lcp = FillSearchLcp(mid, right, lcp, search_lcp, releaser);
+
+  search_lcp->llcp.Set(mid, left_lcp);
+  search_lcp->rlcp.Set(mid, right_lcp);
+
+  return std::min(left_lcp, right_lcp);
+}
+
+// Kasai et al. algorithm, 2001, in the form of Karkkainen, Manzini and Puglisi's Phi algorithm,
+// 2009: the LCP of each suffix with the one before it in the suffix array is computed in text
+// order, on an array which holds that previous suffix and is overwritten by the LCP. Besides the
+// packed result, that array is the only one allocated, where Kasai's needs a rank and an LCP array.
+template <typename Index>
+PackedArray PhiLcp(const std::string &text, const PackedArray &suffix_array) {
+  Index n = static_cast<Index>(suffix_array.size());
+  if (n == 0) return PackedArray(0, 1);
+
+  std::vector<Index> plcp(n);
+  plcp[suffix_array[0]] = -1;
+  for (Index i = 1; i < n; ++i) {
+    plcp[suffix_array[i]] = static_cast<Index>(suffix_array[i - 1]);
+  }
+
+  Index h = 0;
+  Index max_lcp = 0;
+
+  for (Index i = 0; i < n; ++i) {
+    Index j = plcp[i];
+
+    if (j >= 0) {
+      while (i + h < n && j + h < n && text[i + h] == text[j + h]) ++h;
+
+      plcp[i] = h;
+      max_lcp = std::max(max_lcp, h);
+      if (h > 0) --h;
+    } else {
+      plcp[i] = 0;
+      h = 0;
+    }
+  }
+
+  PackedArray lcp(n, PackedArray::RequiredWidth(max_lcp));
+  for (Index i = 0; i < n; ++i) {
+    lcp.Set(i, plcp[suffix_array[i]]);
+  }
+
+  return lcp;
+}
+
+// Linear time. The suffix array is sorted on the words of the packed array, as 4n bytes (8n bytes
+// for texts larger than 2 GiB), plus n bits for the type array, and then packed in place: each
+// entry ends before the integer of the next one starts, so it only overwrites entries already
+// packed. The sentinel suffix is always the first one, so we just skip it.
+template <typename Index>
+PackedArray SAIS(const std::string &text) {
+  size_t n = text.size();
+
+  std::vector<uint64_t> words(((n + 1) * sizeof(Index) + sizeof(uint64_t) - 1) /
+                              sizeof(uint64_t) + 1);
+  Index *sa = reinterpret_cast<Index*>(words.data());
+  InducedSort(SentinelText(text), static_cast<Index>(n + 1),
+              static_cast<Index>(SentinelText::kAlphabetSize), sa);
+
+  int width = PackedArray::RequiredWidth(n > 0 ? n - 1 : 0);
+  PackedArray packed = PackedArray::MutableView(words.data(), n, width);
+  for (size_t i = 0; i < n; ++i) {
+    packed.Set(i, sa[i + 1]);
+  }
+
+  return PackedArray(std::move(words), n, width);
+}
 
-// TODO(Mateus/Valdemir): we do not use LCP's info on this implementation, so it's not as efficient
-// as it could be on search stage.
 // Manber and Myers algorithm, 1991.
-std::vector<int> BuildSuffixArray(const std::string &text) {
-  int n = static_cast<int>(text.size());
+template <typename Index>
+std::vector<Index> ManberMyers(const std::string &text) {
+  Index n = static_cast<Index>(text.size());
+  if (n == 0) return std::vector<Index>();
 
-  std::vector<int> pos(n);  // Final suffix array.
-  std::vector<int> prm(n);  // prm = pos ** (-1).
+  std::vector<Index> pos(n);  // Final suffix array.
+  std::vector<Index> prm(n);  // prm = pos ** (-1).
   std::vector<bool> bh(n);  // bh[i] == true iff pos[i] contains the leftmost suffix of a h-bucket.
 
   // Auxiliar arrays.
-  std::vector<int> count(n);
+  std::vector<Index> count(n);
   std::vector<bool> b2h(n);
 
   // Sorting base case.
-  for (int i = 0; i < n; ++i) {
+  for (Index i = 0; i < n; ++i) {
     pos[i] = i;
   }
 
-  std::sort(pos.begin(), pos.end(), [&text] (int i, int j) -> bool { return text[i] < text[j]; });
+  std::sort(pos.begin(), pos.end(), [&text] (Index i, Index j) -> bool {
+    return static_cast<unsigned char>(text[i]) < static_cast<unsigned char>(text[j]);
+  });
 
   bh[0] = true;
-  for (int i = 1; i < n; ++i) {
+  for (Index i = 1; i < n; ++i) {
     bh[i] = text[pos[i-1]] != text[pos[i]];
   }
 
   std::fill(b2h.begin(), b2h.end(), false);
-  std::vector<int> next_suffix(n);  // Gets next suffix on a h-bucket.
+  std::vector<Index> next_suffix(n);  // Gets next suffix on a h-bucket.
 
   // Inductive step.
-  for (int h = 1; h < n; h <<= 1) {
-    int i = 0;
-    int j = 1;
-    int num_buckets = 0;
+  for (Index h = 1; h < n; h <<= 1) {
+    Index i = 0;
+    Index j = 1;
+    Index num_buckets = 0;
 
     while (i < n) {
       // Get next suffix such that text[pos[i]] !=_h text[pos[j]].
@@ -53,21 +300,21 @@ std::vector<int> BuildSuffixArray(const std::string &text) {
       break;
     }
 
-    for (int i = 0; i < n; i = next_suffix[i]) {
+    for (Index i = 0; i < n; i = next_suffix[i]) {
       count[i] = 0;
-      for (int c = i; c < next_suffix[i]; ++c) {
+      for (Index c = i; c < next_suffix[i]; ++c) {
         prm[pos[c]] = i;
       }
     }
 
-    int d = n - h;
-    int e = prm[d];
+    Index d = n - h;
+    Index e = prm[d];
     prm[d] = e + count[e];
     ++count[e];
     b2h[prm[d]] = true;
 
-    for (int i = 0; i < n; i = next_suffix[i]) {
-      for (int c = i; c < next_suffix[i]; ++c) {
+    for (Index i = 0; i < n; i = next_suffix[i]) {
+      for (Index c = i; c < next_suffix[i]; ++c) {
         d = pos[c] - h;
 
         if (d >= 0) {
@@ -78,18 +325,18 @@ std::vector<int> BuildSuffixArray(const std::string &text) {
         }
       }
 
-      for (int c = i; c < next_suffix[i]; ++c) {
+      for (Index c = i; c < next_suffix[i]; ++c) {
         d = pos[c] - h;
 
         if (d >= 0 && b2h[prm[d]]) {
-          for (int f = prm[d] + 1; !bh[f] && b2h[f]; ++f) {
+          for (Index f = prm[d] + 1; f < n && !bh[f] && b2h[f]; ++f) {
             b2h[f] = false;
           }
         }
       }
     }
     
-    for (int i = 0; i < n; ++i) {
+    for (Index i = 0; i < n; ++i) {
       pos[prm[i]] = i;
       bh[i] = bh[i] || b2h[i];
     }
@@ -98,5 +345,202 @@ std::vector<int> BuildSuffixArray(const std::string &text) {
   return pos;
 }
 
-}  // namespace ipmt
+// Suffix of the parallel prefix doubling, with the ranks of its first h characters and of the h
+// characters after them.
+template <typename Index>
+struct DoublingEntry {
+  Index rank;
+  Index next_rank;
+  Index suffix;
+};
+
+// Ranks the sorted entries of the suffixes whose order is not settled yet. All suffixes of a group
+// (same rank) are among them, and the group takes the positions of the suffix array starting at
+// its rank, so each suffix is ranked at its group's rank plus the number of entries of the group
+// before the first one with its same pair of ranks. On the first round, the entries hold every
+// suffix, ranked by their first characters, and form a single group. Then drops the suffixes which
+// got a rank of their own.
+template <typename Index>
+void RankEntries(bool first_round, std::vector<DoublingEntry<Index>> *entries,
+                 std::vector<Index> *rank, int num_threads) {
+  std::vector<DoublingEntry<Index>> &e = *entries;
+  size_t size = e.size();
+
+  auto is_group_start = [&](size_t j) {
+    return j == 0 || (!first_round && e[j].rank != e[j - 1].rank);
+  };
+  auto is_head = [&](size_t j) {
+    return j == 0 || e[j].rank != e[j - 1].rank || e[j].next_rank != e[j - 1].next_rank;
+  };
+
+  // Each chunk finds its last group start and head, so the next chunk knows those of its first
+  // entries, and counts the entries it keeps.
+  std::vector<size_t> last_start(num_threads, 0);
+  std::vector<size_t> last_head(num_threads, 0);
+  std::vector<size_t> num_kept(num_threads + 1, 0);
+
+  ParallelFor(num_threads, size, [&](int t, size_t begin, size_t end) {
+    for (size_t j = begin; j < end; ++j) {
+      if (is_group_start(j)) last_start[t] = j;
+      if (is_head(j)) last_head[t] = j;
+      if (!is_head(j) || (j + 1 < size && !is_head(j + 1))) ++num_kept[t + 1];
+    }
+  });
+
+  for (int t = 1; t < num_threads; ++t) {
+    last_start[t] = std::max(last_start[t], last_start[t - 1]);
+    last_head[t] = std::max(last_head[t], last_head[t - 1]);
+    num_kept[t + 1] += num_kept[t];
+  }
+
+  std::vector<DoublingEntry<Index>> kept(num_kept[num_threads]);
+
+  ParallelFor(num_threads, size, [&](int t, size_t begin, size_t end) {
+    size_t start = t > 0 ? last_start[t - 1] : 0;
+    size_t head = t > 0 ? last_head[t - 1] : 0;
+    size_t k = num_kept[t];
+
+    for (size_t j = begin; j < end; ++j) {
+      if (is_group_start(j)) start = j;
+      if (is_head(j)) head = j;
+
+      Index base = first_round ? 0 : e[j].rank;
+      (*rank)[e[j].suffix] = base + static_cast<Index>(head - start);
+
+      if (!is_head(j) || (j + 1 < size && !is_head(j + 1))) kept[k++] = e[j];
+    }
+  });
+
+  entries->swap(kept);
+}
+
+// Prefix doubling on num_threads threads. Each round sorts the suffixes by the ranks of their first
+// h and next h characters with a parallel sort and ranks them again, doubling h; only suffixes
+// sharing their rank with others take part in later rounds. The first round ranks 6 characters,
+// 3 per rank. O(n log n) work per round and O(log n) rounds, with up to 8n integers of memory.
+template <typename Index>
+std::vector<Index> ParallelDoubling(const std::string &text, int num_threads) {
+  typedef DoublingEntry<Index> Entry;
+
+  Index n = static_cast<Index>(text.size());
+  std::vector<Entry> entries(n);
+  std::vector<Index> rank(n);
+
+  // 9 bits per character, so the end of the text ranks below any byte.
+  auto pack = [&text, n](Index i) {
+    Index value = 0;
+    for (Index k = i; k < i + 3; ++k) {
+      value = value << 9 | (k < n ? static_cast<unsigned char>(text[k]) + 1 : 0);
+    }
+    return value;
+  };
+
+  ParallelFor(num_threads, n, [&](int, size_t begin, size_t end) {
+    for (size_t i = begin; i < end; ++i) {
+      Entry entry = {pack(i), pack(i + 3), static_cast<Index>(i)};
+      entries[i] = entry;
+    }
+  });
+
+  auto by_ranks = [](const Entry &lhs, const Entry &rhs) {
+    return lhs.rank < rhs.rank || (lhs.rank == rhs.rank && lhs.next_rank < rhs.next_rank);
+  };
+
+  ParallelSort(&entries, by_ranks, num_threads);
+  RankEntries(true, &entries, &rank, num_threads);
 
+  for (int64_t h = 6; !entries.empty(); h *= 2) {
+    // Suffixes shorter than h + 1 characters rank below all others on their second half.
+    ParallelFor(num_threads, entries.size(), [&](int, size_t begin, size_t end) {
+      for (size_t j = begin; j < end; ++j) {
+        Index i = entries[j].suffix;
+        entries[j].rank = rank[i];
+        entries[j].next_rank = i + h < n ? rank[i + h] + 1 : 0;
+      }
+    });
+
+    ParallelSort(&entries, by_ranks, num_threads);
+    RankEntries(false, &entries, &rank, num_threads);
+  }
+
+  // Every suffix has a rank of its own, which is its position.
+  std::vector<Index> sa(n);
+  ParallelFor(num_threads, n, [&](int, size_t begin, size_t end) {
+    for (size_t i = begin; i < end; ++i) {
+      sa[rank[i]] = static_cast<Index>(i);
+    }
+  });
+
+  return sa;
+}
+
+// Returns true iff the suffix array of the input text may be built with 32-bit signed integers
+// (SA-IS also stores a sentinel suffix).
+bool FitsInInt(const std::string &text) {
+  return text.size() < static_cast<size_t>(std::numeric_limits<int>::max());
+}
+
+}  // namespace
+
+// Returns lcp, where lcp[i] is the length of the longest common prefix between the suffixes at
+// positions i - 1 and i of the suffix array, and lcp[0] = 0.
+PackedArray BuildLcpArray(const std::string &text, const PackedArray &suffix_array) {
+  if (FitsInInt(text)) {
+    return PhiLcp<int>(text, suffix_array);
+  } else {
+    return PhiLcp<int64_t>(text, suffix_array);
+  }
+}
+
+// Builds the Llcp and Rlcp arrays from the LCP array in linear time.
+SearchLcp BuildSearchLcp(const PackedArray &lcp) {
+  SearchLcp search_lcp;
+  size_t n = lcp.size();
+
+  search_lcp.llcp.Resize(n, lcp.width());
+  search_lcp.rlcp.Resize(n, lcp.width());
+  BuildSearchLcp(lcp, &search_lcp);
+
+  return search_lcp;
+}
+
+void BuildSearchLcp(const PackedArray &lcp, SearchLcp *search_lcp, PageReleaser *releaser) {
+  if (!lcp.empty()) FillSearchLcp(-1, lcp.size(), lcp, search_lcp, releaser);
+}
+
+PackedArray BuildSuffixArray(const std::string &text, SuffixArrayAlgorithm algorithm,
+                             int num_threads) {
+  if (algorithm == SuffixArrayAlgorithm::kManberMyers) {
+    return BuildSuffixArrayManberMyers(text);
+  } else if (algorithm == SuffixArrayAlgorithm::kParallelDoubling) {
+    return BuildSuffixArrayParallel(text, num_threads);
+  } else {
+    return BuildSuffixArraySAIS(text);
+  }
+}
+
+PackedArray BuildSuffixArraySAIS(const std::string &text) {
+  if (FitsInInt(text)) {
+    return SAIS<int>(text);
+  } else {
+    return SAIS<int64_t>(text);
+  }
+}
+
+PackedArray BuildSuffixArrayParallel(const std::string &text, int num_threads) {
+  if (FitsInInt(text)) {
+    return PackArray(ParallelDoubling<int>(text, num_threads));
+  } else {
+    return PackArray(ParallelDoubling<int64_t>(text, num_threads));
+  }
+}
+
+PackedArray BuildSuffixArrayManberMyers(const std::string &text) {
+  if (FitsInInt(text)) {
+    return PackArray(ManberMyers<int>(text));
+  } else {
+    return PackArray(ManberMyers<int64_t>(text));
+  }
+}
+
+}  // namespace ipmt
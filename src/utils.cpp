@@ -1,66 +1,114 @@
 #include "utils.h"
 
 #include <algorithm>
-#include <fstream>
 #include <iomanip>
 #include <iostream>
-#include <sstream>
 
 #include <glob.h>
 
-#include "dynamic_bitset.h"
-#include "huffman.h"
-#include "lz78.h"
-
 namespace ipmt {
 namespace {
 
-const std::string kANSIRedColor = "\033[31m";
-const std::string kANSIResetAll = "\033[0m";
-
-void SplitFilename(const std::string &pathname, std::string *filename, std::string *dir) {
-  size_t index = pathname.find_last_of("/\\");
+// Manber and Myers' search algorithm, 1991. If upper is false, returns the first position of the
+// suffix array whose suffix is not smaller than the pattern; otherwise, returns the first position
+// whose suffix is greater than the pattern and does not have it as a prefix. Since the LCP between
+// the pattern and both interval boundaries is known, characters already matched are never
+// compared again, so the search takes O(m + log n) time.
+template <typename Text>
+int64_t SearchBoundary(const std::string &pattern, const Text &text,
+                       const PackedArray &suffix_array, const SearchLcp &search_lcp,
+                       bool upper) {
+  int64_t left = -1;
+  int64_t right = static_cast<int64_t>(suffix_array.size());
+  size_t l = 0;  // LCP between the pattern and the suffix at left.
+  size_t r = 0;  // LCP between the pattern and the suffix at right.
+
+  while (right - left > 1) {
+    int64_t mid = left + (right - left) / 2;
+    size_t j;
+    bool is_smaller;
+
+    if (l >= r) {
+      size_t llcp = search_lcp.llcp[mid];
+
+      if (llcp > l) {
+        left = mid;
+        continue;
+      } else if (llcp < l) {
+        right = mid;
+        r = llcp;
+        continue;
+      }
 
-  *filename = index == std::string::npos ? pathname : pathname.substr(index + 1);
-  *dir = index == std::string::npos ? "" : pathname.substr(0, index) + "/";
-}
+      j = MatchPrefix(pattern, pattern.size(), text, suffix_array[mid], l, &is_smaller);
+    } else {
+      size_t rlcp = search_lcp.rlcp[mid];
+
+      if (rlcp > r) {
+        right = mid;
+        continue;
+      } else if (rlcp < r) {
+        left = mid;
+        l = rlcp;
+        continue;
+      }
 
-std::string GetBasenameFromFilename(const std::string &filename) {
-  size_t index = filename.find_last_of(".");
-  return index == std::string::npos ? filename : filename.substr(0, index);
-}
+      j = MatchPrefix(pattern, pattern.size(), text, suffix_array[mid], r, &is_smaller);
+    }
 
-DynamicBitset ReadBitset(std::ifstream &reader) {
-  DynamicBitset bitset;
-  int bits;
-  reader.read(reinterpret_cast<char*>(&bits), sizeof(int));
+    // Whether the suffix at mid belongs to the left side of the boundary.
+    bool is_left = j == pattern.size() ? upper : is_smaller;
 
-  int quotient = bits / DynamicBitset::kWordSize;
-  int bytes = bits % DynamicBitset::kWordSize > 0 ? quotient + 1 : quotient;
-  int curr_bit = 0;
+    if (is_left) {
+      left = mid;
+      l = j;
+    } else {
+      right = mid;
+      r = j;
+    }
+  }
 
-  for (int i = 0; i < bytes; ++i) {
-    byte_t word;
-    reader.read(reinterpret_cast<char*>(&word), sizeof(byte_t));
+  return right;
+}
 
-    for (int j = DynamicBitset::kWordSize - 1; j >= 0; --j) {
-      if (curr_bit < bits) {
-        bitset.PushBack(word & (1 << j));
-        ++curr_bit;
-      }
+// Same as SearchBoundary, but with plain binary search, for index files without LCP arrays.
+template <typename Text>
+int64_t BinarySearchBoundary(const std::string &pattern, const Text &text,
+                             const PackedArray &suffix_array, bool upper) {
+  int64_t left = -1;
+  int64_t right = static_cast<int64_t>(suffix_array.size());
+
+  while (right - left > 1) {
+    int64_t mid = left + (right - left) / 2;
+    bool is_smaller;
+    size_t j = MatchPrefix(pattern, pattern.size(), text, suffix_array[mid], 0, &is_smaller);
+
+    if (j == pattern.size() ? upper : is_smaller) {
+      left = mid;
+    } else {
+      right = mid;
     }
   }
 
-  return bitset;
+  return right;
 }
 
-void WriteBitset(std::ofstream &writer, const DynamicBitset &code) {
-  int quotient = code.size() / DynamicBitset::kWordSize;
-  int bytes = code.size() % DynamicBitset::kWordSize > 0 ? quotient + 1 : quotient;
-  int bits = code.size();
+// Uses Manber and Myers' search if the LCP arrays are available (i.e. they were stored on the index
+// file); otherwise, falls back to plain binary search.
+template <typename Text>
+SuffixArrayInterval FindIntervalIn(const std::string &pattern, const Text &text,
+                                   const PackedArray &suffix_array, const SearchLcp &search_lcp) {
+  SuffixArrayInterval interval;
+
+  if (search_lcp.llcp.size() == suffix_array.size() && !suffix_array.empty()) {
+    interval.left = SearchBoundary(pattern, text, suffix_array, search_lcp, false);
+    interval.right = SearchBoundary(pattern, text, suffix_array, search_lcp, true);
+  } else {
+    interval.left = BinarySearchBoundary(pattern, text, suffix_array, false);
+    interval.right = BinarySearchBoundary(pattern, text, suffix_array, true);
+  }
 
-  writer.write(reinterpret_cast<const char*>(&bits), sizeof(int));
-  writer.write(reinterpret_cast<const char*>(code.data()), bytes);
+  return interval;
 }
 
 }  // namespace
@@ -68,83 +116,139 @@ void WriteBitset(std::ofstream &writer, const DynamicBitset &code) {
 void PrintHelp() {
   std::cout << "Usage: ipmt <mode> [options] pattern indexfile [indexfile ...], where: \n\n\t- \""
             << "<mode>\" specifies a feature implemented by this tool. Supported modes\n\tare"
-            << " \"index\" and \"search\". To see the options supported by each mode,\n\ttype"
-            << " \"ipmt <mode> -h\" or \"ipmt <mode> --help\".\n\n\t- \"pattern\" is the input"
-            << " pattern to be found on text.\n\n\t- \"indexfile\" is the index which represents"
-            << " the compressed text. More\n\tthan one index file may be specified on search mode."
+            << " \"index\", \"search\" and \"serve\". To see the options supported by each"
+            << " mode,\n\ttype \"ipmt <mode> -h\" or \"ipmt <mode> --help\".\n\n\t- \"pattern\""
+            << " is the input pattern to be found on text.\n\n\t- \"indexfile\" is the index"
+            << " which represents the compressed text. More\n\tthan one index file may be"
+            << " specified on search mode."
             << " Wildcards are also\n\tsupported on this mode." << std::endl;
 }
 
 void PrintIndexModeHelp() {
-  std::cout << "Index mode options:\n\n    -c --compression\tSpecifies the compression algorithm"
+  std::cout << "Index mode options:\n\n    -a --algorithm\tSpecifies the suffix array construction"
+            << " algorithm:\n\t\t\t\"sais\" (default), \"mm\" (Manber and Myers), \"pd\"\n"
+            << "\t\t\t(parallel prefix doubling) or \"ext\" (prefix doubling on\n"
+            << "\t\t\tdisk, for texts larger than the memory budget).\n    "
+            << std::setw(16) << std::left << "-A --append"
+            << "\tAppends the text files as new segments of the segmented\n"
+            << "\t\t\tindex of the given manifest (created if missing).\n    "
+            << std::setw(16) << std::left << "-b --blocksize"
+            << "\tCompresses the text in independent blocks of the given\n"
+            << "\t\t\tsize, in kilobytes, which search mode decodes on demand\n"
+            << "\t\t\t(0, the default, compresses the whole text at once).\n    "
+            << "-c --compression\tSpecifies the compression algorithm"
             << " used to build the\n\t\t\tindex file.\n    " << std::setw(16) << std::left
-            << "-i --indextype" << "\tDetermines the index structure to represent the text."
+            << "-C --compact" << "\tMerges small segments of the manifest given by -A (or of\n"
+            << "\t\t\tthe manifests given instead of text files) into larger\n"
+            << "\t\t\tones; --compact=full merges all of them into one.\n    "
+            << std::setw(16) << std::left << "-d --dictsize"
+            << "\tLimits the LZ78 dictionary to the given number of phrases\n"
+            << "\t\t\t(0, the default, means no limit).\n    " << std::setw(16) << std::left
+            << "-i --indextype" << "\tDetermines the index structure to represent the text:\n"
+            << "\t\t\t\"sa\" (suffix array, default) or \"fm\" (FM-index).\n    "
+            << std::setw(16) << std::left << "-j --jobs"
+            << "\tNumber of files indexed at the same time (default 1).\n    "
+            << std::setw(16) << std::left << "-m --memory"
+            << "\tMemory budget, in megabytes, shared by the files indexed\n"
+            << "\t\t\tat the same time (default: half of the physical memory).\n"
+            << "\t\t\tThe \"ext\" algorithm splits it evenly among them.\n    "
+            << std::setw(16) << std::left << "-r --dictpolicy"
+            << "\tWhat to do once the LZ78 dictionary is full: \"reset\"\n"
+            << "\t\t\t(default) empties it, \"freeze\" stops adding phrases.\n    "
+            << std::setw(16) << std::left << "-s --stats"
+            << "\tPrints the time of each phase, peak memory and I/O of\n"
+            << "\t\t\teach file to the standard error, as \"text\" (default)\n"
+            << "\t\t\tor \"json\" (--stats=json).\n    "
+            << std::setw(16) << std::left << "-t --threads"
+            << "\tThreads used by the \"pd\" and \"ext\" algorithms and by\n"
+            << "\t\t\tHuffman coding (default: all cores), split among the\n"
+            << "\t\t\tfiles indexed at the same time.\n    "
+            << std::setw(16) << std::left << "-T --tmpdir"
+            << "\tDirectory of the temporary files of the \"ext\" algorithm\n"
+            << "\t\t\t(default: the directory of each text file)."
             << std::endl;
 }
 
 void PrintSearchModeHelp() {
   std::cout << "Search mode options:\n\n    " << std::setw(12) << std::left << "-c --count"
             << "\tPrint only the number of occurrences of the pattern(s)\n\t\t\tin the text.\n    "
+            << std::setw(12) << std::left << "-e --edits"
+            << "\tFinds occurrences within the given number of insertions,\n\t\t\tdeletions and"
+            << " substitutions (counted by start).\n    "
+            << std::setw(12) << std::left << "-E --regex"
+            << "\tInterprets the pattern(s) as extended regular expressions,\n\t\t\tmatched"
+            << " within each line as by grep -E.\n    "
+            << std::setw(12) << std::left << "-f --first"
+            << "\tSame as --limit 1.\n    "
+            << std::setw(12) << std::left << "-k --mismatches"
+            << "\tFinds occurrences with up to the given number of\n\t\t\tmismatched"
+            << " characters.\n    "
+            << std::setw(12) << std::left << "-l --limit"
+            << "\tCounts or prints only the first N occurrences of each\n\t\t\tpattern in text"
+            << " order. The search does not stop early:\n\t\t\tall occurrences are located (with"
+            << " -E, -e or -k, even\n\t\t\twhen counted) and then cut to N.\n    "
+            << "-n --line-number\tPrefix each line printed with its line number.\n    "
             << "-p --pattern\tIf this option is enabled, then the \"pattern\" argument\n\t\t\twill"
             << " be interpreted as a text file containing all the\n\t\t\tpatterns to be found in"
-            << " the text." << std::endl;
+            << " the text.\n    " << std::setw(12) << std::left << "-s --stats"
+            << "\tPrints the time of each phase, peak memory and I/O of\n\t\t\teach index file to"
+            << " the standard error, as \"text\"\n\t\t\t(default) or \"json\" (--stats=json).\n    "
+            << std::setw(12) << std::left << "-t --threads"
+            << "\tThreads used to decode the text and search the patterns\n\t\t\t(default: all"
+            << " cores).\n\nIndex files may"
+            << " also be manifests of segmented indexes (see index mode -A),\nwhich are searched"
+            << " as if their text were indexed whole." << std::endl;
 }
 
-std::vector<int> GetOccurrences(const std::string &pattern, const std::string &text,
-                                const std::vector<int> &suffix_array) {
-  auto leqm = [&text] (int i, const std::string &pattern) -> bool {
-    return text.compare(i, pattern.size(), pattern) < 0;
-  };
-
-  auto geqm = [&text] (const std::string &pattern, int i) -> bool {
-    return text.compare(i, pattern.size(), pattern) > 0;
-  };
-
-  std::vector<int> occurrences;
-  auto l = lower_bound(suffix_array.begin(), suffix_array.end(), pattern, leqm);
-  auto r = upper_bound(l, suffix_array.end(), pattern, geqm);
-  occurrences.reserve(r - l);
-
-  for (auto it = l; it != r; ++it) {
-    occurrences.push_back(*it);
-  }
-
-  std::sort(occurrences.begin(), occurrences.end());
-
-  return occurrences;
+void PrintServeModeHelp() {
+  std::cout << "Usage: ipmt serve [options] indexfile [indexfile ...]\n\nKeeps the index files"
+            << " loaded and answers one request per line:\n\n    count <pattern>\tNumber of"
+            << " occurrences of the pattern.\n    search <pattern>\tLines of the text with"
+            << " occurrences of the pattern,\n\t\t\thighlighted as in search mode.\n    quit"
+            << "\t\t\tCloses the connection.\n\nEach response ends with \"OK <occurrences>"
+            << " <microseconds>\" or\n\"ERR <message>\". Index files changed on disk are loaded"
+            << " again. Index files may\nalso be manifests of segmented indexes (see index mode"
+            << " -A).\n\nServe mode options:\n\n    "
+            << std::setw(12) << std::left << "-n --line-number"
+            << "\tPrints the line number of each line of search\n\t\t\tresponses.\n    "
+            << std::setw(12) << std::left << "-s --socket"
+            << "\tListens on the given Unix domain socket instead of\n\t\t\treading requests"
+            << " from the standard input." << std::endl;
 }
 
-std::string PrintOccurrences(const std::vector<int> &occurrences, const std::string &text,
-                             size_t pattern_length) {
-  std::ostringstream oss;
-  size_t curr_pos = 0;
-  size_t j = 0;
-
-  while (curr_pos != std::string::npos && j < occurrences.size()) {
-    size_t lf_index = text.find_first_of("\n", curr_pos);
-    size_t occ = occurrences[j];
+SuffixArrayInterval FindInterval(const std::string &pattern, const std::string &text,
+                                 const PackedArray &suffix_array, const SearchLcp &search_lcp) {
+  return FindIntervalIn(pattern, text, suffix_array, search_lcp);
+}
 
-    // Print all occurrences of the specified pattern in the current line.
-    if (curr_pos <= occ && occ < lf_index) {
-      while (true) {
-        oss << text.substr(curr_pos, occ - curr_pos) << kANSIRedColor
-            << text.substr(occ, pattern_length) << kANSIResetAll;
-        if (j + 1 == occurrences.size()) break;
+// Only the blocks of the suffixes compared by the binary search are decoded.
+SuffixArrayInterval FindInterval(const std::string &pattern, const BlockText &text,
+                                 const PackedArray &suffix_array, const SearchLcp &search_lcp) {
+  return FindIntervalIn(pattern, text, suffix_array, search_lcp);
+}
 
-        size_t next_occ = occurrences[++j];
-        if (occ + pattern_length > next_occ || next_occ >= lf_index) break;
+OccurrenceRange FindOccurrences(const std::string &pattern, const std::string &text,
+                                const PackedArray &suffix_array, const SearchLcp &search_lcp) {
+  SuffixArrayInterval interval = FindIntervalIn(pattern, text, suffix_array, search_lcp);
+  return OccurrenceRange(suffix_array, interval.left, interval.right);
+}
 
-        curr_pos = occ + pattern_length;
-        occ = next_occ;
-      }
+OccurrenceRange FindOccurrences(const std::string &pattern, const BlockText &text,
+                                const PackedArray &suffix_array, const SearchLcp &search_lcp) {
+  SuffixArrayInterval interval = FindIntervalIn(pattern, text, suffix_array, search_lcp);
+  return OccurrenceRange(suffix_array, interval.left, interval.right);
+}
 
-      oss << text.substr(occ + pattern_length, lf_index - (occ + pattern_length)) << std::endl;
-    }
-    
-    curr_pos = lf_index != std::string::npos ? lf_index + 1 : lf_index;
-  }
+std::vector<size_t> GetOccurrences(const std::string &pattern, const std::string &text,
+                                   const PackedArray &suffix_array,
+                                   const SearchLcp &search_lcp, size_t limit) {
+  return FindOccurrences(pattern, text, suffix_array, search_lcp).Sorted(limit);
+}
 
-  return oss.str();
+std::vector<size_t> GetOccurrences(const std::string &pattern, const BlockText &text,
+                                   const PackedArray &suffix_array,
+                                   const SearchLcp &search_lcp, size_t limit) {
+  return FindOccurrences(pattern, text, suffix_array, search_lcp).Sorted(limit);
 }
 
 std::vector<std::string> GetFilenames(const std::string &pattern) {
@@ -163,142 +267,4 @@ std::vector<std::string> GetFilenames(const std::string &pattern) {
   return filenames;
 }
 
-int ReadIndexFile(const std::string &index_filename, std::string *text,
-                   std::vector<int> *suffix_array) {
-  std::ifstream reader(index_filename, std::ifstream::binary);
-  if (!reader) {  // Cannot open file.
-    return -1;
-  }
-
-  // Build suffix array.
-  size_t suff_array_size;
-  reader.read(reinterpret_cast<char*>(&suff_array_size), sizeof(size_t));
-  suffix_array->reserve(suff_array_size);
-
-  for (size_t i = 0; i < suff_array_size; ++i) {
-    int suff_array_entry;
-    reader.read(reinterpret_cast<char*>(&suff_array_entry), sizeof(int));
-    suffix_array->push_back(suff_array_entry);
-  }
-
-  std::string compression_type;
-  std::string decoded_text;
-  std::getline(reader, compression_type);
-
-  if (!compression_type.compare("huffman")) {
-    // Read code table.
-    ipmt::CodeTable code_table;
-    size_t table_size;
-    reader.read(reinterpret_cast<char*>(&table_size), sizeof(size_t));
-
-    for (size_t i = 0; i < table_size; ++i) {
-      char key;
-      reader.read(&key, sizeof(char));
-      DynamicBitset codeword = ReadBitset(reader);
-
-      code_table[key] = codeword;
-    }  
-
-    DynamicBitset code = ReadBitset(reader);
-    reader.close();
-
-    // Build tree from code table and decode index file's text.
-    ipmt::HuffmanHeapNode *root = ipmt::BuildTreeFromTable(code_table);
-    *text = ipmt::HuffmanDecode(code, root);
-    delete root;
-  } else if (!compression_type.compare("lz78")) {
-    // Read code size.
-    size_t code_size;
-    reader.read(reinterpret_cast<char*>(&code_size), sizeof(size_t));
-
-    std::vector<std::pair<int, char>> code;
-    code.reserve(code_size);
-
-    for (size_t i = 0; i < code_size; ++i) {
-      int j;
-      char c;
-
-      reader.read(reinterpret_cast<char*>(&j), sizeof(int));
-      reader.read(&c, sizeof(char));
-
-      code.push_back(std::make_pair(j, c));
-    }
-
-    // Decode text.
-    *text = ipmt::LZ78Decode(code);
-  } else {  // Invalid compression type.
-    return -2;
-  }
-
-  return 0;
-}
-
-void WriteIndexFile(const std::string &pathname, const std::vector<int> &suffix_array,
-                    const std::string &text, const CompressionType &type) {
-  std::string filename, dir;
-
-  SplitFilename(pathname, &filename, &dir);
-
-  std::string index_path = dir + GetBasenameFromFilename(filename) + ".idx";
-  std::ofstream writer(index_path, std::ofstream::binary);
-
-  // Write suffix array content to index file.
-  size_t suff_array_size = suffix_array.size();
-  writer.write(reinterpret_cast<const char*>(&suff_array_size), sizeof(size_t));
-
-  for (size_t i = 0; i < suff_array_size; ++i) {
-    writer.write(reinterpret_cast<const char*>(&suffix_array[i]), sizeof(int));
-  }
-
-  // Write which compression algorithm was used.
-  if (type == CompressionType::kHuffman) {
-    writer << "huffman" << std::endl;
-
-    ipmt::DynamicBitset code;
-    ipmt::CodeTable code_table;
-    ipmt::HuffmanEncode(text, &code, &code_table);
-
-//    double ratio = static_cast<double>(code.size()) / (DynamicBitset::kWordSize * text.size());
-
-//    std::cout << "Uncompressed text size: " << text.size() << " bytes." << std::endl;
-//    std::cout << "Compressed text size: " << code.size() / DynamicBitset::kWordSize << " bytes."
-//              << std::endl;
-//    std::cout << "Compression ratio: " << ratio << std::endl;
-
-    // Write code table.
-    size_t code_table_size = code_table.size();
-    writer.write(reinterpret_cast<const char*>(&code_table_size), sizeof(size_t));
-
-    for (auto it = code_table.begin(); it != code_table.end(); ++it) {
-      writer.write(&it->first, sizeof(char));
-      WriteBitset(writer, it->second);
-    }
-
-    // Write encoded text.
-    WriteBitset(writer, code);
-  } else {  // type == CompressionType::kLZ78.
-    writer << "lz78" << std::endl;
-
-    std::vector<std::pair<int, char>> code;
-    ipmt::LZ78Encode(text, &code);
-
-//    double ratio = static_cast<double>((sizeof(int) + sizeof(char)) * code.size()) / text.size();
-
-//    std::cout << "Uncompressed text size: " << text.size() << " bytes." << std::endl;
-//    std::cout << "Compressed text size: " << (sizeof(int) + sizeof(char)) * code.size() 
-//              << " bytes." << std::endl;
-//    std::cout << "Compression ratio: " << ratio << std::endl;
-
-    // Write encoded text.
-    size_t code_size = code.size();
-    writer.write(reinterpret_cast<const char*>(&code_size), sizeof(size_t));
-
-    for (size_t i = 0; i < code_size; ++i) {
-      writer.write(reinterpret_cast<const char*>(&code[i].first), sizeof(int));
-      writer.write(&code[i].second, sizeof(char));
-    }
-  }
-}
-
 }  // namespace ipmt
-
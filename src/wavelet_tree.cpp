@@ -0,0 +1,103 @@
+#include "wavelet_tree.h"
+
+#include <algorithm>
+
+namespace ipmt {
+
+void WaveletTree::Append(const std::vector<uint8_t> &codes, int levels,
+                         std::vector<uint64_t> *out) {
+  size_t n = codes.size();
+  std::vector<uint8_t> current = codes;
+  std::vector<uint8_t> next(n);
+  std::vector<uint64_t> bits((n + 63) / 64);
+
+  // Reserve the number of zeros of each level, which are known only after the level is built.
+  size_t zeros_offset = out->size();
+  out->resize(out->size() + levels);
+
+  for (int l = 0; l < levels; ++l) {
+    int shift = levels - l - 1;
+    size_t zeros = 0;
+
+    std::fill(bits.begin(), bits.end(), 0);
+    for (size_t i = 0; i < n; ++i) {
+      if ((current[i] >> shift) & 1) bits[i >> 6] |= 1ULL << (i & 63);
+      else ++zeros;
+    }
+
+    // Stable partition of the codes by the current bit: zeros first.
+    size_t zero_pos = 0;
+    size_t one_pos = zeros;
+    for (size_t i = 0; i < n; ++i) {
+      if ((current[i] >> shift) & 1) next[one_pos++] = current[i];
+      else next[zero_pos++] = current[i];
+    }
+
+    (*out)[zeros_offset + l] = zeros;
+    RankBitvector::Append(bits, n, out);
+    current.swap(next);
+  }
+}
+
+size_t WaveletTree::NumWords(size_t size, int levels) {
+  return levels * (1 + RankBitvector::NumWords(size));
+}
+
+void WaveletTree::View(const uint64_t *data, size_t size, int levels) {
+  levels_ = levels;
+  size_ = size;
+
+  const uint64_t *level_data = data + levels;
+  for (int l = 0; l < levels; ++l) {
+    zeros_[l] = data[l];
+    bits_[l].View(level_data, size);
+    level_data += RankBitvector::NumWords(size);
+  }
+
+  for (int code = 0; code < (1 << levels); ++code) {
+    size_t begin = 0;
+
+    for (int l = 0; l < levels; ++l) {
+      if ((code >> (levels - l - 1)) & 1) begin = zeros_[l] + bits_[l].Rank1(begin);
+      else begin = bits_[l].Rank0(begin);
+    }
+
+    begin_[code] = begin;
+  }
+}
+
+uint8_t WaveletTree::operator[](size_t index) const {
+  uint8_t code;
+  InverseSelect(index, &code);
+
+  return code;
+}
+
+size_t WaveletTree::Rank(uint8_t code, size_t index) const {
+  for (int l = 0; l < levels_; ++l) {
+    if ((code >> (levels_ - l - 1)) & 1) index = zeros_[l] + bits_[l].Rank1(index);
+    else index = bits_[l].Rank0(index);
+  }
+
+  return index - begin_[code];
+}
+
+size_t WaveletTree::InverseSelect(size_t index, uint8_t *code) const {
+  uint8_t result = 0;
+
+  for (int l = 0; l < levels_; ++l) {
+    if (bits_[l][index]) {
+      result = (result << 1) | 1;
+      index = zeros_[l] + bits_[l].Rank1(index);
+    } else {
+      result <<= 1;
+      index = bits_[l].Rank0(index);
+    }
+  }
+
+  *code = result;
+
+  return index - begin_[result];
+}
+
+}  // namespace ipmt
@@ -0,0 +1,47 @@
+#!/bin/bash
+# Indexes a generated text with the external algorithm under a memory limit, and checks that the
+# peak resident memory stays under the limit and that the index is the same as the one of "sais".
+#
+# Usage: tests/external_memory.sh [ipmt] [size in megabytes] [memory limit in megabytes]
+
+IPMT=${1:-bin/ipmt}
+SIZE_MB=${2:-4}
+LIMIT_MB=${3:-16}
+
+DIR=$(mktemp -d) || exit 1
+trap 'rm -rf "$DIR"' EXIT
+
+# Lines of words from a small vocabulary, so that the text has long repeats, as logs do.
+awk -v size=$((SIZE_MB * 1024 * 1024)) 'BEGIN {
+  srand(1);
+  split("success failed login error request response debug info warning timeout user", words);
+  while (length_ < size) {
+    line = "";
+    for (k = int(rand() * 8) + 1; k > 0; --k) line = line words[int(rand() * 11) + 1] " ";
+    line = line int(rand() * 1000000);
+    print line;
+    length_ += length(line) + 1;
+  }
+}' > "$DIR/text.txt"
+
+cp "$DIR/text.txt" "$DIR/sais.txt"
+
+if ! "$IPMT" index -a ext -m "$LIMIT_MB" --stats=json "$DIR/text.txt" 2> "$DIR/stats.json"; then
+  echo "FAIL: ipmt index -a ext -m $LIMIT_MB failed"
+  cat "$DIR/stats.json"
+  exit 1
+fi
+
+PEAK_KB=$(sed -n 's/.*"peak_rss_kb": *\([0-9]*\).*/\1/p' "$DIR/stats.json")
+
+if [ -z "$PEAK_KB" ] || [ "$PEAK_KB" -ge $((LIMIT_MB * 1024)) ]; then
+  echo "FAIL: peak resident memory of ${PEAK_KB:-?} kB with -m $LIMIT_MB"
+  exit 1
+fi
+
+if ! "$IPMT" index -a sais "$DIR/sais.txt" || ! cmp -s "$DIR/text.idx" "$DIR/sais.idx"; then
+  echo "FAIL: the index of -a ext differs from the one of -a sais"
+  exit 1
+fi
+
+echo "ok: peak resident memory of $PEAK_KB kB with -m $LIMIT_MB"
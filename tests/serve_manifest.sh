@@ -0,0 +1,60 @@
+#!/bin/bash
+# Serves a segmented index by its manifest, and an index file replaced by a manifest while served,
+# and checks that the responses match search mode on the manifest.
+#
+# Usage: tests/serve_manifest.sh [ipmt]
+
+IPMT=${1:-bin/ipmt}
+
+DIR=$(mktemp -d) || exit 1
+trap 'rm -rf "$DIR"' EXIT
+
+for part in 1 2 3; do
+  awk -v part=$part 'BEGIN {
+    srand(part);
+    split("success failed login error request response debug info warning timeout user", words);
+    for (k = 0; k < 2000; ++k) print words[int(rand() * 11) + 1], words[int(rand() * 11) + 1];
+  }' > "$DIR/part$part.txt"
+done
+
+if ! "$IPMT" index -A "$DIR/seg.idm" "$DIR/part1.txt" "$DIR/part2.txt" "$DIR/part3.txt" ||
+   ! "$IPMT" index "$DIR/part1.txt"; then
+  echo "FAIL: ipmt index failed"
+  exit 1
+fi
+
+EXPECTED_COUNT=$("$IPMT" search -c "error" "$DIR/seg.idm")
+"$IPMT" search -n "ut f" "$DIR/seg.idm" > "$DIR/expected.txt"
+
+printf 'count error\nsearch ut f\n' | "$IPMT" serve -n "$DIR/seg.idm" > "$DIR/served.txt"
+SERVE_STATUS=$?
+
+if [ $SERVE_STATUS -ne 0 ] || [[ "$(sed -n 1p "$DIR/served.txt")" != "OK $EXPECTED_COUNT "* ]]; then
+  echo "FAIL: serving the manifest did not count $EXPECTED_COUNT occurrences"
+  head -n 5 "$DIR/served.txt"
+  exit 1
+fi
+
+sed '1d;$d' "$DIR/served.txt" > "$DIR/search.txt"
+
+if ! cmp -s "$DIR/search.txt" "$DIR/expected.txt"; then
+  echo "FAIL: search responses on the manifest differ from search mode"
+  exit 1
+fi
+
+# The served index file is replaced by the manifest between two requests.
+cp "$DIR/part1.idx" "$DIR/hot.idx"
+{
+  echo "count error"
+  sleep 1.5
+  cp "$DIR/seg.idm" "$DIR/hot.idx"
+  echo "count error"
+} | "$IPMT" serve "$DIR/hot.idx" > "$DIR/reloaded.txt"
+
+if [[ "$(sed -n 2p "$DIR/reloaded.txt")" != "OK $EXPECTED_COUNT "* ]]; then
+  echo "FAIL: the index file replaced by a manifest was not reloaded"
+  cat "$DIR/reloaded.txt"
+  exit 1
+fi
+
+echo "ok: $EXPECTED_COUNT occurrences served from the manifest"